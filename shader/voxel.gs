@@ -4,9 +4,11 @@
 
 in uint vs_out_VoxelCode[1];
 in uint vs_out_MaterialCode[1];
+flat in int vs_out_Instance[1];
 flat out vec3 gs_objectPosition;
 flat out ivec3 gs_voxel_material_mipmap;
 flat out vec3 gs_objectNormal;
+flat out int gs_instance;
 out vec3 gs_texCoord;
 //flat out float gs_sideLength;
 
@@ -15,20 +17,7 @@ layout(triangle_strip, max_vertices = OUT_VERTS) out;
 
 #include "globalubo.glsl"
 
-layout(std140) uniform Object
-{
-	mat4 c_mWorldView;
-	mat4 c_mInverseWorldView;
-	vec4 c_vCorner000;
-	vec4 c_vCorner001;
-	vec4 c_vCorner010;
-	vec4 c_vCorner011;
-	vec4 c_vCorner100;
-	vec4 c_vCorner101;
-	vec4 c_vCorner110;
-	vec4 c_vCorner111;
-	float c_fMaxOffset;
-};
+#include "voxelobject.glsl"
 
 
 // Standard linear congruential generator to hash an integer
@@ -39,22 +28,35 @@ uint hash(uint i)
 
 void main(void)
 {
+	int instance = vs_out_Instance[0];
+	mat4 mWorldView = c_instances[instance].mWorldView;
+	vec4 vCorner000 = c_instances[instance].vCorner000;
+	vec4 vCorner001 = c_instances[instance].vCorner001;
+	vec4 vCorner010 = c_instances[instance].vCorner010;
+	vec4 vCorner011 = c_instances[instance].vCorner011;
+	vec4 vCorner100 = c_instances[instance].vCorner100;
+	vec4 vCorner101 = c_instances[instance].vCorner101;
+	vec4 vCorner110 = c_instances[instance].vCorner110;
+	vec4 vCorner111 = c_instances[instance].vCorner111;
+	float fMaxOffset = c_instances[instance].fMaxOffset;
+
 	float x = float((vs_out_VoxelCode[0] >> 6 ) & uint(0x3f)) + 0.5;
 	float y = float((vs_out_VoxelCode[0] >> 12) & uint(0x3f)) + 0.5;
 	float z = float((vs_out_VoxelCode[0] >> 18) & uint(0x3f)) + 0.5;
 
-	vec4 vPos = vec4(x, y, z, 1) * c_mWorldView;
+	vec4 vPos = vec4(x, y, z, 1) * mWorldView;
 	vec3 vViewPos = vPos.xyz;
 	vPos = vec4(vPos.xyz * c_vProjection.xyz + vec3(0,0,c_vProjection.w), vPos.z);
 
 	// Discard voxel outside the viewing volume
-	float w = vPos.w + c_fMaxOffset;//max(max(length(c_vCorner000), length(c_vCorner001)), max(length(c_vCorner010), length(c_vCorner011)));
+	float w = vPos.w + fMaxOffset;//max(max(length(vCorner000), length(vCorner001)), max(length(vCorner010), length(vCorner011)));
 	if( abs(vPos.z) > w ||
 		abs(vPos.x) > w ||
 		abs(vPos.y) > w )
 		return;
 
 	gs_objectPosition = vec3(x, y, z);
+	gs_instance = instance;
 	gs_voxel_material_mipmap.y = int(vs_out_MaterialCode[0]);
 	gs_voxel_material_mipmap.x = int(vs_out_VoxelCode[0]);
 	gs_voxel_material_mipmap.z = clamp(int(log2(vPos.z * c_vInverseProjection.y / 16)), 0, 4);
@@ -68,20 +70,20 @@ void main(void)
 	// too to be in view space. Then culling is decided by a dot product.
 	vec3 vZDir = vViewPos;//vPos.xyz * c_vInverseProjection.xyz + vec3(0,0,c_vInverseProjection.w);
 	
-	if( dot((c_vCorner000.xyz+c_vCorner110.xyz)*c_vInverseProjection.xyz, vZDir) < 0 ) {
+	if( dot((vCorner000.xyz+vCorner110.xyz)*c_vInverseProjection.xyz, vZDir) < 0 ) {
 		if( (vs_out_VoxelCode[0] & uint(0x10)) != uint(0) )
 		{
 			gs_objectNormal = vec3(0,0,-1);
-			gl_Position = c_vCorner000 + vPos;
+			gl_Position = vCorner000 + vPos;
 			gs_texCoord = vec3(0,0,0);
 			EmitVertex();
-			gl_Position = c_vCorner100 + vPos;
+			gl_Position = vCorner100 + vPos;
 			gs_texCoord = vec3(1,0,0);
 			EmitVertex();
-			gl_Position = c_vCorner010 + vPos;
+			gl_Position = vCorner010 + vPos;
 			gs_texCoord = vec3(0,1,0);
 			EmitVertex();
-			gl_Position = c_vCorner110 + vPos;
+			gl_Position = vCorner110 + vPos;
 			gs_texCoord = vec3(1,1,0);
 			EmitVertex();
 			EndPrimitive();
@@ -90,36 +92,36 @@ void main(void)
 		if( (vs_out_VoxelCode[0] & uint(0x20)) != uint(0) )
 		{
 			gs_objectNormal = vec3(0,0,1);
-			gl_Position = c_vCorner011 + vPos;
+			gl_Position = vCorner011 + vPos;
 			gs_texCoord = vec3(0,1,1);
 			EmitVertex();
-			gl_Position = c_vCorner111 + vPos;
+			gl_Position = vCorner111 + vPos;
 			gs_texCoord = vec3(1,1,1);
 			EmitVertex();
-			gl_Position = c_vCorner001 + vPos;
+			gl_Position = vCorner001 + vPos;
 			gs_texCoord = vec3(0,0,1);
 			EmitVertex();
-			gl_Position = c_vCorner101 + vPos;
+			gl_Position = vCorner101 + vPos;
 			gs_texCoord = vec3(1,0,1);
 			EmitVertex();
 			EndPrimitive();
 		}
 	}
 
-	if( dot((c_vCorner010.xyz+c_vCorner111.xyz)*c_vInverseProjection.xyz, vZDir) < 0 ) {
+	if( dot((vCorner010.xyz+vCorner111.xyz)*c_vInverseProjection.xyz, vZDir) < 0 ) {
 		if( (vs_out_VoxelCode[0] & uint(0x08)) != uint(0) )
 		{
 			gs_objectNormal = vec3(0,1,0);
-			gl_Position = c_vCorner010 + vPos;
+			gl_Position = vCorner010 + vPos;
 			gs_texCoord = vec3(0,1,0);
 			EmitVertex();
-			gl_Position = c_vCorner110 + vPos;
+			gl_Position = vCorner110 + vPos;
 			gs_texCoord = vec3(1,1,0);
 			EmitVertex();
-			gl_Position = c_vCorner011 + vPos;
+			gl_Position = vCorner011 + vPos;
 			gs_texCoord = vec3(0,1,1);
 			EmitVertex();
-			gl_Position = c_vCorner111 + vPos;
+			gl_Position = vCorner111 + vPos;
 			gs_texCoord = vec3(1,1,1);
 			EmitVertex();
 			EndPrimitive();
@@ -128,36 +130,36 @@ void main(void)
 		if( (vs_out_VoxelCode[0] & uint(0x04)) != uint(0) )
 		{
 			gs_objectNormal = vec3(0,-1,0);
-			gl_Position = c_vCorner100 + vPos;
+			gl_Position = vCorner100 + vPos;
 			gs_texCoord = vec3(1,0,0);
 			EmitVertex();
-			gl_Position = c_vCorner000 + vPos;
+			gl_Position = vCorner000 + vPos;
 			gs_texCoord = vec3(0,0,0);
 			EmitVertex();
-			gl_Position = c_vCorner101 + vPos;
+			gl_Position = vCorner101 + vPos;
 			gs_texCoord = vec3(1,0,1);
 			EmitVertex();
-			gl_Position = c_vCorner001 + vPos;
+			gl_Position = vCorner001 + vPos;
 			gs_texCoord = vec3(0,0,1);
 			EmitVertex();
 			EndPrimitive();
 		}
 	}
 
-	if( dot((c_vCorner000.xyz+c_vCorner011.xyz)*c_vInverseProjection.xyz, vZDir) < 0 ) {
+	if( dot((vCorner000.xyz+vCorner011.xyz)*c_vInverseProjection.xyz, vZDir) < 0 ) {
 		if( (vs_out_VoxelCode[0] & uint(0x01)) != uint(0) )
 		{
 			gs_objectNormal = vec3(-1,0,0);
-			gl_Position = c_vCorner000 + vPos;
+			gl_Position = vCorner000 + vPos;
 			gs_texCoord = vec3(0,0,0);
 			EmitVertex();
-			gl_Position = c_vCorner010 + vPos;
+			gl_Position = vCorner010 + vPos;
 			gs_texCoord = vec3(0,1,0);
 			EmitVertex();
-			gl_Position = c_vCorner001 + vPos;
+			gl_Position = vCorner001 + vPos;
 			gs_texCoord = vec3(0,0,1);
 			EmitVertex();
-			gl_Position = c_vCorner011 + vPos;
+			gl_Position = vCorner011 + vPos;
 			gs_texCoord = vec3(0,1,1);
 			EmitVertex();
 			EndPrimitive();
@@ -166,16 +168,16 @@ void main(void)
 		if( (vs_out_VoxelCode[0] & uint(0x02)) != uint(0) )
 		{
 			gs_objectNormal = vec3(1,0,0);
-			gl_Position = c_vCorner110 + vPos;
+			gl_Position = vCorner110 + vPos;
 			gs_texCoord = vec3(1,1,0);
 			EmitVertex();
-			gl_Position = c_vCorner100 + vPos;
+			gl_Position = vCorner100 + vPos;
 			gs_texCoord = vec3(1,0,0);
 			EmitVertex();
-			gl_Position = c_vCorner111 + vPos;
+			gl_Position = vCorner111 + vPos;
 			gs_texCoord = vec3(1,1,1);
 			EmitVertex();
-			gl_Position = c_vCorner101 + vPos;
+			gl_Position = vCorner101 + vPos;
 			gs_texCoord = vec3(1,0,1);
 			EmitVertex();
 			EndPrimitive();
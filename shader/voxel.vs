@@ -5,9 +5,11 @@ layout(location=7) in uint in_VoxelCode;
 layout(location=8) in uint in_MaterialCode;
 out uint vs_out_VoxelCode;
 out uint vs_out_MaterialCode;
+flat out int vs_out_Instance;
 
 void main()
 {
 	vs_out_VoxelCode = in_VoxelCode;
 	vs_out_MaterialCode = in_MaterialCode;
+	vs_out_Instance = gl_InstanceID;
 }
@@ -0,0 +1,24 @@
+// Per instance constants of the voxel renderer. One element is written for
+// each instance of an instanced draw call. MAX_VOXEL_INSTANCES must match
+// Graphic::MAX_VOXEL_INSTANCES.
+#define MAX_VOXEL_INSTANCES 32
+
+struct VoxelInstance
+{
+	mat4 mWorldView;
+	mat4 mInverseWorldView;
+	vec4 vCorner000;
+	vec4 vCorner001;
+	vec4 vCorner010;
+	vec4 vCorner011;
+	vec4 vCorner100;
+	vec4 vCorner101;
+	vec4 vCorner110;
+	vec4 vCorner111;
+	float fMaxOffset;
+};
+
+layout(std140) uniform Object
+{
+	VoxelInstance c_instances[MAX_VOXEL_INSTANCES];
+};
@@ -2,8 +2,14 @@
 #include "graphic/core/opengl.hpp"
 // -- PLEASE REMOVE WHEN DONE WITH POSTPROCESSING
 
+#include <algorithm>
 #include <thread>
 #include "utilities/assert.hpp"
+#include "utilities/jobsystem.hpp"
+#include "utilities/bufferbenchmark.hpp"
+#include "utilities/jobbenchmark.hpp"
+#include "utilities/scriptruntime.hpp"
+#include "gameplay/componentsystems/componentsystem.hpp"
 #include "game.hpp"
 #include "gamestates/gsmainmenu.hpp"
 #include "gamestates/gsplay.hpp"
@@ -25,6 +31,7 @@
 
 #include "input/input.hpp"
 #include "voxel/voxel.hpp"
+#include "voxel/model.hpp"
 #include "resources.hpp"
 
 double Monolith::m_time = 0.0;
@@ -32,6 +39,9 @@ double Monolith::m_time = 0.0;
 // ************************************************************************* //
 void RenderLoop::Step( double _deltaTime )
 {
+	// Jobs which need the GL context (uploads, resource creation)
+	Utils::JobSystem::RunMainThreadJobs();
+
 	Graphic::Resources::GetUBO(Graphic::UniformBuffers::GLOBAL)["Time"] = (float)m_game.m_time;
 
 	// Render to scene frame buffer.
@@ -111,6 +121,23 @@ Monolith::Monolith( bool _singleThreaded ) :
 		}
 	}
 
+	Utils::JobSystem::Initialize( Config[std::string("Game")][std::string("NumWorkerThreads")].Get(-1) );
+	if( Config[std::string("Game")][std::string("BenchmarkJobs")].Get(false) )
+		Utils::RunJobSystemBenchmark();
+	Mechanics::TickIntervals::Load( Config[std::string("Game")][std::string("TickIntervals")] );
+	Script::Runtime::Initialize( Config[std::string("Game")][std::string("ScriptBudget")] );
+	Voxel::Model::EnableDeduplicationReport( Config[std::string("Game")][std::string("ReportVoxelDAG")].Get(false) );
+	if( Config[std::string("Game")][std::string("BenchmarkBuffers")].Get(false) )
+	{
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		Utils::RunBufferStressTest( numThreads, 2.0 );
+		Utils::RunBufferBenchmark( numThreads, 2.0 );
+	}
+#ifdef _DEBUG
+	// Short consistency check of the concurrent buffers in each debug run
+	else Assert( Utils::RunBufferStressTest(2, 0.05), "MultiVersionBuffer failed the stress test." );
+#endif
+
 	// Create a device with a window
 	int screenWidth = Config[std::string("Graphics")][std::string("ScreenWidth")].Get(1366);
 	int screenHeight = Config[std::string("Graphics")][std::string("ScreenHeight")].Get(768);
@@ -172,6 +199,9 @@ Monolith::~Monolith()
 
 	Graphic::Resources::Unload();
 	Voxel::TypeInfo::Unload();
+	Utils::JobSystem::Close();
+	Script::Runtime::Close();
+	Script::Runtime::LogStats();
 
 	delete m_postProcessing;
 	delete m_sceneFramebuffer;
@@ -264,6 +294,38 @@ void Monolith::BuildDefaultConfig()
 
 	auto& cgame = Config[std::string("Game")];
 	cgame[std::string("Language")] = "english.json";
+	// Lockstep simulation with a recorded input log for replays
+	cgame[std::string("Deterministic")] = false;
+	cgame[std::string("Seed")] = 0;
+	cgame[std::string("RecordInput")] = "savegames/lastsession.input";
+	cgame[std::string("ReplayInput")] = "";
+	// Number of job threads besides the loops, -1 for one per core
+	cgame[std::string("NumWorkerThreads")] = -1;
+	// Measure the speedup of the job system at startup
+	cgame[std::string("BenchmarkJobs")] = false;
+	// Log how well loaded and generated models deduplicate as voxel DAG (slow)
+	cgame[std::string("ReportVoxelDAG")] = false;
+	// Stress test and compare the concurrent buffers at startup (takes a few seconds)
+	cgame[std::string("BenchmarkBuffers")] = false;
+	// Number of steps between two updates of ship systems and AI, 1 for every step
+	auto& cticks = cgame[std::string("TickIntervals")];
+	cticks[std::string("Battery")] = 1;
+	cticks[std::string("Reactor")] = 1;
+	cticks[std::string("Storage")] = 4;
+	cticks[std::string("Weapon")] = 3;
+	cticks[std::string("Sensor")] = 8;
+	cticks[std::string("Script")] = 2;
+	cticks[std::string("Controller")] = 4;
+	cticks[std::string("Fleet")] = 8;
+	// Scripts which take longer than CallTime (ms) MaxOverruns times in a row are disabled
+	auto& cscript = cgame[std::string("ScriptBudget")];
+	cscript[std::string("CallTime")] = 0.1;
+	cscript[std::string("MaxOverruns")] = 10;
+	cscript[std::string("HangTime")] = 50.0;
+	// AI fleets which fly across the start area to measure the fleet controller
+	auto& cfleets = cgame[std::string("TestFleets")];
+	cfleets[std::string("Count")] = 0;
+	cfleets[std::string("Size")] = 8;
 
 	auto& cgraphics = Config[std::string("Graphics")];
 	cgraphics[std::string("ScreenWidth")] = 1366;
@@ -2,10 +2,14 @@
 #include "utilities/logger.hpp"
 #include <ei/elementarytypes.hpp>
 #include <thread>
+#include <condition_variable>
 
 using namespace ei;
 
-static bool g_stopLoops = false;
+static std::atomic<bool> g_stopLoops(false);
+// Paused loops wait for Continue() or StopAll() on this condition.
+static std::mutex g_pauseMutex;
+static std::condition_variable g_pauseChanged;
 
 // ************************************************************************* //
 void GameLoop::SetTargetFrameDuration( double _duration )
@@ -17,51 +21,54 @@ void GameLoop::SetTargetFrameDuration( double _duration )
 void GameLoop::Run()
 {
 	LOG_LVL2( "Starting game loop " + m_name );
-	double deltaTime = 0.0;
+	double accumulator = 0.0;
 	TimeQuerySlot frameTimer;
+	TimeQuery( frameTimer );
 	while( !g_stopLoops )
 	{
+		if( m_pause )
+		{
+			std::unique_lock<std::mutex> pauseLock(g_pauseMutex);
+			g_pauseChanged.wait( pauseLock, [this](){ return !m_pause || g_stopLoops; } );
+			if( g_stopLoops ) break;
+			// Do not catch up the paused time
+			TimeQuery( frameTimer );
+			accumulator = 0.0;
+		}
+
 		{	// artificial scope for the lock
 			std::unique_lock<std::recursive_mutex> lock(m_executing);
-			// Busy waiting?
-			while( m_pause )
-			{
-				if( g_stopLoops ) return;
-				std::this_thread::sleep_for( std::chrono::microseconds(50) );
-			}
-
-			TimeQuery( frameTimer );
+			// Pause() was called between the check and the lock
+			if( m_pause ) continue;
 
-			// Do the work
-			try {
-				Step( deltaTime );
-			} catch( const std::exception& _e ) {
-				LOG_ERROR("Caught std::exception in game loop " + m_name + ": \"" + std::string(_e.what()) + "\"");
-				OnFailure();
-			} catch( const std::string& _e ) {
-				LOG_ERROR("Caught string-exception in game loop " + m_name + ": \"" + _e + "\"");
-				OnFailure();
-			} catch( ... ) {
-				LOG_ERROR("Caught exception of unknown type in game loop " + m_name);
-				OnFailure();
+			accumulator += TimeQuery( frameTimer );
+			if( m_targetFrameDuration > 0.0 )
+			{
+				// Fixed time step: a long frame is followed by several steps
+				int numSteps = 0;
+				while( accumulator >= m_targetFrameDuration && numSteps < MAX_CATCH_UP_STEPS )
+				{
+					SafeStep( m_targetFrameDuration );
+					accumulator -= m_targetFrameDuration;
+					++numSteps;
+					++m_stepCounter;
+				}
+				if( numSteps == MAX_CATCH_UP_STEPS && accumulator >= m_targetFrameDuration )
+				{
+					LOG_LVL0( "Game loop " + m_name + " is too slow, dropping " + std::to_string(accumulator) + " s" );
+					accumulator = 0.0;
+				}
+			} else {
+				SafeStep( accumulator );
+				accumulator = 0.0;
+				++m_stepCounter;
 			}
 		}
 
-		++m_stepCounter;
-
-		// Calculate time since last frame
-		double deltaFrameTime = TimeQuery( frameTimer );
-		// Smooth frame time
-//		deltaTime = deltaTime * 0.8 + deltaFrameTime * 0.2;
-//		deltaTime = max( deltaFrameTime, m_targetFrameDuration );
-		// Because of sleeping the time of a frame always takes the desired
-		// length. If it takes longer the game will run slower, but to large
-		// steps make many things too instable.
-		deltaTime = m_targetFrameDuration;
-
-		// Limiting to target fps
-		double timeDifference = m_targetFrameDuration - deltaFrameTime;
-		//timeDifference = max(0.0, timeDifference);
+		// Sleep until the next step is due. The time of the work done above
+		// is not part of the accumulator yet.
+		double timeDifference = m_targetFrameDuration - accumulator - TimeQuery( frameTimer );
+		accumulator = m_targetFrameDuration - timeDifference;
 		if( timeDifference > 0.0 )
 		{
 			std::this_thread::sleep_for( std::chrono::microseconds(unsigned(timeDifference * 1000000.0)) );
@@ -71,10 +78,31 @@ void GameLoop::Run()
 	LOG_LVL2( "Exited game loop " + m_name );
 }
 
+// ************************************************************************* //
+void GameLoop::SafeStep( double _deltaTime )
+{
+	try {
+		Step( _deltaTime );
+	} catch( const std::exception& _e ) {
+		LOG_ERROR("Caught std::exception in game loop " + m_name + ": \"" + std::string(_e.what()) + "\"");
+		OnFailure();
+	} catch( const std::string& _e ) {
+		LOG_ERROR("Caught string-exception in game loop " + m_name + ": \"" + _e + "\"");
+		OnFailure();
+	} catch( ... ) {
+		LOG_ERROR("Caught exception of unknown type in game loop " + m_name);
+		OnFailure();
+	}
+}
+
 // ************************************************************************* //
 void GameLoop::StopAll()
 {
-	g_stopLoops = true;
+	{
+		std::lock_guard<std::mutex> pauseLock(g_pauseMutex);
+		g_stopLoops = true;
+	}
+	g_pauseChanged.notify_all();
 }
 
 // ************************************************************************* //
@@ -89,5 +117,9 @@ void GameLoop::Pause()
 // ************************************************************************* //
 void GameLoop::Continue()
 {
-	m_pause = false;
+	{
+		std::lock_guard<std::mutex> pauseLock(g_pauseMutex);
+		m_pause = false;
+	}
+	g_pauseChanged.notify_all();
 }
\ No newline at end of file
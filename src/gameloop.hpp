@@ -5,12 +5,22 @@
 #include <cstdint>
 #include <string>
 #include <mutex>
+#include <atomic>
 
 /// \brief General base class which allows different types of continuous loop
 ///		updates.
+/// \details Loops with a target duration use a fixed time step: real time is
+///		accumulated and Step() is called with exactly the target duration as
+///		often as the accumulated time allows. Continuous loops (duration 0)
+///		are called once per iteration with the measured time.
 class GameLoop
 {
 public:
+	/// \brief Maximum number of fixed steps in one iteration. If a loop falls
+	///		further behind the remaining time is dropped (the game slows down)
+	///		instead of spiraling into ever more catch up steps.
+	static const int MAX_CATCH_UP_STEPS = 4;
+
 	/// \brief Create a game loop.
 	/// \param [in] _duration Duration of a frame in seconds.
 	///		To get a continuous loop set the duration to 0.
@@ -23,7 +33,8 @@ public:
 	}
 
 	/// \brief The method is called once per frame _deltaTime
-	/// \param [in] _deltaTime Time since last Step call in seconds.
+	/// \param [in] _deltaTime The fixed step duration or the time since
+	///		the last Step call in seconds for continuous loops.
 	virtual void Step( double _deltaTime ) = 0;
 
 	/// \brief Set the rate to which this loop should be clamped in case the
@@ -43,6 +54,7 @@ public:
 
 	/// \brief Stop another thread temporarily. The call is blocking until the
 	///		thread stopped.
+	/// \details The paused thread sleeps until Continue() or StopAll().
 	void Pause();
 	/// \brief Continue a thread which was interrupted by Pause()
 	void Continue();
@@ -59,5 +71,8 @@ private:
 	double m_targetFrameDuration;	///< At what target frame rate this loop should run?
 
 	std::recursive_mutex m_executing;			///< Locked as long as the thread works
-	bool m_pause;					///< True if the thread should go into pause modus
+	std::atomic<bool> m_pause;		///< True if the thread should go into pause modus
+
+	/// \brief Call Step() and handle all exceptions.
+	void SafeStep( double _deltaTime );
 };
\ No newline at end of file
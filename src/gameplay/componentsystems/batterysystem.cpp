@@ -27,6 +27,15 @@ namespace Mechanics{
 		m_capacity += Voxel::TypeInfo::GetCapacity(_type);
 	}
 
+	void BatterySystem::OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		m_maxEnergyOutput -= Voxel::TypeInfo::GetEnergyOut(_type);
+		m_maxEnergyDrain -= Voxel::TypeInfo::GetEnergyDrain(_type);
+		m_capacity -= Voxel::TypeInfo::GetCapacity(_type);
+		// The energy stored in the destroyed battery is lost
+		m_charge = ei::min(m_charge, m_capacity);
+	}
+
 	void BatterySystem::ClearSystem()
 	{
 		m_capacity = 0;
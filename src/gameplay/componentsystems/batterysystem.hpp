@@ -7,11 +7,12 @@ namespace Mechanics {
 	class BatterySystem: public ComponentSystem
 	{
 	public:
-		BatterySystem(class Ship& _theShip, unsigned _id) : ComponentSystem(_theShip, "Batteries", _id) {}
+		BatterySystem(class Ship& _theShip, unsigned _id) : ComponentSystem(_theShip, "Batteries", _id) { m_tickInterval = TickIntervals::battery; }
 
 		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
 		virtual void Process(float _deltaTime, SystemRequierements& _provided) override;
 		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
 		virtual void ClearSystem() override;
 	public:
 		float m_capacity;
@@ -0,0 +1,149 @@
+#include "componentscheduler.hpp"
+#include "computersystem.hpp"
+#include "gameplay/ship.hpp"
+#include "utilities/jobsystem.hpp"
+#include <algorithm>
+
+namespace Mechanics {
+
+	// Chunks of ships per thread. Ships differ a lot in their number of
+	// components, so more chunks than threads balance better.
+	const int CHUNKS_PER_THREAD = 4;
+
+	// ************************************************************* //
+	ComponentScheduler::ComponentScheduler() :
+		m_ships(nullptr),
+		m_deltaTimes(nullptr)
+	{
+	}
+
+	// ************************************************************* //
+	void ComponentScheduler::Run(Ship* const* _ships, const float* _deltaTimes, int _numShips)
+	{
+		if( _numShips <= 0 ) return;
+		m_ships = _ships;
+		m_deltaTimes = _deltaTimes;
+
+		// Rebuild the tables. Clearing keeps the capacity, so there are no
+		// allocations if the fleets do not grow.
+		m_computers.Clear();
+		m_batteries.Clear();
+		m_drives.Clear();
+		m_reactors.Clear();
+		m_sensors.Clear();
+		m_shields.Clear();
+		m_storages.Clear();
+		m_weapons.Clear();
+		for( int s = 0; s < _numShips; ++s )
+		{
+			// Computers in the topological order of the energy network
+			for( auto computer : _ships[s]->m_energyNetwork.GetNodes() )
+				AddSystems(*computer, s);
+			m_computers.CloseShip();
+			m_batteries.CloseShip();
+			m_drives.CloseShip();
+			m_reactors.CloseShip();
+			m_sensors.CloseShip();
+			m_shields.CloseShip();
+			m_storages.CloseShip();
+			m_weapons.CloseShip();
+		}
+
+		int numChunks = std::min(_numShips, Utils::JobSystem::NumThreads() * CHUNKS_PER_THREAD);
+		Utils::JobSystem::ParallelFor(numChunks, [this, _numShips, numChunks](int _chunk){
+			EstimateChunk(_numShips * _chunk / numChunks, _numShips * (_chunk + 1) / numChunks);
+		});
+		RunScripts();
+		Utils::JobSystem::ParallelFor(numChunks, [this, _numShips, numChunks](int _chunk){
+			ProcessChunk(_numShips * _chunk / numChunks, _numShips * (_chunk + 1) / numChunks);
+		});
+	}
+
+	// ************************************************************* //
+	void ComponentScheduler::AddSystems(ComputerSystem& _computer, int _ship)
+	{
+		m_computers.Add(_computer, _ship);
+		m_batteries.Add(_computer.m_batteries, _ship);
+		m_drives.Add(_computer.m_drives, _ship);
+		m_reactors.Add(_computer.m_reactors, _ship);
+		m_sensors.Add(_computer.m_sensors, _ship);
+		m_shields.Add(_computer.m_shields, _ship);
+		m_storages.Add(_computer.m_storage, _ship);
+		m_weapons.Add(_computer.m_weapons, _ship);
+	}
+
+	// ************************************************************* //
+	template<typename T>
+	void ComponentScheduler::Estimate(Table<T>& _table, int _firstShip, int _endShip)
+	{
+		for( int i = _table.firstOfShip[_firstShip]; i < _table.firstOfShip[_endShip]; ++i )
+		{
+			int ship = _table.ships[i];
+			T& system = *_table.systems[i];
+			// Qualified call: the type is known, no virtual dispatch
+			if( system.BeginTick(m_deltaTimes[ship]) )
+				system.T::Estimate(system.GetTickTime(), m_ships[ship]->m_requirements);
+		}
+	}
+
+	// ************************************************************* //
+	template<typename T>
+	void ComponentScheduler::Process(Table<T>& _table, int _firstShip, int _endShip)
+	{
+		for( int i = _table.firstOfShip[_firstShip]; i < _table.firstOfShip[_endShip]; ++i )
+		{
+			T& system = *_table.systems[i];
+			if( system.IsTicking() )
+				system.T::Process(system.GetTickTime(), m_ships[_table.ships[i]]->m_requirements);
+		}
+	}
+
+	// ************************************************************* //
+	void ComponentScheduler::EstimateChunk(int _firstShip, int _endShip)
+	{
+		for( int s = _firstShip; s < _endShip; ++s )
+			m_ships[s]->PrepareSystems(m_deltaTimes[s]);
+
+		// Reactors and storages have no process phase.
+		Estimate(m_batteries, _firstShip, _endShip);
+		Estimate(m_drives, _firstShip, _endShip);
+		Estimate(m_reactors, _firstShip, _endShip);
+		Estimate(m_sensors, _firstShip, _endShip);
+		Estimate(m_shields, _firstShip, _endShip);
+		Estimate(m_storages, _firstShip, _endShip);
+		Estimate(m_weapons, _firstShip, _endShip);
+
+		for( int i = m_computers.firstOfShip[_firstShip]; i < m_computers.firstOfShip[_endShip]; ++i )
+			m_computers.systems[i]->GatherEstimates();
+		for( int s = _firstShip; s < _endShip; ++s )
+			m_ships[s]->m_energyNetwork.Solve();
+	}
+
+	// ************************************************************* //
+	void ComponentScheduler::RunScripts()
+	{
+		// The script globals are bound to the systems of a single computer
+		// by address (ComputerSystem::Flash()), so calls cannot be batched.
+		for( auto computer : m_computers.systems )
+			if( computer->IsDistributionDue()
+				&& !(computer->m_script && computer->m_script->Call(computer->m_energyMaxOut)) )
+				computer->DistributeNative();
+	}
+
+	// ************************************************************* //
+	void ComponentScheduler::ProcessChunk(int _firstShip, int _endShip)
+	{
+		for( int i = m_computers.firstOfShip[_firstShip]; i < m_computers.firstOfShip[_endShip]; ++i )
+			m_computers.systems[i]->ApplyDistribution();
+
+		Process(m_batteries, _firstShip, _endShip);
+		Process(m_drives, _firstShip, _endShip);
+		Process(m_sensors, _firstShip, _endShip);
+		Process(m_shields, _firstShip, _endShip);
+		Process(m_weapons, _firstShip, _endShip);
+
+		for( int s = _firstShip; s < _endShip; ++s )
+			m_ships[s]->m_systemsProcessed = true;
+	}
+
+} // namespace Mechanics
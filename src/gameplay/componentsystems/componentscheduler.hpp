@@ -0,0 +1,84 @@
+#pragma once
+
+#include "predeclarations.hpp"
+#include <vector>
+
+namespace Mechanics {
+
+	/// \brief Runs the component systems of many ships phase by phase.
+	/// \details Instead of walking the system tree of each ship with virtual
+	///		calls, the systems of all ships are gathered in one table per
+	///		system type. Each phase (estimate, distribute, process) is a loop
+	///		over one table with non virtual calls.
+	///
+	///		Ships are split into contiguous chunks which run in parallel. The
+	///		tables are sorted by ship, so each chunk covers a contiguous range
+	///		of each table and the phases of one ship happen in the same order
+	///		as in EnergyNetwork::Estimate(), Solve() and Process().
+	///
+	///		The tables contain pointers: the state remains in the system
+	///		objects because the energy scripts address them directly.
+	///
+	///		Energy scripts share the globals of their modules and must not
+	///		run concurrently. Therefore a step consists of a parallel
+	///		estimate pass, one serial batch of script calls per script
+	///		function and a parallel process pass.
+	class ComponentScheduler
+	{
+	public:
+		ComponentScheduler();
+
+		/// \brief Estimate and process the systems of all given ships.
+		/// \details Afterwards Ship::Simulate() only applies the provided
+		///		forces.
+		/// \param [in] _deltaTimes Step time of each ship.
+		void Run(Ship* const* _ships, const float* _deltaTimes, int _numShips);
+
+		/// \brief Sensors of the ships of the last run. The scene scans for
+		///		those which are due.
+		const std::vector<SensorSystem*>& GetSensors() const { return m_sensors.systems; }
+	private:
+		/// \brief All systems of one type ordered by ship.
+		template<typename T>
+		struct Table
+		{
+			std::vector<T*> systems;
+			std::vector<int> ships;			///< Index of the owning ship in the current run
+			std::vector<int> firstOfShip;	///< Index of the first system of each ship plus the end
+
+			void Clear()							{ systems.clear(); ships.clear(); firstOfShip.assign(1, 0); }
+			void Add(T& _system, int _ship)			{ systems.push_back(&_system); ships.push_back(_ship); }
+			void CloseShip()						{ firstOfShip.push_back((int)systems.size()); }
+		};
+
+		Table<ComputerSystem> m_computers;
+		Table<BatterySystem> m_batteries;
+		Table<DriveSystem> m_drives;
+		Table<ReactorSystem> m_reactors;
+		Table<SensorSystem> m_sensors;
+		Table<ShieldSystem> m_shields;
+		Table<StorageSystem> m_storages;
+		Table<WeaponSystem> m_weapons;
+
+		Ship* const* m_ships;			///< Ships of the current run
+		const float* m_deltaTimes;
+
+		/// \brief Add a computer and its own systems.
+		void AddSystems(ComputerSystem& _computer, int _ship);
+
+		/// \brief Prepare, estimate and gather for the ships [_firstShip, _endShip).
+		void EstimateChunk(int _firstShip, int _endShip);
+		/// \brief Call the distribution scripts of all due computers one
+		///		after another. Computers without (enabled) script use the
+		///		native distribution.
+		void RunScripts();
+		/// \brief Distribute and process for the ships [_firstShip, _endShip).
+		void ProcessChunk(int _firstShip, int _endShip);
+
+		template<typename T>
+		void Estimate(Table<T>& _table, int _firstShip, int _endShip);
+		template<typename T>
+		void Process(Table<T>& _table, int _firstShip, int _endShip);
+	};
+
+} // namespace Mechanics
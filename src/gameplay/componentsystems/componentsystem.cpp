@@ -1,7 +1,29 @@
 #include "componentsystem.hpp"
+#include "gameplay/ship.hpp"
 
 namespace Mechanics {
 
+	int TickIntervals::battery = 1;
+	int TickIntervals::reactor = 1;
+	int TickIntervals::storage = 1;
+	int TickIntervals::weapon = 1;
+	int TickIntervals::sensor = 1;
+	int TickIntervals::script = 1;
+	int TickIntervals::controller = 1;
+	int TickIntervals::fleet = 1;
+
+	void TickIntervals::Load(Jo::Files::MetaFileWrapper::Node& _config)
+	{
+		battery = ei::max(1, _config[std::string("Battery")].Get(1));
+		reactor = ei::max(1, _config[std::string("Reactor")].Get(1));
+		storage = ei::max(1, _config[std::string("Storage")].Get(1));
+		weapon = ei::max(1, _config[std::string("Weapon")].Get(1));
+		sensor = ei::max(1, _config[std::string("Sensor")].Get(1));
+		script = ei::max(1, _config[std::string("Script")].Get(1));
+		controller = ei::max(1, _config[std::string("Controller")].Get(1));
+		fleet = ei::max(1, _config[std::string("Fleet")].Get(1));
+	}
+
 	ComponentSystem::ComponentSystem(Ship& _theShip, const std::string& _name, unsigned _id) :
 		m_id(_id),
 		m_energyDemand(0.0f),
@@ -9,11 +31,30 @@ namespace Mechanics {
 		m_energyMaxOut(0.0f),
 		m_energyLoss(0.0f),
 		m_name(_name),
-		m_ship(_theShip)
+		m_ship(_theShip),
+		m_tickInterval(1),
+		m_pendingTime(0.0f),
+		m_tickTime(0.0f),
+		m_ticking(false)
 	{
 	}
 
 	ComponentSystem::~ComponentSystem()
 	{
 	}
+
+	bool ComponentSystem::BeginTick(float _deltaTime)
+	{
+		m_pendingTime += _deltaTime;
+		m_ticking = m_ship.GetTick() % m_tickInterval == 0;
+		if( m_ticking )
+		{
+			m_tickTime = m_pendingTime;
+			m_pendingTime = 0.0f;
+		} else {
+			m_energyDemand = 0.0f;
+			m_energyMaxOut = 0.0f;
+		}
+		return m_ticking;
+	}
 }
\ No newline at end of file
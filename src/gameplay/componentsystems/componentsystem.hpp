@@ -1,7 +1,9 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 #include <ei/vector.hpp>
+#include <jofilelib.hpp>
 #include "predeclarations.hpp"
 #include "enginetypes.hpp"
 
@@ -15,6 +17,34 @@ namespace Mechanics {
 		ei::Vec3 cursorDirection; ///< Direction of a ray begining from
 	};
 
+	/// \brief Pack a voxel position into a key for maps from components to
+	///		precomputed data.
+	inline uint64_t ComponentKey(const ei::IVec3& _position)
+	{
+		return (uint64_t(_position[0] & 0x1fffff) << 42)
+			| (uint64_t(_position[1] & 0x1fffff) << 21)
+			| uint64_t(_position[2] & 0x1fffff);
+	}
+
+	/// \brief Number of simulation steps between two updates of each system
+	///		type, the energy scripts and the controllers.
+	/// \details Loaded from the config (Game.TickIntervals) at startup. An
+	///		interval of 1 means every step. Drives always run every step
+	///		because the integration consumes their forces each step.
+	struct TickIntervals
+	{
+		static int battery;
+		static int reactor;
+		static int storage;
+		static int weapon;
+		static int sensor;
+		static int script;
+		static int controller;
+		static int fleet;			///< Group update and round of member re-evaluations of a FleetController
+
+		static void Load(Jo::Files::MetaFileWrapper::Node& _config);
+	};
+
 	/// \brief Base class for all different acting component types / groups.
 	/// \details A components system handles energy flow and other component-specific 
 	///		simulations. Each system has to define a state which is partially known
@@ -58,14 +88,45 @@ namespace Mechanics {
 		/// \param [in] _assignment The assignment to the responsible system.
 		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) {}
 
+		/// \brief Called if a component is removed or destroyed.
+		/// \details Must revert exactly what OnAdd() did for the same voxel,
+		///		such that changes of single voxels do not require a full
+		///		recomputation.
+		/// \param [in] _position Voxel position in the ship model.
+		/// \param [in] _type Type of the removed component.
+		/// \param [in] _assignment The assignment to the responsible system.
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) {}
+
+		/// \brief Called for all systems if the occupancy of a voxel changed
+		///		(something was added to or removed from an empty place).
+		/// \details Systems whose components depend on their surrounding
+		///		update it here.
+		virtual void OnChange(const ei::IVec3& _position) {}
+
 		/// \brief Recursively clear the system state. This is done if everything is recomputed.
 		virtual void ClearSystem() {}
 
+		/// \brief Accumulate the step time and decide if the system runs in
+		///		this step.
+		/// \details Systems run every m_tickInterval steps, shifted by the
+		///		phase of their ship. A skipped system neither demands nor
+		///		provides energy in this step.
+		/// \return true if Estimate() and Process() must be called with
+		///		GetTickTime().
+		bool BeginTick(float _deltaTime);
+		bool IsTicking() const			{ return m_ticking; }
+		/// \brief Time since the last step in which the system ran.
+		float GetTickTime() const		{ return m_tickTime; }
+
 		const std::string& GetName() const { return m_name; }
 	protected:
 		class Ship& m_ship;
 		const unsigned m_id;						///< System ID for this system and all its direct sub systems.
+		int m_tickInterval;							///< Steps between two updates, 1 by default
 	private:
 		std::string m_name;			///< A name which is used in the script to identify this system
+		float m_pendingTime;		///< Accumulated time of skipped steps
+		float m_tickTime;
+		bool m_ticking;
 	};
 }
\ No newline at end of file
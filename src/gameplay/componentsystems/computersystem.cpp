@@ -15,27 +15,37 @@ namespace Mechanics {
 			m_sensors(_theShip, m_id),
 			m_shields(_theShip, m_id),
 			m_storage(_theShip, m_id),
-			m_weapons(_theShip, m_id)
+			m_weapons(_theShip, m_id),
+			m_script(nullptr),
+			m_scriptModule(nullptr)
 	{
 	}
 
+	ComputerSystem* ComputerSystem::s_scriptOwner = nullptr;
+
 	ComputerSystem::~ComputerSystem()
 	{
+		if(s_scriptOwner == this) s_scriptOwner = nullptr;
 		m_ship.ReleaseSystemID(m_id);
 	}
 
+	// Systems which skip a step use the time of all skipped steps when
+	// they run again. Sub computers are separate nodes of the EnergyNetwork.
 	void ComputerSystem::Estimate(float _deltaTime, SystemRequierements& _requirements)
 	{
-		m_batteries.Estimate(_deltaTime, _requirements);
-		m_drives.Estimate(_deltaTime, _requirements);
-		m_reactors.Estimate(_deltaTime, _requirements);
-		m_sensors.Estimate(_deltaTime, _requirements);
-		m_shields.Estimate(_deltaTime, _requirements);
-		m_storage.Estimate(_deltaTime, _requirements);
-		m_weapons.Estimate(_deltaTime, _requirements);
-		for(auto sys : m_subSystems)
-			sys.Estimate(_deltaTime, _requirements);
+		if(m_batteries.BeginTick(_deltaTime)) m_batteries.Estimate(m_batteries.GetTickTime(), _requirements);
+		if(m_drives.BeginTick(_deltaTime)) m_drives.Estimate(m_drives.GetTickTime(), _requirements);
+		if(m_reactors.BeginTick(_deltaTime)) m_reactors.Estimate(m_reactors.GetTickTime(), _requirements);
+		if(m_sensors.BeginTick(_deltaTime)) m_sensors.Estimate(m_sensors.GetTickTime(), _requirements);
+		if(m_shields.BeginTick(_deltaTime)) m_shields.Estimate(m_shields.GetTickTime(), _requirements);
+		if(m_storage.BeginTick(_deltaTime)) m_storage.Estimate(m_storage.GetTickTime(), _requirements);
+		if(m_weapons.BeginTick(_deltaTime)) m_weapons.Estimate(m_weapons.GetTickTime(), _requirements);
+
+		GatherEstimates();
+	}
 
+	void ComputerSystem::GatherEstimates()
+	{
 		m_energyDemand = m_batteries.m_energyDemand
 			+ m_drives.m_energyDemand
 			+ m_sensors.m_energyDemand
@@ -49,10 +59,54 @@ namespace Mechanics {
 
 	void ComputerSystem::Process(float _deltaTime, SystemRequierements& _provided)
 	{
-		if (m_script) g_scriptEngine.call<void, float>(m_script, m_energyMaxOut);
+		Distribute();
+
+		if(m_batteries.IsTicking()) m_batteries.Process(m_batteries.GetTickTime(), _provided);
+		if(m_drives.IsTicking()) m_drives.Process(m_drives.GetTickTime(), _provided);
+		if(m_reactors.IsTicking()) m_reactors.Process(m_reactors.GetTickTime(), _provided);
+		if(m_sensors.IsTicking()) m_sensors.Process(m_sensors.GetTickTime(), _provided);
+		if(m_shields.IsTicking()) m_shields.Process(m_shields.GetTickTime(), _provided);
+		if(m_storage.IsTicking()) m_storage.Process(m_storage.GetTickTime(), _provided);
+		if(m_weapons.IsTicking()) m_weapons.Process(m_weapons.GetTickTime(), _provided);
+	}
+
+	/// \brief Energy which is actually taken by a system in this step.
+	static float UsedEnergy(const ComponentSystem& _system)
+	{
+		// Skipped systems keep their share until they run again
+		return _system.IsTicking() ? _system.m_energyIn : 0.0f;
+	}
+
+	bool ComputerSystem::IsDistributionDue() const
+	{
+		// Between two distributions the last one is kept
+		return m_ship.GetTick() % TickIntervals::script == 0;
+	}
+
+	void ComputerSystem::Distribute()
+	{
+		if (IsDistributionDue() && !(m_script && m_script->Call(m_energyMaxOut)))
+			DistributeNative();
+		ApplyDistribution();
+	}
+
+	// Same order as scripts/energydefault.nrt: drives, sensors, shields, weapons.
+	void ComputerSystem::DistributeNative()
+	{
+		float available = m_energyMaxOut;
+		m_drives.m_energyIn = ei::min(m_drives.m_energyDemand, available);
+		available -= m_drives.m_energyIn;
+		m_sensors.m_energyIn = ei::min(m_sensors.m_energyDemand, available);
+		available -= m_sensors.m_energyIn;
+		m_shields.m_energyIn = ei::min(m_shields.m_energyDemand, available);
+		available -= m_shields.m_energyIn;
+		m_weapons.m_energyIn = ei::min(m_weapons.m_energyDemand, available);
+	}
 
-		float energyUsed = m_drives.m_energyIn + m_sensors.m_energyIn
-			+ m_shields.m_energyIn + m_weapons.m_energyIn;
+	void ComputerSystem::ApplyDistribution()
+	{
+		float energyUsed = UsedEnergy(m_drives) + UsedEnergy(m_sensors)
+			+ UsedEnergy(m_shields) + UsedEnergy(m_weapons);
 		//std::cout << /*(char*)&m_batteries.m_capacity - (char*)&m_batteries << std::endl;//*/&BatterySystem::m_capacity << std::endl;
 		// the distribution given by the script can not be done
 		if (energyUsed > m_energyMaxOut + 0.05f)
@@ -79,16 +133,6 @@ namespace Mechanics {
 		}
 
 		//int off = (char*)&m_batteries.m_capacity - (char*)&m_batteries;
-
-		m_batteries.Process(_deltaTime, _provided);
-		m_drives.Process(_deltaTime, _provided);
-		m_reactors.Process(_deltaTime, _provided);
-		m_sensors.Process(_deltaTime, _provided);
-		m_shields.Process(_deltaTime, _provided);
-		m_storage.Process(_deltaTime, _provided);
-		m_weapons.Process(_deltaTime, _provided);
-		for(auto sys : m_subSystems)
-			sys.Process(_deltaTime, _provided);
 	}
 
 	void ComputerSystem::OnAdd(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
@@ -102,13 +146,29 @@ namespace Mechanics {
 			else if(Voxel::TypeInfo::IsWeapon(_type)) m_weapons.OnAdd(_position, _type, _assignment);
 			else if(Voxel::TypeInfo::IsShield(_type)) m_shields.OnAdd(_position, _type, _assignment);
 			else if(Voxel::TypeInfo::IsSensor(_type)) m_sensors.OnAdd(_position, _type, _assignment);
-		} else {
-			// Push recursively
-			for(auto sys : m_subSystems)
-				sys.OnAdd(_position, _type, _assignment);
+		}
+	}
+
+	void ComputerSystem::OnRemove(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		if(m_id == _assignment) {
+			if(Voxel::TypeInfo::IsComputer(_type)) m_enabled = false;
+			else if(Voxel::TypeInfo::IsReactor(_type)) m_reactors.OnRemove(_position, _type, _assignment);
+			else if(Voxel::TypeInfo::IsStorage(_type)) m_storage.OnRemove(_position, _type, _assignment);
+			else if(Voxel::TypeInfo::IsBattery(_type)) m_batteries.OnRemove(_position, _type, _assignment);
+			else if(Voxel::TypeInfo::IsDrive(_type)) m_drives.OnRemove(_position, _type, _assignment);
+			else if(Voxel::TypeInfo::IsWeapon(_type)) m_weapons.OnRemove(_position, _type, _assignment);
+			else if(Voxel::TypeInfo::IsShield(_type)) m_shields.OnRemove(_position, _type, _assignment);
+			else if(Voxel::TypeInfo::IsSensor(_type)) m_sensors.OnRemove(_position, _type, _assignment);
 		}
 	}
 
+	// ************************************************************* //
+	void ComputerSystem::OnChange(const IVec3& _position)
+	{
+		m_drives.OnChange(_position);
+	}
+
 	// ************************************************************* //
 	void ComputerSystem::ClearSystem()
 	{
@@ -121,15 +181,20 @@ namespace Mechanics {
 		m_shields.ClearSystem();
 		m_storage.ClearSystem();
 		m_weapons.ClearSystem();
-		for(auto sys : m_subSystems)
-			sys.ClearSystem();
 	}
 
 	// ************************************************************* //
 	void ComputerSystem::Flash()
 	{
+		// The script globals now point to the systems of this computer.
+		// The previous owner would write into them as well.
+		if (s_scriptOwner && s_scriptOwner != this)
+			s_scriptOwner->m_script = nullptr;
+		s_scriptOwner = this;
+
 		m_scriptModule = g_scriptEngine.getModule("energydefault");
-		m_script = g_scriptEngine.getFuncHndl("distritbuteEnergy");
+		m_script = &Script::Runtime::GetFunction("distritbuteEnergy");
+		m_script->Resolve();
 	}
 
 	// ************************************************************* //
@@ -141,6 +206,8 @@ namespace Mechanics {
 		_file << "DriveSystem& " << m_drives.GetName() << " := 0a" << &m_drives << endl;
 		_file << "WeaponSystem& " << m_weapons.GetName() << " := 0a" << &m_weapons << endl;
 		_file << "BatterySystem& " << m_batteries.GetName() << " := 0a" << &m_batteries << endl;
+		_file << "SensorSystem& " << m_sensors.GetName() << " := 0a" << &m_sensors << endl;
+		_file << "ShieldSystem& " << m_shields.GetName() << " := 0a" << &m_shields << endl;
 	}
 
 	// ************************************************************* //
@@ -7,12 +7,15 @@
 #include "shieldsystem.hpp"
 #include "storagesystem.hpp"
 #include "weaponsystem.hpp"
-#include "utilities/scriptengineinst.hpp"
+#include "utilities/scriptruntime.hpp"
 #include <vector>
 
 namespace Mechanics {
 
 	/// \brief A computer maintains the resource distribution in a ship.
+	/// \details The methods only handle the own systems. Sub computers and
+	///		the energy flow between computers are handled by the EnergyNetwork
+	///		of the ship, which also routes components to their computer.
 	class ComputerSystem: public ComponentSystem
 	{
 	public:
@@ -22,10 +25,28 @@ namespace Mechanics {
 		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
 		virtual void Process(float _deltaTime, SystemRequierements& _provided) override;
 		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnChange(const ei::IVec3& _position) override;
 		virtual void ClearSystem() override;
 
+		/// \brief Sum the estimates of the own component systems (second
+		///		half of Estimate()).
+		void GatherEstimates();
+
+		/// \brief Run the distribution script and hand out the available
+		///		energy to the own component systems (first half of Process()).
+		/// \details If the script is disabled by the script runtime the
+		///		default distribution is done natively.
+		void Distribute();
+
+		const SensorSystem& GetSensors() const { return m_sensors; }
+		ShieldSystem& GetShields() { return m_shields; }
+		const ShieldSystem& GetShields() const { return m_shields; }
+
 	//	float TempGetCharge() const { return m_batteries.RelativeCharge(); }
 		// compiles the given script and reboots the system
+		// Must follow ExportSystems(), the script of the previously flashed
+		// computer is removed.
 		void Flash();
 		// writes all owned component systems to a script file.
 		void ExportSystems(std::ofstream& _file);
@@ -43,9 +64,27 @@ namespace Mechanics {
 		WeaponSystem m_weapons;						///< Handle all attached weapons (not these of the sub systems)
 		bool m_enabled;								///< The system is disabled if its computer voxel is destroyed. Repairing this ship reenables the system again.
 
-		NaReTi::FunctionHandle m_script;
+		Script::Function* m_script;					///< Energy distribution, nullptr if the script globals are bound to another computer
 		NaReTi::Module* m_scriptModule;
+
+		/// \brief The computer whose systems are bound to the script globals
+		///		(Drive, Weapons, ...) by the last ExportSystems() and Flash().
+		/// \details Only this computer may run the script, any other would
+		///		write the energy of its systems into the bound ones.
+		static ComputerSystem* s_scriptOwner;
+
+		/// \brief The energy must be distributed again in this step.
+		bool IsDistributionDue() const;
+		/// \brief Replacement of the default script for computers without
+		///		script and if the script is disabled or was skipped because
+		///		of its budget.
+		void DistributeNative();
+		/// \brief Check and complete the distribution of the script (second
+		///		half of Distribute()).
+		void ApplyDistribution();
 		friend class Ship;
+		friend class ComponentScheduler;
+		friend class EnergyNetwork;
 	};
 
 }
\ No newline at end of file
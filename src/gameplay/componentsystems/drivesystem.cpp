@@ -2,6 +2,7 @@
 #include "math/ray.hpp"
 #include "gameplay/ship.hpp"
 #include "utilities/color.hpp"
+#include "gameplay/replay.hpp"
 
 using namespace ei;
 using namespace Math;
@@ -17,7 +18,8 @@ namespace Mechanics {
 	DriveSystem::DriveSystem(class Ship& _theShip, unsigned _id) :
 		ComponentSystem(_theShip, "Drive", _id),
 		m_particles(Graphic::ParticleSystems::RenderType::BLOB),
-		m_rng(1091613067)
+		m_rng(Replay::NextSeed()),
+		m_maxEnergyDrain(0.0f)
 	{
 		m_particles.SetParticleSize(0.15f);
 	}
@@ -105,62 +107,99 @@ namespace Mechanics {
 		}
 	}
 
-	void DriveSystem::OnAdd(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	/// \brief A sampling direction of the thruster visibility.
+	struct DirectionSample
 	{
-		// Do not need to test the assignment (computer checks this for us)
-		Assert(_assignment == m_id, "Component added to the wrong drive system");
-		float thrust = Voxel::TypeInfo::GetThrust(_type);
-		float drain = Voxel::TypeInfo::GetEnergyDrain(_type);
-		m_maxEnergyDrain += drain;
-		// Iterate over a virtual cube map to increase sampling density.
-		// For each direction in the cube map make a visibility test.
+		Vec3 direction;
+		int splatIndex;			///< Index in the SphericalFunction
+	};
+
+	/// \brief Iterate over a virtual cube map to increase sampling density.
+	static std::vector<DirectionSample> CreateDirectionSamples()
+	{
+		std::vector<DirectionSample> samples;
 		Math::CubeMap<6, float> directionGenerator;
-		SphericalFunction newThrust, newTorque;
+		SphericalFunction indexer;
 		auto endit = directionGenerator.end();
-		Vec3 center = _position + Vec3(0.5f);
-		Vec3 centerDir = center - m_ship.GetCenter();
-		float centerDistance = len(centerDir);
-		Thruster newThruster;
-		newThruster.relativePosition = centerDir;
+		for(auto it = directionGenerator.begin(); it != endit; ++it)
+		{
+			DirectionSample sample;
+			sample.direction = it.direction();
+			sample.splatIndex = indexer.getSplatIndex( sample.direction );
+			samples.push_back(sample);
+		}
+		return samples;
+	}
+
+	// Created during static initialization. Systems of different ships may
+	// be set up in parallel.
+	static const std::vector<DirectionSample> g_directionSamples = CreateDirectionSamples();
+	static const std::vector<DirectionSample>& GetDirectionSamples()
+	{
+		return g_directionSamples;
+	}
+
+	// Maximum distance of occluders
+	const float RAY_RANGE = 100000.0f;
+
+	Ray DriveSystem::GetThrustRay(const Thruster& _thruster, int _sample)
+	{
+		Vec3 direction = GetDirectionSamples()[_sample].direction;
+		Ray ray(_thruster.voxel + Vec3(0.5f), -direction);
+		ray.origin += ray.direction * 1.414213562f;
+		return ray;
+	}
+
+	Ray DriveSystem::GetTorqueRay(const Thruster& _thruster, int _sample)
+	{
+		// Assume direction is not the direction of force but the rotation axis.
+		// Inverting the relation means, that axis is the direction in which we get
+		// the most torque.
+		Vec3 axis = normalize(cross(_thruster.relativePosition, GetDirectionSamples()[_sample].direction));	//// EI-CHECK normalize here could be wrong
+		return Ray(_thruster.voxel + Vec3(0.5f), axis);
+	}
+
+	void DriveSystem::CastSample(Thruster& _thruster, int _sample) const
+	{
+		// The occupancy grid of the ship replaces ray casts through the octree
+		const Voxel::OccupancyGrid& occupancy = m_ship.GetOccupancy();
+		_thruster.thrustHit[_sample] = RAY_RANGE;
+		occupancy.RayCast( GetThrustRay(_thruster, _sample), _thruster.thrustHit[_sample] );
+		_thruster.torqueHit[_sample] = RAY_RANGE;
+		occupancy.RayCast( GetTorqueRay(_thruster, _sample), _thruster.torqueHit[_sample] );
+	}
+
+	void DriveSystem::ComputeContribution(Thruster& _thruster)
+	{
+		const std::vector<DirectionSample>& samples = GetDirectionSamples();
+		SphericalFunction newThrust, newTorque;
 		// Count number of samples per direction to normalize.
-		int thrustCount[26] = {0};
-		int torqueCount[26] = {0};
+		int sampleCount[26] = {0};
 		byte freeThrustCount[26] = {0};
-		Voxel::Model::ModelData::HitResult hit; // Dummy
-		for(auto it = directionGenerator.begin(); it != endit; ++it)
+		for(int s = 0; s < NUM_VISIBILITY_SAMPLES; ++s)
 		{
-			// Do ray casts directly in model space
-			Vec3 direction = it.direction();
-			Ray ray(center, -direction);
-			float distance = 100000.0f;
-			ray.origin += ray.direction * 1.414213562f;
-			
-			float force = thrust;
-			int idx = newThrust.getSplatIndex( direction );
+			Vec3 direction = samples[s].direction;
+			int idx = samples[s].splatIndex;
 
 			// Only if nothing is visible the drive can fire into this direction.
 			// In occluded directions there is thrust=0. Because this results in bad
 			// game play use 10% instead.
-			if(m_ship.GetVoxelTree().RayCast( ray, 0, hit, distance ))
+			float force = _thruster.force;
+			if(_thruster.thrustHit[s] < RAY_RANGE)
 				force *= 0.1f;
 			else
 				++freeThrustCount[idx];
 
 			// Divide the force into a rotation and a forward thrust.
-			Vec3 axis = normalize(cross(centerDir, direction));	//// EI-CHECK normalize here could be wrong
+			Vec3 axis = normalize(cross(_thruster.relativePosition, direction));	//// EI-CHECK normalize here could be wrong
 			newThrust[idx][0] += force;
 			newThrust[idx][1] += axis[0] * force;
 			newThrust[idx][2] += axis[1] * force;
 			newThrust[idx][3] += axis[2] * force;
-			++thrustCount[idx];
-
-			// Now assume direction is not the direction of force but the rotation axis.
-			// Inverting the relation means, that axis is the direction in which we get
-			// the most torque.
-			ray = Ray(center, axis);
-			distance = 100000.0f;
-			force = thrust;
-			if(m_ship.GetVoxelTree().RayCast( ray, 0, hit, distance ))
+			++sampleCount[idx];
+
+			force = _thruster.force;
+			if(_thruster.torqueHit[s] < RAY_RANGE)
 				force *= 0.1f;
 			float torque = len(axis) * force;
 			newTorque[idx][0] += torque;
@@ -168,25 +207,100 @@ namespace Mechanics {
 			newTorque[idx][1] += force * axis[0];
 			newTorque[idx][2] += force * axis[1];
 			newTorque[idx][3] += force * axis[2];
-			++torqueCount[idx];
 		}
 		// The bitmask and the cube-maps have different indices.
 		// The map connects them both such that the results can be reused for the mask.
 		static byte REMAP[26] = {25, 16, 8, 22, 13, 5, 19, 11, 2, 23, 14, 6, 20, 12, 3, 17, 9, 0, 24, 15, 7, 18, 10, 1, 21, 4};
 		for(int i=0; i<26; ++i)
 		{
-			m_maxThrust[i] += newThrust[i] / max((float)thrustCount[i], 1e-6f);
-			m_maxTorque[i] += newTorque[i] / max((float)torqueCount[i], 1e-6f);
-			newThruster.freeField.setBit(REMAP[i], freeThrustCount[i] / float(thrustCount[i]) >= 0.5f);
+			_thruster.thrust[i] = newThrust[i] / max((float)sampleCount[i], 1e-6f);
+			_thruster.torque[i] = newTorque[i] / max((float)sampleCount[i], 1e-6f);
+			_thruster.freeField.setBit(REMAP[i], freeThrustCount[i] / float(sampleCount[i]) >= 0.5f);
+		}
+	}
+
+	void DriveSystem::AddContribution(const Thruster& _thruster, float _scale)
+	{
+		m_maxEnergyDrain += _scale * _thruster.energyDrain;
+		for(int i=0; i<26; ++i)
+		{
+			m_maxThrust[i] += _scale * _thruster.thrust[i];
+			m_maxTorque[i] += _scale * _thruster.torque[i];
 		}
+	}
+
+	void DriveSystem::OnAdd(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		// Do not need to test the assignment (computer checks this for us)
+		Assert(_assignment == m_id, "Component added to the wrong drive system");
+		Thruster newThruster;
+		newThruster.relativePosition = _position + Vec3(0.5f) - m_ship.GetCenter();
+		newThruster.voxel = _position;
+		newThruster.force = Voxel::TypeInfo::GetThrust(_type);
+		newThruster.energyDrain = Voxel::TypeInfo::GetEnergyDrain(_type);
+		// For each direction in the cube map make a visibility test.
+		for(int s = 0; s < NUM_VISIBILITY_SAMPLES; ++s)
+			CastSample(newThruster, s);
+		ComputeContribution(newThruster);
+		AddContribution(newThruster, 1.0f);
+		m_thrusterIndices[ComponentKey(_position)] = (int)m_thrusters.size();
 		m_thrusters.push_back(newThruster);
 	}
 
+	void DriveSystem::OnRemove(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		auto it = m_thrusterIndices.find(ComponentKey(_position));
+		if( it == m_thrusterIndices.end() ) return;
+		int index = it->second;
+		m_thrusterIndices.erase(it);
+
+		// Subtract exactly what was added
+		AddContribution(m_thrusters[index], -1.0f);
+
+		// Move the last thruster into the gap
+		if( index != (int)m_thrusters.size() - 1 )
+		{
+			m_thrusters[index] = m_thrusters.back();
+			m_thrusterIndices[ComponentKey(m_thrusters[index].voxel)] = index;
+		}
+		m_thrusters.pop_back();
+	}
+
+	void DriveSystem::OnChange(const IVec3& _position)
+	{
+		// Only directions whose rays pass the changed voxel before their
+		// current occluder can change.
+		Box box(Vec3(_position), Vec3(_position + 1));
+		for(auto& thruster : m_thrusters)
+		{
+			bool changed = false;
+			for(int s = 0; s < NUM_VISIBILITY_SAMPLES; ++s)
+			{
+				float thrustDist, torqueDist;
+				bool thrustAffected = intersects(GetThrustRay(thruster, s), box, thrustDist) && thrustDist <= thruster.thrustHit[s] + 1e-3f;
+				bool torqueAffected = intersects(GetTorqueRay(thruster, s), box, torqueDist) && torqueDist <= thruster.torqueHit[s] + 1e-3f;
+				if( thrustAffected || torqueAffected )
+				{
+					CastSample(thruster, s);
+					changed = true;
+				}
+			}
+			if( changed )
+			{
+				AddContribution(thruster, -1.0f);
+				ComputeContribution(thruster);
+				AddContribution(thruster, 1.0f);
+			}
+		}
+	}
+
 	void DriveSystem::ClearSystem()
 	{
 		m_maxTorque = Math::SphericalFunction();
 		m_maxThrust = Math::SphericalFunction();
 		m_thrusters.clear();
+		m_thrusterIndices.clear();
+		m_maxEnergyDrain = 0.0f;
 	}
 
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "math/sphericalfunction.hpp"
 #include "graphic/highlevel/particlesystem.hpp"
 #include "generators/random.hpp"
+#include <unordered_map>
 
 namespace Mechanics {
 
@@ -14,6 +15,8 @@ namespace Mechanics {
 		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
 		virtual void Process(float _deltaTime, SystemRequierements& _provided) override;
 		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnChange(const ei::IVec3& _position) override;
 		virtual void ClearSystem() override;
 	private:
 		ei::Vec3 m_currentThrust;
@@ -25,14 +28,40 @@ namespace Mechanics {
 		// If maximum torque is generated how much does this influence the thrust
 		float m_maxEnergyDrain;
 
+		/// \brief Number of directions in which the visibility of each
+		///		thruster is sampled.
+		static const int NUM_VISIBILITY_SAMPLES = Math::CubeMap<6, float>::SAMPLE_COUNT;
+
 		struct Thruster
 		{
 			ei::Vec3 relativePosition;			///< Thruster position relative to the mass center.
 			Math::SphBitMask freeField;			///< 1 if the thruster can fire into that direction (interpolates between a few discrete samples)
+			ei::IVec3 voxel;					///< Position of the component in the ship model
+			float force;						///< Thrust of the component type
+			float energyDrain;
+			/// Cached ray cast results per sample direction. The distance to
+			/// the first occluder or RAY_RANGE if the direction is free.
+			float thrustHit[NUM_VISIBILITY_SAMPLES];
+			float torqueHit[NUM_VISIBILITY_SAMPLES];
+			ei::Vec4 thrust[26];				///< Contribution to m_maxThrust
+			ei::Vec4 torque[26];				///< Contribution to m_maxTorque
 		};
 		std::vector<Thruster> m_thrusters;
+		std::unordered_map<uint64_t, int> m_thrusterIndices;	///< Index in m_thrusters by ComponentKey()
 		Generators::Random m_rng;
 
+		/// \brief Ray along which the thruster pushes into the given sample direction.
+		static ei::Ray GetThrustRay(const Thruster& _thruster, int _sample);
+		/// \brief Ray along the axis of the torque which is generated by
+		///		thrust into the given sample direction.
+		static ei::Ray GetTorqueRay(const Thruster& _thruster, int _sample);
+		/// \brief Refresh the cached ray casts of one sample direction.
+		void CastSample(Thruster& _thruster, int _sample) const;
+		/// \brief Compute thrust, torque and free field from the cached ray casts.
+		static void ComputeContribution(Thruster& _thruster);
+		/// \brief Add (_scale = 1) or subtract (_scale = -1) a thruster from the maxima.
+		void AddContribution(const Thruster& _thruster, float _scale);
+
 		Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION | Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME | Graphic::PSComponent::COLOR> m_particles;
 
 		friend class Ship;
@@ -0,0 +1,120 @@
+#include "energynetwork.hpp"
+#include "computersystem.hpp"
+
+using namespace ei;
+
+namespace Mechanics {
+
+	EnergyNetwork::EnergyNetwork(ComputerSystem& _root) :
+		m_root(_root),
+		m_dirty(true)
+	{
+	}
+
+	// ************************************************************* //
+	const std::vector<ComputerSystem*>& EnergyNetwork::GetNodes()
+	{
+		if( m_dirty ) Compile();
+		return m_nodes;
+	}
+
+	// ************************************************************* //
+	ComputerSystem* EnergyNetwork::Find(uint8 _id)
+	{
+		if( m_dirty ) Compile();
+		return m_table[_id] >= 0 ? m_nodes[m_table[_id]] : nullptr;
+	}
+
+	// ************************************************************* //
+	void EnergyNetwork::Compile()
+	{
+		m_nodes.clear();
+		m_parents.clear();
+		for( int i = 0; i < MAX_NODES; ++i )
+			m_table[i] = -1;
+		AddNode(m_root, -1);
+		m_requests.resize(m_nodes.size());
+		m_childRequests.resize(m_nodes.size());
+		m_grantRatios.resize(m_nodes.size());
+		m_dirty = false;
+	}
+
+	void EnergyNetwork::AddNode(ComputerSystem& _computer, int _parent)
+	{
+		// Pre-order: parents always come before their children
+		int index = (int)m_nodes.size();
+		m_nodes.push_back(&_computer);
+		m_parents.push_back(_parent);
+		m_table[_computer.m_id] = (int16)index;
+		for( auto& sub : _computer.m_subSystems )
+			AddNode(sub, index);
+	}
+
+	// ************************************************************* //
+	void EnergyNetwork::Estimate(float _deltaTime, SystemRequierements& _requirements)
+	{
+		if( m_dirty ) Compile();
+		for( auto computer : m_nodes )
+			computer->Estimate(_deltaTime, _requirements);
+	}
+
+	// ************************************************************* //
+	float EnergyNetwork::SupplyDemand(const ComputerSystem& _computer)
+	{
+		return _computer.m_energyDemand - _computer.m_batteries.m_energyDemand;
+	}
+
+	void EnergyNetwork::Solve()
+	{
+		if( m_dirty ) Compile();
+		int numNodes = (int)m_nodes.size();
+		// Backward: each node asks its parent for what it and its children
+		// cannot cover on their own.
+		for( int i = 0; i < numNodes; ++i )
+			m_childRequests[i] = 0.0f;
+		for( int i = numNodes - 1; i >= 0; --i )
+		{
+			const ComputerSystem& computer = *m_nodes[i];
+			m_requests[i] = max(0.0f, SupplyDemand(computer) + m_childRequests[i] - computer.m_energyMaxOut);
+			if( m_parents[i] >= 0 )
+				m_childRequests[m_parents[i]] += m_requests[i];
+		}
+
+		// Forward: the own systems come first, the rest is split between the
+		// children in proportion to their requests.
+		for( int i = 0; i < numNodes; ++i )
+		{
+			ComputerSystem& computer = *m_nodes[i];
+			if( m_parents[i] >= 0 )
+				computer.m_energyMaxOut += m_requests[i] * m_grantRatios[m_parents[i]];
+			float spare = max(0.0f, computer.m_energyMaxOut - SupplyDemand(computer));
+			m_grantRatios[i] = m_childRequests[i] > 0.0f ? min(1.0f, spare / m_childRequests[i]) : 0.0f;
+			computer.m_energyMaxOut -= m_childRequests[i] * m_grantRatios[i];
+		}
+	}
+
+	// ************************************************************* //
+	void EnergyNetwork::Process(float _deltaTime, SystemRequierements& _provided)
+	{
+		if( m_dirty ) Compile();
+		for( auto computer : m_nodes )
+			computer->Process(_deltaTime, _provided);
+	}
+
+	// ************************************************************* //
+	void EnergyNetwork::ClearSystems()
+	{
+		if( m_dirty ) Compile();
+		for( auto computer : m_nodes )
+			computer->ClearSystem();
+	}
+
+	// ************************************************************* //
+	void EnergyNetwork::OnChange(const IVec3& _position)
+	{
+		if( m_dirty ) Compile();
+		for( auto computer : m_nodes )
+			computer->OnChange(_position);
+	}
+
+}
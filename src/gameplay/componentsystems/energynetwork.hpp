@@ -0,0 +1,76 @@
+#pragma once
+
+#include "componentsystem.hpp"
+#include <vector>
+
+namespace Mechanics {
+
+	/// \brief The computers of a ship as a flat energy network.
+	/// \details Each computer is a node. The nodes are stored in topological
+	///		order (every computer before its sub computers), so the network
+	///		is solved with one sweep in each direction instead of a recursion
+	///		over the hierarchy. A table maps the system ids (0-255) directly to
+	///		the nodes, so components find their computer without walking the
+	///		hierarchy.
+	///
+	///		Energy is shared along the hierarchy: the own systems of a
+	///		computer are supplied first, the rest of its output covers the
+	///		shortfall of its sub computers. Charging batteries is no
+	///		shortfall, they only get what is left afterwards.
+	///		Sub computers are not created yet (ComputerSystem::m_subSystems
+	///		stays empty), so currently the network has a single node.
+	///
+	///		The network is compiled lazily after Invalidate(), which must be
+	///		called whenever computers are added or removed.
+	class EnergyNetwork
+	{
+	public:
+		static const int MAX_NODES = 256;		///< Number of system ids
+
+		/// \param [in] _root The primary computer of the ship.
+		EnergyNetwork(ComputerSystem& _root);
+
+		/// \brief Recompile before the next use.
+		void Invalidate()			{ m_dirty = true; }
+
+		/// \brief All computers in topological order.
+		const std::vector<ComputerSystem*>& GetNodes();
+
+		/// \brief Computer which owns the given system id or nullptr.
+		ComputerSystem* Find(uint8 _id);
+
+		/// \brief Estimate the own systems of all computers.
+		void Estimate(float _deltaTime, SystemRequierements& _requirements);
+
+		/// \brief Move the available energy between the computers.
+		/// \details Must run after all estimates and before any distribution.
+		///		Afterwards m_energyMaxOut of each computer is the energy which
+		///		its own systems may use.
+		void Solve();
+
+		/// \brief Distribute and process the own systems of all computers.
+		void Process(float _deltaTime, SystemRequierements& _provided);
+
+		/// \brief Reset all computers before a full recomputation.
+		void ClearSystems();
+
+		/// \brief Forward an occupancy change to all computers.
+		void OnChange(const ei::IVec3& _position);
+	private:
+		ComputerSystem& m_root;
+		std::vector<ComputerSystem*> m_nodes;
+		std::vector<int> m_parents;			///< Index of the parent node, -1 for the root
+		std::vector<float> m_requests;		///< Energy a node needs from its parent (Solve())
+		std::vector<float> m_childRequests;	///< Sum of the requests of the direct children
+		std::vector<float> m_grantRatios;	///< Satisfied fraction of the child requests
+		int16 m_table[MAX_NODES];			///< Node index by system id or -1
+		bool m_dirty;
+
+		void Compile();
+		void AddNode(ComputerSystem& _computer, int _parent);
+		/// \brief Demand of the own systems without the batteries. Only this
+		///		part may be requested from the parent.
+		static float SupplyDemand(const ComputerSystem& _computer);
+	};
+
+}
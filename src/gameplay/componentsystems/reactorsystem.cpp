@@ -16,6 +16,11 @@ namespace Mechanics {
 		m_totalEnergyOut += Voxel::TypeInfo::GetEnergyOut( _type );
 	}
 
+	void ReactorSystem::OnRemove(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		m_totalEnergyOut -= Voxel::TypeInfo::GetEnergyOut( _type );
+	}
+
 	void ReactorSystem::ClearSystem()
 	{
 		m_totalEnergyOut = 0;
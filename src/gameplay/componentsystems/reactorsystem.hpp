@@ -7,10 +7,11 @@ namespace Mechanics {
 	class ReactorSystem: public ComponentSystem
 	{
 	public:
-		ReactorSystem(Ship& _theShip, unsigned _id) : ComponentSystem(_theShip, "Reactor", _id) {}
+		ReactorSystem(Ship& _theShip, unsigned _id) : ComponentSystem(_theShip, "Reactor", _id) { m_tickInterval = TickIntervals::reactor; }
 
 		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
 		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
 		virtual void ClearSystem() override;
 	private:
 		float m_totalEnergyOut;		///< J/s energy production.
@@ -0,0 +1,160 @@
+#include "sensorsystem.hpp"
+#include "gameplay/ship.hpp"
+#include "voxel/voxel.hpp"
+
+using namespace ei;
+
+namespace Mechanics {
+
+	SensorSystem::SensorSystem(Ship& _theShip, unsigned _id) :
+		ComponentSystem(_theShip, "Sensors", _id),
+		m_range(0.0f),
+		m_resolution(0.0f),
+		m_energyDrain(0.0f),
+		m_scanRange(0.0f),
+		m_scanDue(false),
+		m_numScans(0)
+	{
+		m_tickInterval = TickIntervals::sensor;
+	}
+
+	void SensorSystem::Estimate(float _deltaTime, SystemRequierements& _requirements)
+	{
+		m_energyDemand = m_energyDrain * _deltaTime;
+	}
+
+	void SensorSystem::Process(float _deltaTime, SystemRequierements& _provided)
+	{
+		if( m_sensors.empty() ) return;
+		// Less energy reduces the range with the inverse square law
+		float supply = m_energyDemand > 0.0f ? min(1.0f, m_energyIn / m_energyDemand) : 1.0f;
+		m_scanRange = m_range * sqrt(supply);
+		m_scanDue = true;
+	}
+
+	void SensorSystem::OnAdd(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		SensorInformation sensor;
+		sensor.key = ComponentKey(_position);
+		sensor.range = Voxel::TypeInfo::GetRange(_type);
+		sensor.resolution = Voxel::TypeInfo::GetSensorResolution(_type);
+		m_sensors.push_back(sensor);
+		m_energyDrain += Voxel::TypeInfo::GetEnergyDrain(_type);
+		UpdateParameters();
+	}
+
+	void SensorSystem::OnRemove(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		uint64_t key = ComponentKey(_position);
+		for( size_t i = 0; i < m_sensors.size(); ++i )
+			if( m_sensors[i].key == key )
+			{
+				m_sensors[i] = m_sensors.back();
+				m_sensors.pop_back();
+				m_energyDrain -= Voxel::TypeInfo::GetEnergyDrain(_type);
+				break;
+			}
+		UpdateParameters();
+	}
+
+	void SensorSystem::ClearSystem()
+	{
+		m_sensors.clear();
+		m_energyDrain = 0.0f;
+		UpdateParameters();
+	}
+
+	void SensorSystem::UpdateParameters()
+	{
+		// Sensors work together like one larger aperture: the range grows
+		// with the square root of the summed squares.
+		float rangeSq = 0.0f;
+		m_resolution = 0.0f;
+		for( auto& sensor : m_sensors )
+		{
+			rangeSq += sensor.range * sensor.range;
+			m_resolution = m_resolution == 0.0f ? sensor.resolution : min(m_resolution, sensor.resolution);
+		}
+		m_range = sqrt(rangeSq);
+	}
+
+	// ************************************************************* //
+	void SensorSystem::Scan(const std::vector<SOHandle>& _objects, const std::vector<int>& _candidates)
+	{
+		const Math::FixVec3& center = m_ship.GetPosition();
+		uint32 ownID = m_ship.GetID();
+
+		m_newContacts.clear();
+		for( int i : _candidates )
+		{
+			const ISceneObject& object = *_objects[i];
+			if( object.GetID() == ownID || object.IsDeleted() ) continue;
+			// Closest point of the bounding box
+			Vec3 boxMin = Vec3(object.GetBoundingBoxMin() - center);
+			Vec3 boxMax = Vec3(object.GetBoundingBoxMax() - center);
+			if( lensq(max(boxMin, min(boxMax, Vec3(0.0f)))) > m_scanRange * m_scanRange ) continue;
+			// Apparent size
+			float distance = len((boxMin + boxMax) * 0.5f);
+			float radius = len(boxMax - boxMin) * 0.5f;
+			if( radius < m_resolution * distance ) continue;
+
+			SensorContact contact = {_objects[i], object.GetID(), distance};
+			m_newContacts.push_back(std::move(contact));
+		}
+
+		// Both lists are sorted by id
+		m_events.clear();
+		auto oldIt = m_contacts.begin();
+		auto newIt = m_newContacts.begin();
+		while( oldIt != m_contacts.end() || newIt != m_newContacts.end() )
+		{
+			if( newIt == m_newContacts.end() || (oldIt != m_contacts.end() && oldIt->id < newIt->id) )
+			{
+				SensorEvent event = {SensorEvent::Type::LEAVE, oldIt->object};
+				m_events.push_back(std::move(event));
+				++oldIt;
+			} else if( oldIt == m_contacts.end() || newIt->id < oldIt->id )
+			{
+				SensorEvent event = {SensorEvent::Type::ENTER, newIt->object};
+				m_events.push_back(std::move(event));
+				++newIt;
+			} else {
+				++oldIt;
+				++newIt;
+			}
+		}
+		m_contacts.swap(m_newContacts);
+		++m_numScans;
+		m_scanDue = false;
+	}
+
+	// ************************************************************* //
+	const SensorContact* SensorSystem::GetNearestContact() const
+	{
+		const SensorContact* nearest = nullptr;
+		for( auto& contact : m_contacts )
+			if( !nearest || contact.distance < nearest->distance )
+				nearest = &contact;
+		return nearest;
+	}
+
+	// ************************************************************* //
+	float SensorSystem::_ContactDistance(SensorSystem* _this, int _index)
+	{
+		if( _index < 0 || _index >= (int)_this->m_contacts.size() ) return -1.0f;
+		return _this->m_contacts[_index].distance;
+	}
+
+	int SensorSystem::_NumEntered(SensorSystem* _this)
+	{
+		int count = 0;
+		for( auto& event : _this->m_events )
+			if( event.type == SensorEvent::Type::ENTER ) ++count;
+		return count;
+	}
+
+	int SensorSystem::_NumLeft(SensorSystem* _this)
+	{
+		return (int)_this->m_events.size() - _NumEntered(_this);
+	}
+}
@@ -1,14 +1,108 @@
 #pragma once
 
 #include "componentsystem.hpp"
+#include "gameplay/sceneobject.hpp"
+#include <vector>
+
+class SceneGraph;
 
 namespace Mechanics {
 
+	/// \brief An object seen by the sensors of a ship.
+	struct SensorContact
+	{
+		SOHandle object;
+		uint32 id;				///< Scene id of the object, contacts are sorted by it
+		float distance;			///< Distance between the centers at the last scan
+	};
+
+	/// \brief A contact which appeared or disappeared in the last scan.
+	struct SensorEvent
+	{
+		enum struct Type: uint8
+		{
+			ENTER,
+			LEAVE
+		};
+		Type type;
+		SOHandle object;
+	};
+
+	/// \brief Keeps a table of all objects in the range of the sensors.
+	/// \details The scene scans the surrounding of a ship with a sphere query
+	///		in the steps in which the system ticks (TickIntervals::sensor).
+	///		Each scan is merged into the sorted contact table and produces
+	///		enter and leave events, so the costs depend on the number of
+	///		contacts and not on the number of objects in the scene.
+	///
+	///		Objects are detected if they are in range and their apparent
+	///		angular size is at least the resolution. Without enough energy
+	///		the range shrinks.
 	class SensorSystem: public ComponentSystem
 	{
 	public:
-		SensorSystem(Ship& _theShip, unsigned _id) : ComponentSystem(_theShip, "Sensors", _id) {}
+		SensorSystem(Ship& _theShip, unsigned _id);
+
+		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
+		virtual void Process(float _deltaTime, SystemRequierements& _provided) override;
+		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void ClearSystem() override;
+
+		/// \brief The system processed in this step and must scan the scene.
+		bool IsScanDue() const		{ return m_scanDue; }
+		/// \brief Range of the current scan in meters.
+		float GetScanRange() const	{ return m_scanRange; }
+
+		/// \brief Update the contacts from the result of a broadphase query.
+		/// \param [in] _objects The object list of the scene sorted by id.
+		/// \param [in] _candidates Ascending indices of all objects whose
+		///		bounding boxes may be in range.
+		void Scan(const std::vector<SOHandle>& _objects, const std::vector<int>& _candidates);
+
+		/// \brief All objects found in the last scan sorted by id.
+		const std::vector<SensorContact>& GetContacts() const	{ return m_contacts; }
+		/// \brief Changes of the last scan.
+		const std::vector<SensorEvent>& GetEvents() const		{ return m_events; }
+		/// \brief Number of scans so far. Changes whenever the contacts and
+		///		events were replaced.
+		uint32 GetNumScans() const								{ return m_numScans; }
+
+		/// \brief Closest contact or nullptr.
+		const SensorContact* GetNearestContact() const;
+
+		// Script interface
+		static int _NumContacts(SensorSystem* _this) { return (int)_this->m_contacts.size(); }
+		static float _ContactDistance(SensorSystem* _this, int _index);
+		static int _NumEntered(SensorSystem* _this);
+		static int _NumLeft(SensorSystem* _this);
 	private:
+		/// \brief Properties of a single sensor component.
+		struct SensorInformation
+		{
+			uint64_t key;		///< ComponentKey() of the voxel
+			float range;
+			float resolution;
+		};
+		std::vector<SensorInformation> m_sensors;
+		float m_range;				///< Combined range of all sensors
+		float m_resolution;			///< Best angular resolution of all sensors (radians)
+		float m_energyDrain;		///< Energy per second to run all sensors
+
+		float m_scanRange;
+		bool m_scanDue;
+		uint32 m_numScans;
+		std::vector<SensorContact> m_contacts;
+		std::vector<SensorContact> m_newContacts;	///< Recycled memory for Scan()
+		std::vector<SensorEvent> m_events;
+
+		std::vector<uint32> m_queryIDs;				///< Recycled memory of the scene queries
+		std::vector<int> m_queryIndices;
+
+		/// \brief Recompute range and resolution from all sensors.
+		void UpdateParameters();
+
+		friend class ::SceneGraph;
 	};
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,70 @@
+#include "shieldsystem.hpp"
+#include "gameplay/ship.hpp"
+#include "voxel/voxel.hpp"
+
+using namespace ei;
+
+namespace Mechanics {
+
+	const float ShieldSystem::CAPACITY_TIME = 10.0f;
+	const float ShieldSystem::MARGIN = 2.0f;
+
+	ShieldSystem::ShieldSystem(Ship& _theShip, unsigned _id) :
+		ComponentSystem(_theShip, "Shield", _id),
+		m_regeneration(0.0f),
+		m_energyDrain(0.0f),
+		m_charge(0.0f)
+	{
+	}
+
+	void ShieldSystem::Estimate(float _deltaTime, SystemRequierements& _requirements)
+	{
+		// Only ask for the energy which is needed to fill up
+		float missing = GetCapacity() - m_charge;
+		if( missing <= 0.0f || m_regeneration <= 0.0f )
+			m_energyDemand = 0.0f;
+		else
+			m_energyDemand = m_energyDrain * _deltaTime * min(1.0f, missing / (m_regeneration * _deltaTime));
+	}
+
+	void ShieldSystem::Process(float _deltaTime, SystemRequierements& _provided)
+	{
+		// Components may have been removed
+		m_charge = min(m_charge, GetCapacity());
+		if( m_energyDemand <= 0.0f ) return;
+
+		float supply = min(1.0f, m_energyIn / m_energyDemand);
+		m_charge = min(GetCapacity(), m_charge + m_regeneration * _deltaTime * supply);
+	}
+
+	void ShieldSystem::OnAdd(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		m_regeneration += Voxel::TypeInfo::GetShieldRegeneration(_type);
+		m_energyDrain += Voxel::TypeInfo::GetEnergyDrain(_type);
+	}
+
+	void ShieldSystem::OnRemove(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		m_regeneration -= Voxel::TypeInfo::GetShieldRegeneration(_type);
+		m_energyDrain -= Voxel::TypeInfo::GetEnergyDrain(_type);
+	}
+
+	void ShieldSystem::ClearSystem()
+	{
+		// The charge survives a recomputation of the systems
+		m_regeneration = 0.0f;
+		m_energyDrain = 0.0f;
+	}
+
+	float ShieldSystem::GetRadius() const
+	{
+		return m_ship.GetRadius() + MARGIN;
+	}
+
+	bool ShieldSystem::Absorb(float _damage)
+	{
+		if( !IsUp() ) return false;
+		m_charge = max(0.0f, m_charge - _damage);
+		return true;
+	}
+}
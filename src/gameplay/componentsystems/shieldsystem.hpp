@@ -4,11 +4,46 @@
 
 namespace Mechanics {
 
+	/// \brief An energy hull around the ship which absorbs hits before they
+	///		reach the voxels.
+	/// \details The hull is the bounding sphere of the ship plus a margin.
+	///		Batched ray queries of weapons test it analytically before they
+	///		traverse any octree (see SceneGraph::RayQueryBatch()), so a hit on
+	///		a shielded ship costs one ray-sphere test and no voxel edit.
+	///
+	///		The generators store CAPACITY_TIME seconds of their regeneration
+	///		as charge. Recharging takes energy like any other system. A hit
+	///		which is larger than the remaining charge collapses the shield
+	///		and the rest of its damage is lost.
 	class ShieldSystem: public ComponentSystem
 	{
 	public:
-		ShieldSystem(Ship& _theShip, unsigned _id) : ComponentSystem(_theShip, "Shield", _id) {}
+		ShieldSystem(Ship& _theShip, unsigned _id);
+
+		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
+		virtual void Process(float _deltaTime, SystemRequierements& _provided) override;
+		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void ClearSystem() override;
+
+		/// \brief Can the shield absorb a hit?
+		bool IsUp() const				{ return m_charge > 0.0f; }
+		/// \brief Remaining hit points.
+		float GetCharge() const			{ return m_charge; }
+		float GetCapacity() const		{ return m_regeneration * CAPACITY_TIME; }
+		/// \brief Radius of the hull around the center of mass of the ship.
+		float GetRadius() const;
+
+		/// \brief Reduce the charge by the damage of a hit.
+		/// \return false if the shield is down and the hit passes through.
+		bool Absorb(float _damage);
+
+		static const float CAPACITY_TIME;	///< Seconds of regeneration which can be stored
+		static const float MARGIN;			///< Distance between the hull and the bounding sphere
 	private:
+		float m_regeneration;		///< Hit points per second with full energy supply
+		float m_energyDrain;		///< Energy per second while regenerating
+		float m_charge;				///< Current hit points
 	};
 
-}
\ No newline at end of file
+}
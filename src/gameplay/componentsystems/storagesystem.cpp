@@ -15,6 +15,11 @@ namespace Mechanics {
 		m_storageVolume += Voxel::TypeInfo::GetStorageVolume(_type);
 	}
 
+	void StorageSystem::OnRemove(const IVec3& _position, Voxel::ComponentType _type, uint8 _assignment)
+	{
+		m_storageVolume -= Voxel::TypeInfo::GetStorageVolume(_type);
+	}
+
 	void StorageSystem::ClearSystem()
 	{
 		m_storageVolume = 0;
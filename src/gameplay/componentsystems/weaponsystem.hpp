@@ -1,9 +1,10 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "componentsystem.hpp"
-#include "graphic/highlevel/particlesystem.hpp"
+#include "gameplay/firemanager.hpp"
 
 namespace Mechanics {
 
@@ -21,8 +22,13 @@ namespace Mechanics {
 		float speed;
 
 		ei::Vec3 position; ///< relative position
+		ei::IVec3 voxel; ///< position of the component in the ship model
 	};
 
+	/// \brief A group of weapons which fire together.
+	/// \details All shots of a tick are collected and submitted to the
+	///		FireManager as one batch. Muzzle flashes are spawned by the
+	///		FireManager into a system shared by all ships.
 	class WeaponSystem: public ComponentSystem
 	{
 	public:
@@ -31,6 +37,7 @@ namespace Mechanics {
 		virtual void Estimate(float _deltaTime, SystemRequierements& _requirements) override;
 		virtual void Process(float _deltaTime, SystemRequierements& _provided) override;
 		virtual void OnAdd(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
+		virtual void OnRemove(const ei::IVec3& _position, Voxel::ComponentType _type, uint8 _assignment) override;
 		virtual void ClearSystem() override;
 
 		void SetTarget(const ei::Vec3& _target) { m_target = _target; };
@@ -45,15 +52,9 @@ namespace Mechanics {
 		bool m_firing;		///< should the weapons fire when loaded
 
 		std::vector < WeaponInformation > m_weapons;
+		std::unordered_map<uint64_t, int> m_weaponIndices;	///< Index in m_weapons by ComponentKey()
 
-		Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION 
-			| Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME 
-			| Graphic::PSComponent::COLOR | Graphic::PSComponent::SIZE 
-			| Graphic::PSComponent::DIRECTION> m_particles;
-
-		Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION
-			| Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME
-			| Graphic::PSComponent::COLOR | Graphic::PSComponent::SIZE> m_muzzleFlash;
+		FireBatch m_shots;		///< Shots of the current tick, recycled memory
 	};
 
 }
\ No newline at end of file
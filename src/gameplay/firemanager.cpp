@@ -1,42 +1,173 @@
 #include "firemanager.hpp"
 #include "../voxel/voxel.hpp"
+#include "ship.hpp"
+#include "utilities/color.hpp"
+#include <algorithm>
+
+using namespace ei;
 
 FireManager* g_fireManager;
 
+const float MAX_BEAM_LENGTH = 100.f;
+
+// Strict weak order on the content of a request to get a thread independent order.
+static bool RequestOrder(const FireRayInfo& _lhs, const FireRayInfo& _rhs)
+{
+	for(int i = 0; i < 3; ++i)
+		if(!(_lhs.ray.origin[i] == _rhs.ray.origin[i])) return _lhs.ray.origin[i] < _rhs.ray.origin[i];
+	for(int i = 0; i < 3; ++i)
+		if(_lhs.ray.direction[i] != _rhs.ray.direction[i]) return _lhs.ray.direction[i] < _rhs.ray.direction[i];
+	if(_lhs.damage != _rhs.damage) return _lhs.damage < _rhs.damage;
+	return _lhs.range < _rhs.range;
+}
+
 FireManager::FireManager(SceneGraph& _graph)
-	:m_sceneGraph(_graph)
+	:m_sceneGraph(_graph),
+	m_projectiles(_graph),
+	m_rng(103423),
+	m_beams(Graphic::ParticleSystems::RenderType::RAY),
+	m_impacts(Graphic::ParticleSystems::RenderType::BLOB),
+	m_muzzleFlashes(Graphic::ParticleSystems::RenderType::BLOB)
+{
+	FireStats noShots = {0, 0, 0};
+	m_pendingStats = noShots;
+	m_statShots = 0;
+	m_statBatches = 0;
+	m_statMaxBatchSize = 0;
+}
+
+void FireManager::Fire(const FireBatch& _batch)
 {
+	if(_batch.Size() == 0) return;
+	std::lock_guard<std::mutex> lock(m_requestMutex);
+	m_rayRequests.insert(m_rayRequests.end(), _batch.rays.begin(), _batch.rays.end());
+	m_projectileRequests.insert(m_projectileRequests.end(), _batch.projectiles.begin(), _batch.projectiles.end());
+	CountBatch(_batch.Size());
 }
 
-float FireManager::FireRay(const FireRayInfo& _info)
+FireStats FireManager::GetStats() const
 {
-//	m_fireInfos.push_back(_info);
-	Voxel::Model::ModelData::HitResult hit;
+	FireStats stats = {m_statShots.load(), m_statBatches.load(), m_statMaxBatchSize.load()};
+	return stats;
+}
 
+void FireManager::CountBatch(int _size)
+{
+	m_pendingStats.shots += _size;
+	++m_pendingStats.batches;
+	m_pendingStats.maxBatchSize = std::max(m_pendingStats.maxBatchSize, _size);
+}
 
-	auto hitObj = m_sceneGraph.RayQuery(_info.ray, hit, _info.range);
-	if (hitObj){
-		Voxel::Model* model = static_cast<Voxel::Model*>(&hitObj);
-		model->Damage(hit.position, (uint32_t)_info.damage);
+void FireManager::Process(float _deltaTime)
+{
+	// Take the requests and leave empty (recycled) vectors for new ones.
+	// Everything else runs without the lock.
+	FireStats stats;
+	{
+		std::lock_guard<std::mutex> lock(m_requestMutex);
+		std::swap(m_rays, m_rayRequests);
+		std::swap(m_newProjectiles, m_projectileRequests);
+		stats = m_pendingStats;
+		FireStats noShots = {0, 0, 0};
+		m_pendingStats = noShots;
+	}
+	m_statShots = stats.shots;
+	m_statBatches = stats.batches;
+	m_statMaxBatchSize = stats.maxBatchSize;
 
-		Math::FixVec3 pos = model->GetPosition() + Math::FixVec3(model->GetRotationMatrix() * (hit.position + 0.5f - model->GetCenter()));
+	std::sort(m_rays.begin(), m_rays.end(), RequestOrder);
+	std::sort(m_newProjectiles.begin(), m_newProjectiles.end(), RequestOrder);
 
-		return ei::len(ei::Vec3(_info.ray.origin - pos));
+	// After sorting, such that the random numbers do not depend on the threads
+	for(auto& info : m_rays)
+		SpawnMuzzleFlash(info);
+	for(auto& info : m_newProjectiles)
+		SpawnMuzzleFlash(info);
+
+	// Trace all beams of this step together
+	m_rayQueries.resize(m_rays.size());
+	m_rayResults.resize(m_rays.size());
+	for(size_t i = 0; i < m_rays.size(); ++i)
+	{
+		m_rayQueries[i].ray = m_rays[i].ray;
+		m_rayQueries[i].maxRange = m_rays[i].range;
+		m_rayQueries[i].ignoreID = m_rays[i].sourceID;
+		m_rayQueries[i].stopAtShields = true;
+	}
+	m_sceneGraph.RayQueryBatch(m_rayQueries.data(), (int)m_rayQueries.size(), m_rayResults.data(), true);
+
+	for(size_t i = 0; i < m_rays.size(); ++i)
+	{
+		const FireRayInfo& info = m_rays[i];
+		float d = ResolveRay(info, m_rayResults[i]);
+
+		Vec3 basePos(info.ray.origin - m_beams.GetPosition());
+		// the ray
+		m_beams.AddParticle(basePos, //position
+			info.sourceVelocity, // velocity
+			0.05f, //life time
+			Utils::Color8U(0.9f, 0.1f, 0.8f, 0.5f).RGBA(),
+			0.3f,
+			info.ray.direction * d);
+
+		//temporary, hit feedback should be done by the model?
+		if (d != MAX_BEAM_LENGTH)
+			SpawnImpact(Vec3(info.ray.origin - m_impacts.GetPosition()) + info.ray.direction * d);
+	}
+	// Release the object handles
+	m_rayResults.clear();
+	m_rays.clear();
+
+	for(auto& info : m_newProjectiles)
+	{
+		if(info.speed <= 0.0f) continue;
+		// The range is measured in the world and not relative to the shooter
+		Vec3 velocity = info.ray.direction * info.speed + info.sourceVelocity;
+		m_projectiles.Spawn(info.ray.origin, velocity, info.range / len(velocity), info.damage, info.sourceID);
 	}
+	m_newProjectiles.clear();
 
-	return 100.f; // max length
+	m_projectiles.Process(_deltaTime, m_projectileImpacts);
+	for(auto& impact : m_projectileImpacts)
+		SpawnImpact(Vec3(impact - m_impacts.GetPosition()));
+	m_projectileImpacts.clear();
 }
 
-void FireManager::FireProjectile(const FireRayInfo& _info)
+void FireManager::SpawnImpact(const Vec3& _position)
 {
-	Voxel::Model* proj = new Voxel::Model();
-	proj->Set(ei::IVec3(2012), Voxel::ComponentType::STONE);
-	proj->AddVelocity(_info.ray.direction * 15.f);
-	proj->SetPosition(_info.ray.origin);
+	for (int i = 0; i < 15; ++i)
+		m_impacts.AddParticle(_position, //position
+		Vec3(m_rng.Uniform(0.1f, 3.0f), m_rng.Uniform(0.1f, 3.0f), m_rng.Uniform(0.1f, 3.0f)),// velocity
+		m_rng.Uniform(0.2f, 1.f), //life time
+		Utils::Color8U(0.15f, 0.2f, 0.2f, 0.3f).RGBA(),
+		0.5f);
+}
 
-	m_sceneGraph.AddObject(proj);
+void FireManager::SpawnMuzzleFlash(const FireRayInfo& _info)
+{
+	Vec3 basePos(_info.ray.origin - m_muzzleFlashes.GetPosition());
+	for (int i = 0; i < 10; ++i)
+		m_muzzleFlashes.AddParticle(basePos, //position
+		_info.ray.direction * 0.8f + m_rng.Direction() * 0.7f, //velocity
+		0.1f + m_rng.Normal(0.1f), //life time
+		Utils::Color8U(0.2f, 0.4f, 0.9f, 0.5f).RGBA(),
+		0.2f);
 }
 
-void FireManager::Process(float _deltaTime)
+float FireManager::ResolveRay(const FireRayInfo& _info, const SceneGraph::RayQueryResult& _result)
 {
+	if (_result.object){
+		// Shields which collapse within this step still stop all hits
+		// found by its query.
+		if (_result.shield)
+			static_cast<Ship*>(const_cast<ISceneObject*>(&_result.object))->GetPrimarySystem().GetShields().Absorb((float)_info.damage);
+		else {
+			Voxel::Model* model = static_cast<Voxel::Model*>(const_cast<ISceneObject*>(&_result.object));
+			model->Damage(_result.hit.position, (uint32_t)_info.damage);
+		}
+
+		return _result.distance;
+	}
+
+	return MAX_BEAM_LENGTH;
 }
\ No newline at end of file
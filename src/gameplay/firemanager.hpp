@@ -1,16 +1,52 @@
+#pragma once
+
 #include "../math/math.hpp"
 #include "scenegraph.hpp"
+#include "projectilemanager.hpp"
+#include "generators/random.hpp"
+#include "graphic/highlevel/particlesystem.hpp"
+#include <mutex>
+#include <atomic>
 
 struct FireRayInfo
 {
-	FireRayInfo(const Math::WorldRay& _ray, int _damage, float _range) :
+	FireRayInfo(const Math::WorldRay& _ray, int _damage, float _range, uint32 _sourceID = 0,
+		const ei::Vec3& _sourceVelocity = ei::Vec3(0.0f), float _speed = 0.0f) :
 		ray(_ray),
 		damage(_damage),
-		range(_range)
+		range(_range),
+		sourceID(_sourceID),
+		sourceVelocity(_sourceVelocity),
+		speed(_speed)
 	{}
 	Math::WorldRay ray;
 	float range;
 	int damage;
+	uint32 sourceID;			///< Scene ID of the shooter which cannot be hit by its own shots or 0.
+								///< The ID stays unique after the shooter is deleted.
+	ei::Vec3 sourceVelocity;	///< Velocity of the shooter
+	float speed;				///< Projectile speed relative to the shooter
+};
+
+/// \brief All shots of one weapon group in one tick.
+/// \details A weapon system collects its shots here and submits them with a
+///		single FireManager::Fire() call instead of one locked call per shot.
+///		Keep the batch alive to recycle its memory.
+struct FireBatch
+{
+	std::vector<FireRayInfo> rays;
+	std::vector<FireRayInfo> projectiles;
+
+	int Size() const	{ return int(rays.size() + projectiles.size()); }
+	void Clear()		{ rays.clear(); projectiles.clear(); }
+};
+
+/// \brief Counts of the shots resolved by the last FireManager::Process().
+struct FireStats
+{
+	int shots;			///< Rays and projectiles fired in the step
+	int batches;		///< Number of Fire() calls with at least one shot
+	int maxBatchSize;	///< Shots of the largest submission
 };
 
 class FireManager
@@ -18,18 +54,75 @@ class FireManager
 public:
 	FireManager(SceneGraph& _graph);
 
-	/// \brief Processes a ray shot in the scene
-	/// \return distance of the hit
-	float FireRay(const FireRayInfo& _info);
-
-	/// \brief Spawns a projectile in the world
-	void FireProjectile(const FireRayInfo& _info);
+	/// \brief Requests all shots of a weapon group at once.
+	/// \details This is thread safe and takes the lock only once, so it can
+	///		be called from the parallel simulation. The rays are traced and
+	///		the projectiles are spawned in the next Process() call.
+	void Fire(const FireBatch& _batch);
 
+	/// \brief Resolves all shots requested since the last call and moves
+	///		the projectiles.
+	/// \details The requests are sorted first such that the results do not
+	///		depend on the order in which threads committed them. All beams
+	///		are traced in one batch against the state before any damage of
+	///		this step.
+	///
+	///		Projectiles are simulated by a ProjectileManager.
+	///
+	///		The request lock is only held to take the requests, shots fired
+	///		meanwhile are resolved in the next call.
 	void Process(float _deltaTime);
+
+	int NumProjectiles() const { return m_projectiles.NumProjectiles(); }
+	/// \brief Copy of the stats of the last Process().
+	/// \details Thread safe and lock free, e.g. for the render thread. The
+	///		three counts are read separately.
+	FireStats GetStats() const;
 private:
 	SceneGraph& m_sceneGraph;
+	ProjectileManager m_projectiles;
+	std::vector<Math::FixVec3> m_projectileImpacts;
+
+	std::mutex m_requestMutex;
+	std::vector<FireRayInfo> m_rayRequests;			///< Guarded by m_requestMutex
+	std::vector<FireRayInfo> m_projectileRequests;	///< Guarded by m_requestMutex
+	std::vector<FireRayInfo> m_rays;				///< Requests taken by the running Process()
+	std::vector<FireRayInfo> m_newProjectiles;		///< Requests taken by the running Process()
+	std::vector<SceneGraph::RayQueryInfo> m_rayQueries;		///< Recycled memory for the batched beam query
+	std::vector<SceneGraph::RayQueryResult> m_rayResults;
+	FireStats m_pendingStats;		///< Counts of the requests since the last Process(), guarded by m_requestMutex
+	std::atomic<int> m_statShots;	///< Published FireStats of the last Process()
+	std::atomic<int> m_statBatches;
+	std::atomic<int> m_statMaxBatchSize;
+
+	Generators::Random m_rng;
+
+	Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION
+		| Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME
+		| Graphic::PSComponent::COLOR | Graphic::PSComponent::SIZE
+		| Graphic::PSComponent::DIRECTION> m_beams;
+
+	Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION
+		| Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME
+		| Graphic::PSComponent::COLOR | Graphic::PSComponent::SIZE> m_impacts;
+
+	/// \brief Muzzle flashes of all ships share one system and vertex buffer.
+	Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION
+		| Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME
+		| Graphic::PSComponent::COLOR | Graphic::PSComponent::SIZE> m_muzzleFlashes;
+
+	/// \brief Damage the first voxel hit by a traced ray.
+	/// \return distance of the hit or the maximum beam length.
+	float ResolveRay(const FireRayInfo& _info, const SceneGraph::RayQueryResult& _result);
+
+	/// \brief Spawn some debris particles at the position where something was hit.
+	void SpawnImpact(const ei::Vec3& _position);
+
+	/// \brief Spawn the flash at the origin of a shot.
+	void SpawnMuzzleFlash(const FireRayInfo& _info);
 
-	std::vector<FireRayInfo> m_fireInfos;
+	/// \brief Count a submission. The request lock must be held.
+	void CountBatch(int _size);
 };
 
 extern FireManager* g_fireManager;
\ No newline at end of file
@@ -3,7 +3,9 @@
 using namespace ei;
 
 Controller::Controller(SOHandle _ship)
-	:m_autoPilot(false)
+	:m_autoPilot(false),
+	m_ticks(0),
+	m_lastSensorScan(0)
 {
 	if (_ship) Possess(_ship);
 }
@@ -54,12 +56,44 @@ void Controller::FlyToPosition(const Math::FixVec3& _pos, float _maxVelocity, bo
 
 // *************************************************** //
 
+const std::vector<Mechanics::SensorContact>& Controller::GetContacts() const
+{
+	return m_ship->GetPrimarySystem().GetSensors().GetContacts();
+}
+
+const Mechanics::SensorContact* Controller::GetNearestContact() const
+{
+	return m_ship->GetPrimarySystem().GetSensors().GetNearestContact();
+}
+
+// *************************************************** //
+
+void Controller::DispatchSensorEvents()
+{
+	const Mechanics::SensorSystem& sensors = m_ship->GetPrimarySystem().GetSensors();
+	if (sensors.GetNumScans() == m_lastSensorScan) return;
+	m_lastSensorScan = sensors.GetNumScans();
+
+	for (auto& event : sensors.GetEvents())
+	{
+		if (event.type == Mechanics::SensorEvent::Type::ENTER)
+			EvtContactEnter(event.object);
+		else EvtContactLeave(event.object);
+	}
+}
+
+// *************************************************** //
+
 void Controller::Process(float _deltaTime)
 {
+	DispatchSensorEvents();
+
 	if (!m_autoPilot) return;
 
-	//update required rotation, this should probably not happen every frame
-	UpdateTargetDirection();
+	//update required rotation only every few frames
+	//the ship id spreads the updates of many controllers deterministically
+	if ((++m_ticks + m_ship->GetID()) % Mechanics::TickIntervals::controller == 0)
+		UpdateTargetDirection();
 
 	//adjust rotation
 	Vec3 dirSlf = Vec3(0.f, 0.f, 1.f);
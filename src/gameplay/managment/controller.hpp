@@ -1,3 +1,5 @@
+#pragma once
+
 #include "..\ship.hpp"
 
 class Controller
@@ -21,11 +23,21 @@ public:
 
 	Ship* GetShip() { return m_ship; };
 
+	///\brief Objects currently seen by the sensors of the controlled ship.
+	const std::vector<Mechanics::SensorContact>& GetContacts() const;
+	///\brief The closest sensor contact or nullptr.
+	const Mechanics::SensorContact* GetNearestContact() const;
+
 	const std::string& GetName() const { return m_name; };
 protected:
 	Ship* m_ship;
 	
 	virtual void EvtCollision(Voxel::Model& _other) {}; //not pure virtual because implementation should not be necessary
+	virtual void EvtContactEnter(const SOHandle& _object) {}; ///< An object came into sensor range
+	virtual void EvtContactLeave(const SOHandle& _object) {}; ///< An object left the sensor range
+
+	///\brief Forward the sensor events of the last scan once.
+	void DispatchSensorEvents();
 private:
 	SOHandle m_shipHandle;
 
@@ -39,4 +51,6 @@ private:
 	float m_autoMaxSpeed;
 	bool m_autoPilot;
 	bool m_stopAtGoal;
+	uint32 m_ticks;			///< Counts Process() calls to update the target direction less often
+	uint32 m_lastSensorScan;	///< Scan whose events were dispatched
 };
\ No newline at end of file
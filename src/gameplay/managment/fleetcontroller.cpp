@@ -0,0 +1,185 @@
+#include "fleetcontroller.hpp"
+#include "gameplay/scenegraph.hpp"
+#include "gameplay/replay.hpp"
+#include <algorithm>
+
+using namespace ei;
+using namespace Math;
+
+// The formation center runs ahead of the fleet by this distance
+const float FORMATION_LOOKAHEAD = 100.0f;
+// Additional distance which is kept to obstacles
+const float AVOIDANCE_MARGIN = 10.0f;
+// Members closer to their final slot are not steered anymore
+const float ARRIVAL_DISTANCE = 3.0f;
+
+FleetController::FleetController(SceneGraph& _scene, float _spacing)
+	:m_scene(_scene),
+	m_spacing(_spacing),
+	m_goal(Fix(0.0)),
+	m_maxSpeed(0.f),
+	m_active(false),
+	m_anchor(Fix(0.0)),
+	m_anchorAtGoal(false),
+	m_groupDirty(true),
+	// A seeded phase spreads the group updates of many fleets over the
+	// ticks and is the same in a replay
+	m_ticks(Replay::NextSeed() % Mechanics::TickIntervals::fleet),
+	m_nextMember(0)
+{
+	m_frame[0] = Vec3(1.f, 0.f, 0.f);
+	m_frame[1] = Vec3(0.f, 1.f, 0.f);
+	m_frame[2] = Vec3(0.f, 0.f, 1.f);
+}
+
+// *************************************************** //
+
+void FleetController::AddShip(SOHandle _ship)
+{
+	Member member;
+	member.controller.reset(new Controller(_ship));
+	member.slot = Vec3(0.f);
+	m_members.push_back(std::move(member));
+	UpdateSlots();
+	// The anchor and the obstacles must include the new member before it
+	// is steered
+	m_groupDirty = true;
+}
+
+// *************************************************** //
+
+void FleetController::FlyToPosition(const Math::FixVec3& _pos, float _maxVelocity)
+{
+	m_goal = _pos;
+	m_maxSpeed = _maxVelocity;
+	m_active = true;
+	// Start the next Process() with a group update
+	m_groupDirty = true;
+}
+
+// *************************************************** //
+
+void FleetController::Process(float _deltaTime)
+{
+	bool groupTick = m_ticks++ % Mechanics::TickIntervals::fleet == 0;
+	if (groupTick || m_groupDirty)
+		UpdateGroup();
+	if (m_members.empty()) return;
+
+	// Visit each member once per group update
+	if (m_active)
+	{
+		size_t interval = Mechanics::TickIntervals::fleet;
+		size_t num = (m_members.size() + interval - 1) / interval;
+		for (size_t i = 0; i < num; ++i)
+		{
+			if (m_nextMember >= m_members.size()) m_nextMember = 0;
+			UpdateMember(m_members[m_nextMember++]);
+		}
+	}
+
+	for (auto& member : m_members)
+		member.controller->Process(_deltaTime);
+}
+
+// *************************************************** //
+
+void FleetController::UpdateGroup()
+{
+	m_groupDirty = false;
+	size_t numMembers = m_members.size();
+	m_members.erase(std::remove_if(m_members.begin(), m_members.end(), [](const Member& _member){
+		return _member.controller->GetShip()->IsDeleted();
+	}), m_members.end());
+	if (m_members.empty()) return;
+	if (m_members.size() != numMembers) UpdateSlots();
+
+	// Average position relative to the first member
+	const FixVec3& origin = m_members[0].controller->GetShip()->GetPosition();
+	Vec3 offset(0.f);
+	float extent = 0.f;
+	m_memberIDs.clear();
+	for (auto& member : m_members)
+	{
+		Ship* ship = member.controller->GetShip();
+		offset += Vec3(ship->GetPosition() - origin);
+		extent = max(extent, len(member.slot) + ship->GetRadius());
+		m_memberIDs.push_back(ship->GetID());
+	}
+	std::sort(m_memberIDs.begin(), m_memberIDs.end());
+	FixVec3 center = origin + FixVec3(offset / (float)m_members.size());
+
+	if (!m_active) return;
+
+	// The frame is kept if the fleet is already at its goal
+	Vec3 toGoal(m_goal - center);
+	float distance = len(toGoal);
+	if (distance > ARRIVAL_DISTANCE)
+	{
+		m_frame[2] = toGoal / distance;
+		Vec3 up = abs(m_frame[2].y) < 0.99f ? Vec3(0.f, 1.f, 0.f) : Vec3(1.f, 0.f, 0.f);
+		m_frame[0] = normalize(cross(up, m_frame[2]));
+		m_frame[1] = cross(m_frame[2], m_frame[0]);
+	}
+	m_anchorAtGoal = distance <= FORMATION_LOOKAHEAD;
+	m_anchor = m_anchorAtGoal ? m_goal : center + FixVec3(m_frame[2] * FORMATION_LOOKAHEAD);
+
+	// One query for the whole fleet. Only objects which are not members
+	// are obstacles.
+	m_scene.SphereQuery(center, extent + FORMATION_LOOKAHEAD + AVOIDANCE_MARGIN, m_queryResult);
+	m_obstacles.clear();
+	for (auto& object : m_queryResult)
+	{
+		if (object->IsDeleted() || std::binary_search(m_memberIDs.begin(), m_memberIDs.end(), object->GetID()))
+			continue;
+		Vec3 size(object->GetBoundingBoxMax() - object->GetBoundingBoxMin());
+		Obstacle obstacle;
+		obstacle.position = object->GetBoundingBoxMin() + FixVec3(size * 0.5f);
+		obstacle.radius = len(size) * 0.5f;
+		m_obstacles.push_back(obstacle);
+	}
+	// Release the handles
+	m_queryResult.clear();
+}
+
+// *************************************************** //
+
+void FleetController::UpdateSlots()
+{
+	// Square grid with the first member in the center of the first row
+	int side = (int)ceil(sqrt((float)m_members.size()));
+	for (size_t i = 0; i < m_members.size(); ++i)
+	{
+		int column = int(i) % side;
+		int row = int(i) / side;
+		m_members[i].slot = Vec3((column - (side - 1) * 0.5f) * m_spacing,
+			(row - (side - 1) * 0.5f) * m_spacing, 0.f);
+	}
+}
+
+// *************************************************** //
+
+void FleetController::UpdateMember(Member& _member)
+{
+	Ship* ship = _member.controller->GetShip();
+	const FixVec3& position = ship->GetPosition();
+	Vec3 slot = m_frame[0] * _member.slot.x + m_frame[1] * _member.slot.y + m_frame[2] * _member.slot.z;
+	Vec3 toTarget(m_anchor + FixVec3(slot) - position);
+	if (m_anchorAtGoal && lensq(toTarget) < ARRIVAL_DISTANCE * ARRIVAL_DISTANCE)
+		return;
+
+	// Push the path out of all obstacles it passes too close
+	float lengthSq = max(lensq(toTarget), 1e-6f);
+	for (auto& obstacle : m_obstacles)
+	{
+		Vec3 toObstacle(obstacle.position - position);
+		float t = max(0.f, min(1.f, dot(toObstacle, toTarget) / lengthSq));
+		Vec3 offset = toTarget * t - toObstacle;
+		float clearance = obstacle.radius + ship->GetRadius() + AVOIDANCE_MARGIN;
+		float distance = len(offset);
+		if (distance < clearance)
+			toTarget += (distance > 1e-3f ? offset / distance : m_frame[0]) * (clearance - distance);
+	}
+
+	_member.controller->FlyToPosition(position + FixVec3(toTarget), m_maxSpeed, m_anchorAtGoal);
+}
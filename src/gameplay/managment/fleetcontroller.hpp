@@ -0,0 +1,84 @@
+#pragma once
+
+#include "controller.hpp"
+#include <memory>
+#include <vector>
+
+class SceneGraph;
+
+///\brief Steers a group of AI ships in formation.
+///\details The work which is the same for all members is done once per group
+///		in the ticks given by TickIntervals::fleet: the fleet center, the
+///		formation frame and a single broadphase query for obstacles around the
+///		whole group. Each member is steered by its own Controller which only
+///		reads these shared results.
+///
+///		The slot targets of the members are re-evaluated round robin, such that
+///		all members are visited once per interval. The costs per tick grow with
+///		the number of members divided by the interval.
+class FleetController
+{
+public:
+	FleetController(SceneGraph& _scene, float _spacing = 20.0f);
+
+	///\brief Add a ship to the formation. The slots are reassigned.
+	void AddShip(SOHandle _ship);
+	int NumShips() const { return (int)m_members.size(); }
+
+	///\brief The formation flies to the given position and stops there.
+	void FlyToPosition(const Math::FixVec3& _pos, float _maxVelocity = 0.f);
+
+	void Process(float _deltaTime);
+private:
+	struct Member
+	{
+		std::unique_ptr<Controller> controller;
+		ei::Vec3 slot;		///< Offset in the formation frame, z is the flight direction
+
+		Member() {}
+		// Move operations are not generated implicitly by VS2013
+		Member(Member&& _other) :
+			controller(std::move(_other.controller)),
+			slot(_other.slot)
+		{}
+		Member& operator = (Member&& _other)
+		{
+			controller = std::move(_other.controller);
+			slot = _other.slot;
+			return *this;
+		}
+	};
+
+	///\brief Bounding sphere of an object which is not part of the fleet.
+	struct Obstacle
+	{
+		Math::FixVec3 position;
+		float radius;
+	};
+
+	SceneGraph& m_scene;
+	std::vector<Member> m_members;
+	std::vector<Obstacle> m_obstacles;		///< Result of the last group query
+	std::vector<SOHandle> m_queryResult;	///< Recycled memory of the group query
+	std::vector<uint32> m_memberIDs;		///< Sorted scene ids of the members
+
+	float m_spacing;			///< Distance between two neighboured slots
+	Math::FixVec3 m_goal;
+	float m_maxSpeed;
+	bool m_active;
+
+	ei::Vec3 m_frame[3];		///< Axes of the formation, z is the flight direction
+	Math::FixVec3 m_anchor;		///< Target of the formation center
+	bool m_anchorAtGoal;		///< The members must stop at their slots
+	bool m_groupDirty;			///< The next Process() must start with UpdateGroup()
+
+	uint32 m_ticks;				///< Counts Process() calls, starts with a per fleet phase
+	size_t m_nextMember;		///< Next member to re-evaluate
+
+	///\brief Remove destroyed ships and recompute the shared results.
+	void UpdateGroup();
+	///\brief Arrange all members in a grid orthogonal to the flight direction.
+	void UpdateSlots();
+	///\brief Give a member a new target from its slot and the obstacles.
+	void UpdateMember(Member& _member);
+};
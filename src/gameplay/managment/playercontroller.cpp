@@ -4,7 +4,7 @@
 #include "input/input.hpp"
 #include "graphic/core/device.hpp"
 #include "graphic/core/opengl.hpp"
-#include "utilities/scriptengineinst.hpp"
+#include "utilities/scriptruntime.hpp"
 
 using namespace ei;
 
@@ -12,7 +12,10 @@ PlayerController::PlayerController(Graphic::HudGsPlay& _hud, SOHandle _ship, Inp
 	: Controller(_ship),
 	m_mouseRotationEnabled(false),
 	m_camera(_camera),
-	m_hud(_hud)
+	m_keyDown(nullptr),
+	m_keyRelease(nullptr),
+	m_hud(_hud),
+	m_inputLog(nullptr)
 {
 }
 
@@ -22,6 +25,10 @@ void PlayerController::Possess(SOHandle _ship)
 
 	NaReTi::Module* mod = g_scriptEngine.getModule("shipfunctions");
 	mod->linkExternal("setFiring", &Mechanics::WeaponSystem::_SetFiring);
+	mod->linkExternal("numContacts", &Mechanics::SensorSystem::_NumContacts);
+	mod->linkExternal("contactDistance", &Mechanics::SensorSystem::_ContactDistance);
+	mod->linkExternal("numContactsEntered", &Mechanics::SensorSystem::_NumEntered);
+	mod->linkExternal("numContactsLeft", &Mechanics::SensorSystem::_NumLeft);
 
 	std::ofstream file("scripts/availablesystems.nrt", std::ofstream::out & std::ofstream::trunc);
 	file << "use shipfunctions" << std::endl << std::endl;
@@ -29,8 +36,10 @@ void PlayerController::Possess(SOHandle _ship)
 
 	//make sure that the module is loaded
 	NaReTi::Module* inputMod = g_scriptEngine.getModule("input");
-	m_keyDownHndl = g_scriptEngine.getFuncHndl("keyDown");
-	m_keyReleaseHndl = g_scriptEngine.getFuncHndl("keyRelease");
+	m_keyDown = &Script::Runtime::GetFunction("keyDown");
+	m_keyDown->Resolve();
+	m_keyRelease = &Script::Runtime::GetFunction("keyRelease");
+	m_keyRelease->Resolve();
 
 	//restart systems
 	m_ship->GetPrimarySystem().Flash();
@@ -51,12 +60,24 @@ void PlayerController::Scroll(double _dx, double _dy)
 
 void PlayerController::KeyDown(int _key, int _modifiers)
 {
-	g_scriptEngine.call<void, int, int>(m_keyDownHndl, _key, _modifiers);
+	Replay::KeyEvent event = {Replay::KeyEvent::Type::DOWN, _key, _modifiers};
+	if(m_inputLog)
+	{
+		std::lock_guard<std::mutex> lock(m_eventMutex);
+		m_pendingEvents.push_back(event);
+	} else
+		DispatchKeyEvents(std::vector<Replay::KeyEvent>(1, event));
 }
 
 void PlayerController::KeyRelease(int _key)
 {
-	g_scriptEngine.call<void, int>(m_keyReleaseHndl, _key);
+	Replay::KeyEvent event = {Replay::KeyEvent::Type::RELEASE, _key, 0};
+	if(m_inputLog)
+	{
+		std::lock_guard<std::mutex> lock(m_eventMutex);
+		m_pendingEvents.push_back(event);
+	} else
+		DispatchKeyEvents(std::vector<Replay::KeyEvent>(1, event));
 
 	if (_key == GLFW_KEY_V)
 	{
@@ -67,6 +88,41 @@ void PlayerController::KeyRelease(int _key)
 
 void PlayerController::Process(float _deltaTime)
 {
+	Replay::ShipCommand command;
+	m_stepEvents.clear();
+	if(m_inputLog && m_inputLog->GetMode() == Replay::InputLog::Mode::REPLAY)
+	{
+		// Live input is ignored, everything comes from the recording
+		{
+			std::lock_guard<std::mutex> lock(m_eventMutex);
+			m_pendingEvents.clear();
+		}
+		if(!m_inputLog->Play(command, m_stepEvents))
+			return;
+	} else {
+		command = PollInput(_deltaTime);
+		if(m_inputLog)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_eventMutex);
+				m_stepEvents.swap(m_pendingEvents);
+			}
+			m_inputLog->Record(command, m_stepEvents);
+		}
+	}
+	DispatchKeyEvents(m_stepEvents);
+
+	m_ship->SetTargetVelocity(command.targetVelocity);
+	m_ship->SetTargetAngularVelocity(command.targetAngularVelocity);
+	m_ship->SetPointingDirection(command.pointingDirection);
+
+	// is this the right place?
+	m_hud.UpdateScriptVars();
+}
+
+Replay::ShipCommand PlayerController::PollInput(float _deltaTime)
+{
+	Replay::ShipCommand command;
 	// Movement
 	// Velocity in Z is increased/decreased while a key is pressed.
 	// In other directions stop pushing resets the velocity
@@ -85,7 +141,7 @@ void PlayerController::Process(float _deltaTime)
 		m_velocity[0] = -_deltaTime * 100.0f;
 	if(glfwGetKey(Graphic::Device::GetWindow(), GLFW_KEY_TAB))
 		m_velocity = Vec3(0.0f);
-	m_ship->SetTargetVelocity(m_velocity);
+	command.targetVelocity = m_velocity;
 
 	// Let the camera slide back to the main ship direction
 	if(m_mouseRotationEnabled)
@@ -110,13 +166,24 @@ void PlayerController::Process(float _deltaTime)
 		//angularVel += m_ship->GetInverseRotationMatrix().YAxis() * -cursor[0];
 		//angularVel += m_ship->GetInverseRotationMatrix().XAxis() * cursor[1];
 	}
-	m_ship->SetTargetAngularVelocity(angularVel);
+	command.targetAngularVelocity = angularVel;
 
 	Math::WorldRay ray = m_camera->GetRay(Input::Manager::GetCursorPosScreenSpace());
-	m_ship->SetPointingDirection(ray.direction);
+	command.pointingDirection = ray.direction;
+	return command;
+}
 
-	// is this the right place?
-	m_hud.UpdateScriptVars();
+void PlayerController::DispatchKeyEvents(const std::vector<Replay::KeyEvent>& _events)
+{
+	// Scripts are resolved when a ship is possessed
+	if(!m_keyDown) return;
+	for(auto& event : _events)
+	{
+		if(event.type == Replay::KeyEvent::Type::DOWN)
+			m_keyDown->Call(event.key, event.modifiers);
+		else
+			m_keyRelease->Call(event.key);
+	}
 }
 
 
@@ -2,6 +2,8 @@
 #include "input\camera.hpp"
 #include "enginetypes.hpp"
 #include "gamestates/gsplayhud.hpp"
+#include "gameplay/replay.hpp"
+#include <mutex>
 
 class PlayerController : public Controller
 {
@@ -18,10 +20,20 @@ public:
 	void SetMouseRotation(bool _enable) { m_mouseRotationEnabled = _enable; }
 	void SetTarget(Voxel::Model* _newTarget) { m_target = _newTarget; };
 
+	/// \brief Enable the lockstep mode: key events are deferred to the next
+	///		step and all input is recorded to or replayed from the log.
+	/// \param [in] _log The log or nullptr to handle input immediately.
+	void SetInputLog(Replay::InputLog* _log) { m_inputLog = _log; }
+
 	virtual void Process(float _deltaTime) override;
 private:
 	virtual void EvtCollision(Voxel::Model& _other) override;
 
+	/// \brief Compute the ship targets from the current keyboard and mouse state.
+	Replay::ShipCommand PollInput(float _deltaTime);
+	/// \brief Forward key events to the input scripts.
+	void DispatchKeyEvents(const std::vector<Replay::KeyEvent>& _events);
+
 	bool m_mouseRotationEnabled;
 	ei::Vec3 m_velocity; ///< Ship relative velocity
 
@@ -29,7 +41,12 @@ private:
 
 	Input::Camera* m_camera;
 
-	NaReTi::FunctionHandle m_keyDownHndl;
-	NaReTi::FunctionHandle m_keyReleaseHndl;
+	Script::Function* m_keyDown;
+	Script::Function* m_keyRelease;
 	Graphic::HudGsPlay& m_hud;
+
+	Replay::InputLog* m_inputLog;
+	std::mutex m_eventMutex;
+	std::vector<Replay::KeyEvent> m_pendingEvents;	///< Key events since the last step (input thread)
+	std::vector<Replay::KeyEvent> m_stepEvents;		///< Key events of the current step
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "projectilemanager.hpp"
+#include "ship.hpp"
+#include "utilities/color.hpp"
+
+using namespace ei;
+using namespace Math;
+
+// Projectiles damage a small sphere around the hit point in one batched edit
+const float IMPACT_RADIUS = 1.5f;	// voxels
+const float IMPACT_FALLOFF = 1.0f;
+
+ProjectileManager::ProjectileManager(SceneGraph& _graph) :
+	m_sceneGraph(_graph),
+	m_streaks(Graphic::ParticleSystems::RenderType::RAY)
+{
+}
+
+// ************************************************************************* //
+void ProjectileManager::Spawn(const FixVec3& _position, const Vec3& _velocity, float _lifetime, int _damage, uint32 _ownerID)
+{
+	if( lensq(_velocity) <= 0.0f || _lifetime <= 0.0f ) return;
+
+	m_positions.push_back(_position);
+	m_velocities.push_back(_velocity);
+	m_lifetimes.push_back(_lifetime);
+	m_damages.push_back(_damage);
+	m_ownerIDs.push_back(_ownerID);
+}
+
+// ************************************************************************* //
+void ProjectileManager::Process(float _deltaTime, std::vector<FixVec3>& _impacts)
+{
+	int num = NumProjectiles();
+	if( num == 0 ) return;
+
+	// Build one ray per projectile over the remaining part of the step
+	m_queries.resize(num);
+	m_results.resize(num);
+	for( int i = 0; i < num; ++i )
+	{
+		float speed = len(m_velocities[i]);
+		m_queries[i].ray.origin = m_positions[i];
+		m_queries[i].ray.direction = m_velocities[i] / speed;
+		m_queries[i].maxRange = speed * min(_deltaTime, m_lifetimes[i]);
+		m_queries[i].ignoreID = m_ownerIDs[i];
+		m_queries[i].stopAtShields = true;
+	}
+	m_sceneGraph.RayQueryBatch(m_queries.data(), num, m_results.data(), true);
+
+	// Damage in a fixed order such that the result is reproducible
+	m_alive.resize(num);
+	for( int i = 0; i < num; ++i )
+	{
+		const SceneGraph::RayQueryResult& result = m_results[i];
+		const WorldRay& ray = m_queries[i].ray;
+		m_streaks.AddParticle(Vec3(ray.origin - m_streaks.GetPosition()),
+			Vec3(0.0f), _deltaTime, Utils::Color8U(0.9f, 0.6f, 0.1f, 0.8f).RGBA(), 0.2f,
+			ray.direction * result.distance);
+
+		if( result.object )
+		{
+			if( result.shield )
+				static_cast<Ship*>(const_cast<ISceneObject*>(&result.object))->GetPrimarySystem().GetShields().Absorb((float)m_damages[i]);
+			else {
+				Voxel::Model* model = static_cast<Voxel::Model*>(const_cast<ISceneObject*>(&result.object));
+				model->DamageRegion(ray.origin + FixVec3(ray.direction * result.distance),
+					IMPACT_RADIUS, (float)m_damages[i], IMPACT_FALLOFF);
+			}
+			_impacts.push_back(ray.origin + FixVec3(ray.direction * result.distance));
+			m_alive[i] = 0;
+		} else {
+			m_positions[i] += FixVec3(ray.direction * result.distance);
+			m_alive[i] = 1;
+		}
+	}
+	// Release the object handles
+	m_results.clear();
+
+	// The plain float arrays are updated in a separate loop which can be
+	// vectorized.
+	float* lifetimes = m_lifetimes.data();
+	for( int i = 0; i < num; ++i )
+		lifetimes[i] -= _deltaTime;
+	for( int i = 0; i < num; ++i )
+		m_alive[i] &= lifetimes[i] > 0.0f ? 1 : 0;
+
+	Compact();
+}
+
+// ************************************************************************* //
+void ProjectileManager::Compact()
+{
+	int num = NumProjectiles();
+	int numAlive = 0;
+	for( int i = 0; i < num; ++i )
+	{
+		if( !m_alive[i] ) continue;
+		if( i != numAlive )
+		{
+			m_positions[numAlive] = m_positions[i];
+			m_velocities[numAlive] = m_velocities[i];
+			m_lifetimes[numAlive] = m_lifetimes[i];
+			m_damages[numAlive] = m_damages[i];
+			m_ownerIDs[numAlive] = m_ownerIDs[i];
+		}
+		++numAlive;
+	}
+	m_positions.resize(numAlive);
+	m_velocities.resize(numAlive);
+	m_lifetimes.resize(numAlive);
+	m_damages.resize(numAlive);
+	m_ownerIDs.resize(numAlive);
+}
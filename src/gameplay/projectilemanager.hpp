@@ -0,0 +1,52 @@
+#pragma once
+
+#include "scenegraph.hpp"
+#include "graphic/highlevel/particlesystem.hpp"
+#include <vector>
+
+/// \brief Simulation of all projectiles (shots with a finite speed).
+/// \details Projectiles are no scene objects. They are stored as a structure
+///		of arrays, integrated together and swept against the scene with one
+///		batched ray query per step, so they cannot tunnel through thin hulls
+///		at any speed.
+class ProjectileManager
+{
+public:
+	ProjectileManager(SceneGraph& _graph);
+
+	/// \brief Add a new projectile. Not thread safe.
+	/// \param [in] _lifetime Time in seconds until the projectile vanishes.
+	/// \param [in] _ownerID Scene ID of the shooter which cannot be hit by
+	///		its own shots. Other than a pointer it cannot match a new object
+	///		after the shooter was deleted.
+	void Spawn(const Math::FixVec3& _position, const ei::Vec3& _velocity, float _lifetime, int _damage, uint32 _ownerID);
+
+	/// \brief Sweep all projectiles over one step and damage the voxels they hit.
+	/// \details The damage is applied in the order of spawning. Each hit
+	///		damages a small sphere by Voxel::Model::DamageRegion().
+	/// \param [out] _impacts The world positions of all hits are appended.
+	void Process(float _deltaTime, std::vector<Math::FixVec3>& _impacts);
+
+	int NumProjectiles() const { return (int)m_positions.size(); }
+private:
+	SceneGraph& m_sceneGraph;
+
+	std::vector<Math::FixVec3> m_positions;
+	std::vector<ei::Vec3> m_velocities;
+	std::vector<float> m_lifetimes;			///< Remaining time in seconds
+	std::vector<int> m_damages;
+	std::vector<uint32> m_ownerIDs;
+
+	std::vector<SceneGraph::RayQueryInfo> m_queries;	///< Recycled memory for the sweep
+	std::vector<SceneGraph::RayQueryResult> m_results;
+	std::vector<char> m_alive;
+
+	Graphic::ParticleSystems::System<Graphic::PSComponent::POSITION
+		| Graphic::PSComponent::VELOCITY | Graphic::PSComponent::LIFETIME
+		| Graphic::PSComponent::COLOR | Graphic::PSComponent::SIZE
+		| Graphic::PSComponent::DIRECTION> m_streaks;
+
+	/// \brief Remove all projectiles which are not alive anymore and keep
+	///		the order of the others.
+	void Compact();
+};
@@ -0,0 +1,165 @@
+#include "replay.hpp"
+#include "utilities/logger.hpp"
+#include <ei/elementarytypes.hpp>
+
+using namespace ei;
+
+namespace Replay {
+
+	static const uint32 INPUT_LOG_MAGIC = 0x474c4e49;	// "INLG"
+	static const uint32 INPUT_LOG_VERSION = 1;
+
+	static uint32 g_sessionSeed = 0;
+	static uint32 g_seedCounter = 0;
+
+	// ************************************************************************* //
+	void SetSessionSeed(uint32 _seed)
+	{
+		g_sessionSeed = _seed;
+		g_seedCounter = 0;
+	}
+
+	// ************************************************************************* //
+	uint32 NextSeed()
+	{
+		// Mix the counter into the seed (MurmurHash3 finalizer)
+		uint32 h = g_sessionSeed ^ (++g_seedCounter * 0x9e3779b9);
+		h ^= h >> 16;
+		h *= 0x85ebca6b;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// ************************************************************************* //
+	InputLog::InputLog() :
+		m_mode(Mode::OFF),
+		m_seed(0),
+		m_step(0),
+		m_desyncReported(false),
+		m_stepTimer(0),
+		m_totalStepTime(0.0),
+		m_maxStepTime(0.0)
+	{
+	}
+
+	// ************************************************************************* //
+	void InputLog::StartRecording(uint32 _seed)
+	{
+		m_mode = Mode::RECORD;
+		m_seed = _seed;
+		m_step = 0;
+		m_frames.clear();
+		m_events.clear();
+		SetSessionSeed(_seed);
+		LOG_LVL2("Recording input with seed " + std::to_string(_seed));
+	}
+
+	// ************************************************************************* //
+	void InputLog::StartReplay(const Jo::Files::IFile& _file)
+	{
+		uint32 magic, version;
+		_file.Read(sizeof(uint32), &magic);
+		_file.Read(sizeof(uint32), &version);
+		if( magic != INPUT_LOG_MAGIC || version != INPUT_LOG_VERSION )
+			throw std::string("The file " + _file.Name() + " is no valid input log.");
+
+		uint64_t numFrames, numEvents;
+		_file.Read(sizeof(uint32), &m_seed);
+		_file.Read(sizeof(uint64_t), &numFrames);
+		_file.Read(sizeof(uint64_t), &numEvents);
+		m_frames.resize((size_t)numFrames);
+		m_events.resize((size_t)numEvents);
+		if( numFrames ) _file.Read(numFrames * sizeof(Frame), m_frames.data());
+		if( numEvents ) _file.Read(numEvents * sizeof(KeyEvent), m_events.data());
+
+		m_mode = Mode::REPLAY;
+		m_step = 0;
+		m_desyncReported = false;
+		m_totalStepTime = 0.0;
+		m_maxStepTime = 0.0;
+		SetSessionSeed(m_seed);
+		LOG_LVL2("Replaying " + std::to_string(numFrames) + " steps from " + _file.Name());
+	}
+
+	// ************************************************************************* //
+	void InputLog::Stop()
+	{
+		m_mode = Mode::OFF;
+	}
+
+	// ************************************************************************* //
+	void InputLog::Save(Jo::Files::IFile& _file) const
+	{
+		_file.WriteU32(INPUT_LOG_MAGIC);
+		_file.WriteU32(INPUT_LOG_VERSION);
+		_file.WriteU32(m_seed);
+		_file.WriteU64(m_frames.size());
+		_file.WriteU64(m_events.size());
+		if( !m_frames.empty() ) _file.Write(m_frames.data(), m_frames.size() * sizeof(Frame));
+		if( !m_events.empty() ) _file.Write(m_events.data(), m_events.size() * sizeof(KeyEvent));
+	}
+
+	// ************************************************************************* //
+	void InputLog::Record(const ShipCommand& _command, const std::vector<KeyEvent>& _events)
+	{
+		if( m_mode != Mode::RECORD ) return;
+		Frame frame;
+		frame.command = _command;
+		frame.stateHash = 0;
+		frame.firstEvent = (uint32)m_events.size();
+		frame.numEvents = (uint32)_events.size();
+		m_events.insert(m_events.end(), _events.begin(), _events.end());
+		m_frames.push_back(frame);
+	}
+
+	// ************************************************************************* //
+	bool InputLog::Play(ShipCommand& _command, std::vector<KeyEvent>& _events) const
+	{
+		if( m_mode != Mode::REPLAY || m_step >= m_frames.size() ) return false;
+		const Frame& frame = m_frames[(size_t)m_step];
+		_command = frame.command;
+		_events.insert(_events.end(), m_events.begin() + frame.firstEvent, m_events.begin() + frame.firstEvent + frame.numEvents);
+		return true;
+	}
+
+	// ************************************************************************* //
+	void InputLog::BeginStep()
+	{
+		TimeQuery(m_stepTimer);
+	}
+
+	// ************************************************************************* //
+	void InputLog::EndStep(uint64_t _stateHash)
+	{
+		if( m_mode == Mode::OFF ) return;
+		double stepTime = TimeQuery(m_stepTimer);
+
+		if( m_mode == Mode::RECORD )
+		{
+			// A step without player input still has a frame
+			if( m_frames.size() <= m_step )
+			{
+				Frame frame = {ShipCommand(), 0, (uint32)m_events.size(), 0};
+				frame.command.targetVelocity = frame.command.targetAngularVelocity = frame.command.pointingDirection = Vec3(0.0f);
+				m_frames.push_back(frame);
+			}
+			m_frames[(size_t)m_step].stateHash = _stateHash;
+		} else if( m_step < m_frames.size() ) {
+			if( !m_desyncReported && m_frames[(size_t)m_step].stateHash != _stateHash )
+			{
+				LOG_ERROR("Replay desync in step " + std::to_string(m_step) + ": the simulation state differs from the recording.");
+				m_desyncReported = true;
+			}
+			m_totalStepTime += stepTime;
+			m_maxStepTime = max(m_maxStepTime, stepTime);
+			if( m_step + 1 == m_frames.size() )
+				LOG_LVL2("Replay finished after " + std::to_string(m_frames.size()) + " steps: average step "
+					+ std::to_string(m_totalStepTime * 1000.0 / m_frames.size()) + " ms, slowest step "
+					+ std::to_string(m_maxStepTime * 1000.0) + " ms" + (m_desyncReported ? " (desynchronized)" : ""));
+		}
+		++m_step;
+	}
+
+} // namespace Replay
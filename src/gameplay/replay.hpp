@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <jofilelib.hpp>
+#include <ei/vector.hpp>
+#include "predeclarations.hpp"
+#include "timer.hpp"
+
+/// \brief Deterministic lockstep simulation: seeds and recorded input.
+/// \details If the simulation is run with the same seed and the same input
+///		per step it produces bit-identical results on the same binary. The
+///		input log stores everything the player controller feeds into the
+///		simulation together with a hash of the state after each step. A
+///		replay reproduces a session and reports the first step which diverges.
+namespace Replay {
+
+	/// \brief Set the seed of the session. All simulation random generators
+	///		created afterwards derive their seeds from it.
+	void SetSessionSeed(uint32 _seed);
+
+	/// \brief Derive the seed for a new random generator.
+	/// \details The seeds depend on the order of calls, which must therefore
+	///		be deterministic (e.g. object construction on the simulation thread).
+	uint32 NextSeed();
+
+	/// \brief A key event which is applied at a step boundary.
+	struct KeyEvent
+	{
+		enum struct Type: uint8
+		{
+			DOWN,
+			RELEASE
+		};
+		Type type;
+		int key;
+		int modifiers;
+	};
+
+	/// \brief The target values the player controller sets for its ship in
+	///		one step.
+	struct ShipCommand
+	{
+		ei::Vec3 targetVelocity;
+		ei::Vec3 targetAngularVelocity;
+		ei::Vec3 pointingDirection;
+	};
+
+	/// \brief Records or plays back the input of each simulation step.
+	class InputLog
+	{
+	public:
+		enum struct Mode
+		{
+			OFF,
+			RECORD,
+			REPLAY
+		};
+
+		InputLog();
+
+		/// \brief Start a new recording and set the session seed.
+		void StartRecording(uint32 _seed);
+
+		/// \brief Load a recorded session and set its seed.
+		/// \throws std::string if the file is no valid input log.
+		void StartReplay(const Jo::Files::IFile& _file);
+
+		/// \brief Stop recording or replaying. The recorded data remains.
+		void Stop();
+
+		/// \brief Write the recorded session into an opened file.
+		void Save(Jo::Files::IFile& _file) const;
+
+		Mode GetMode() const { return m_mode; }
+		uint64_t GetStep() const { return m_step; }
+		bool IsReplayFinished() const { return m_mode == Mode::REPLAY && m_step >= m_frames.size(); }
+
+		/// \brief Store the input of the current step.
+		void Record(const ShipCommand& _command, const std::vector<KeyEvent>& _events);
+
+		/// \brief Get the recorded input of the current step.
+		/// \param [out] _events Empty container for the recorded key events.
+		/// \return false if there is no more recorded step.
+		bool Play(ShipCommand& _command, std::vector<KeyEvent>& _events) const;
+
+		/// \brief Start measuring the time of a simulation step.
+		void BeginStep();
+
+		/// \brief Finish the current step with a hash of the simulation state.
+		/// \details During a replay the hash is compared to the recorded one
+		///		and the first desync is reported. At the end of a replay the
+		///		timing summary is logged, such that replays can be used as
+		///		benchmarks.
+		void EndStep(uint64_t _stateHash);
+	private:
+		struct Frame
+		{
+			ShipCommand command;
+			uint64_t stateHash;
+			uint32 firstEvent;
+			uint32 numEvents;
+		};
+
+		Mode m_mode;
+		uint32 m_seed;
+		uint64_t m_step;
+		std::vector<Frame> m_frames;
+		std::vector<KeyEvent> m_events;
+		bool m_desyncReported;
+
+		TimeQuerySlot m_stepTimer;
+		double m_totalStepTime;
+		double m_maxStepTime;
+	};
+
+} // namespace Replay
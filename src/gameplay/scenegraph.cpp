@@ -1,14 +1,28 @@
 #include "scenegraph.hpp"
 #include "math/box.hpp"
 #include "voxel/sparseoctree.hpp"
+#include "ship.hpp"
 #include <algorithm>
+#include <chrono>
 
 using namespace ei;
 using namespace Math;
 
+// time in seconds an island must rest before it falls asleep
+const float SLEEP_TIME = 1.0f;
+
+// objects moving more than this fraction of their radius per step use CCD
+const float CCD_MOTION_THRESHOLD = 0.5f;
+// bounding spheres are advanced until they overlap by this fraction of the smaller radius
+const float CCD_PENETRATION = 0.25f;
+const int CCD_MAX_ITERATIONS = 16;
+
 // ************************************************************************* //
 SceneGraph::SceneGraph() :
-	m_xIntervalMax()
+	m_objects(),
+	m_nextID(1),
+	m_maxShieldRadius(0.0f),
+	m_renderAlpha(1.0f)
 {
 }
 
@@ -16,71 +30,198 @@ SceneGraph::SceneGraph() :
 SOHandle SceneGraph::AddObject(ISceneObject* _object)
 {
 	SOHandle handle(_object);
-	// Add bounding intervals to the lists
-	m_newObjects.push_back(handle);
+	_object->m_id = m_nextID++;
+	// Inserted into the list and the spatial hash by the next UpdateGraph()
+	m_objects.Append(handle);
 	return std::move(handle);
 }
 
 // ************************************************************************* //
-SOHandle SceneGraph::RayQuery(const Math::WorldRay& _ray, Voxel::Model::ModelData::HitResult& _hit, float _maxRange) const
+SOHandle SceneGraph::RayQuery(const Math::WorldRay& _ray, Voxel::Model::ModelData::HitResult& _hit, float _maxRange,
+	uint32 _ignoreID, float* _distance) const
 {
-	// The algorithm assumes always increasing x coordinates. Turn ray if necessary.
-	FixVec3 origin;
-	Vec3 direction;
-	if( _ray.direction[0] < 0.0f ) {origin = _ray.origin + FixVec3(_maxRange * _ray.direction); direction = -_ray.direction;}
-	else {origin = _ray.origin; direction = _ray.direction;}
-	// Test iteratively against bounding boxes build from split ray segment ->
-	// each logarithmic split reduces the checked volume by 4x.
-	int numSplits = max(1, int(_maxRange) / 100); // Split into boxes of length CONST
-	WorldBox box;
-	FixVec3 offset = FixVec3((_maxRange / numSplits) * direction);
-	FixVec3 rayEnd = origin + offset;
-	box.min = min(origin, rayEnd);
-	box.max = max(origin, rayEnd);
+	auto readAccess = m_objects.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+	FixVec3 rayEnd = _ray.origin + FixVec3(_maxRange * _ray.direction);
+	std::vector<uint32> ids;
+	std::vector<int> candidates;
+	{
+		std::lock_guard<std::mutex> lock(m_spatialHashMutex);
+		QueryIndices(readAccess, min(_ray.origin, rayEnd), max(_ray.origin, rayEnd), ids, candidates);
+	}
 
-	// Check all the colliders inside box and return closest intersection
+	// Sort the candidates by the distance where the ray enters their bounding
+	// box. The search stops at the first box behind the closest hit.
+	struct Entry
+	{
+		float distance;
+		int object;
+		bool operator < (const Entry& _other) const
+		{
+			return distance < _other.distance || (distance == _other.distance && object < _other.object);
+		}
+	};
+	std::vector<Entry> entries;
+	ei::Ray relativeRay(Vec3(0.0f), _ray.direction);
+	for( int i : candidates )
+	{
+		if( readAccess[i]->GetID() == _ignoreID || !readAccess[i]->HasCapability(SOCapability::VOXEL_MODEL) ) continue;
+		ei::Box objectBox(Vec3(readAccess[i]->GetBoundingBoxMin() - _ray.origin), Vec3(readAccess[i]->GetBoundingBoxMax() - _ray.origin));
+		Entry entry;
+		if( ei::intersects(relativeRay, objectBox, entry.distance) && entry.distance <= _maxRange )
+		{
+			entry.object = i;
+			entries.push_back(entry);
+		}
+	}
+	std::sort(entries.begin(), entries.end());
+
+	// Check all the colliders along the ray and return closest intersection
+	float range = _maxRange;
 	SOHandle closestHit;
-	auto xReadAccess = m_xIntervalMax.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
-	// Find first element which is a candidate for x
-	auto startit = std::lower_bound(xReadAccess.buf().begin(), xReadAccess.buf().end(), box.min[0], [](const SOHandle& _i, const Fix& _ref){ return _i->GetBoundingBoxMax()[0] < _ref; });
-	if( startit == xReadAccess.buf().end() ) return nullptr;
-	for(int step = 0; step < numSplits; ++step)
-	{
-		auto it = startit;
-	//	LOG_ERROR(std::to_string((double)box.max[0]));
-		// Iterate as long as the element intersects in x
-		while( (*it)->m_minOfAllMin <= box.max[0] )
+	for( auto& entry : entries )
+	{
+		if( entry.distance > range ) break;
+		const Voxel::Model* model = static_cast<const Voxel::Model*>(&readAccess[entry.object]);
+		Voxel::Model::ModelData::HitResult hit;
+		// RayCast shortens the range to the closest hit
+		if( model->RayCast(_ray, 0, hit, range) )
+		{
+			closestHit = readAccess[entry.object];
+			_hit = hit;
+		}
+	}
+
+	if( _distance ) *_distance = range;
+	return closestHit;
+}
+
+// ************************************************************************* //
+// Number of rays per task in parallel batch queries
+const int RAY_BATCH_SIZE = 64;
+
+void SceneGraph::RayQueryBatch(const RayQueryInfo* _rays, int _numRays, RayQueryResult* _results, bool _parallel)
+{
+	auto readAccess = m_objects.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+	std::lock_guard<std::mutex> lock(m_spatialHashMutex);
+	if( _parallel && _numRays > RAY_BATCH_SIZE )
+	{
+		int numTasks = (_numRays + RAY_BATCH_SIZE - 1) / RAY_BATCH_SIZE;
+		Utils::JobSystem::ParallelFor(numTasks, [&](int _task){
+			int first = _task * RAY_BATCH_SIZE;
+			RayQueryBatchRange(readAccess, _rays, first, min(RAY_BATCH_SIZE, _numRays - first), _results);
+		});
+	} else
+		RayQueryBatchRange(readAccess, _rays, 0, _numRays, _results);
+}
+
+// ************************************************************************* //
+void SceneGraph::RayQueryBatchRange(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects,
+	const RayQueryInfo* _rays, int _first, int _num, RayQueryResult* _results) const
+{
+	// Pairs of object index and ray index where the ray passes the bounding box
+	struct Candidate
+	{
+		int object;
+		int ray;
+		bool operator < (const Candidate& _other) const
+		{
+			return object < _other.object || (object == _other.object && ray < _other.ray);
+		}
+	};
+	std::vector<Candidate> candidates;
+	std::vector<uint32> ids;
+	std::vector<int> objects;
+
+	for( int r = _first; r < _first + _num; ++r )
+	{
+		const RayQueryInfo& info = _rays[r];
+		_results[r].object = nullptr;
+		_results[r].distance = info.maxRange;
+		_results[r].shield = false;
+
+		FixVec3 rayEnd = info.ray.origin + FixVec3(info.maxRange * info.ray.direction);
+		WorldBox box;
+		box.min = min(info.ray.origin, rayEnd);
+		box.max = max(info.ray.origin, rayEnd);
+		// Shield spheres reach beyond the bounding boxes of their ships
+		if( info.stopAtShields )
 		{
-			// The current element intersects in x direction. Does it also intersect
-			// in the others?
-			if( (*it)->GetBoundingBoxMin()[1] < box.max[1] && (*it)->GetBoundingBoxMax()[1] > box.min[1] &&
-				(*it)->GetBoundingBoxMin()[2] < box.max[2] && (*it)->GetBoundingBoxMax()[2] > box.min[2] )
+			FixVec3 extent(Vec3(m_maxShieldRadius));
+			box.min = box.min - extent;
+			box.max = box.max + extent;
+		}
+		ei::Ray relativeRay(Vec3(0.0f), info.ray.direction);
+
+		QueryIndices(_objects, box.min, box.max, ids, objects);
+		for( int i : objects )
+		{
+			if( _objects[i]->GetID() != info.ignoreID && _objects[i]->HasCapability(SOCapability::VOXEL_MODEL) )
 			{
-				const Voxel::Model* model = dynamic_cast<const Voxel::Model*>(&(*it));
-				if(model)
+				// The shield is tested first, it encloses the bounding box
+				if( info.stopAtShields && _objects[i]->HasCapability(SOCapability::SHIP)
+					&& RayHitsShield(static_cast<const Ship&>(*_objects[i]), info.ray, _results[r].distance) )
+				{
+					_results[r].object = _objects[i];
+					_results[r].shield = true;
+					continue;
+				}
+				// Exact test against the bounding box relative to the ray origin
+				ei::Box objectBox(Vec3(_objects[i]->GetBoundingBoxMin() - info.ray.origin), Vec3(_objects[i]->GetBoundingBoxMax() - info.ray.origin));
+				float d;
+				if( ei::intersects(relativeRay, objectBox, d) && d <= info.maxRange )
 				{
-					Voxel::Model::ModelData::HitResult hit;
-					if( model->RayCast(_ray, 0, hit, _maxRange) )
-					{
-						closestHit = *it;
-						_hit = hit;
-					}
+					Candidate candidate = { i, r };
+					candidates.push_back(candidate);
 				}
 			}
-			++it;
-			if( it == xReadAccess.buf().end() )
-				return closestHit;
-			if( (*startit)->GetBoundingBoxMax()[0] <= box.max[0] )
-				++startit;
 		}
-		// Ray march to a next box segment
-		box.min = rayEnd;
-		rayEnd = rayEnd + offset;
-		box.max = max(box.min, rayEnd);
-		box.min = min(box.min, rayEnd);
 	}
 
-	return closestHit;
+	// Bin by object and transform each model only once
+	std::sort(candidates.begin(), candidates.end());
+	for( size_t c = 0; c < candidates.size(); )
+	{
+		const Voxel::Model* model = static_cast<const Voxel::Model*>(&_objects[candidates[c].object]);
+		const Mat3x3& rotation = model->GetInverseRotationMatrix();
+		const FixVec3& position = model->GetPosition();
+		const Vec3& center = model->GetCenter();
+		int object = candidates[c].object;
+		for( ; c < candidates.size() && candidates[c].object == object; ++c )
+		{
+			const RayQueryInfo& info = _rays[candidates[c].ray];
+			RayQueryResult& result = _results[candidates[c].ray];
+			ei::Ray ray(rotation * Vec3(info.ray.origin - position) + center, normalize(rotation * info.ray.direction));
+			Voxel::Model::ModelData::HitResult hit;
+			// RayCast shortens the range to the closest hit
+			if( model->RayCastLocal(ray, 0, hit, result.distance) )
+			{
+				result.object = _objects[object];
+				result.hit = hit;
+				result.shield = false;
+			}
+		}
+	}
+}
+
+// ************************************************************************* //
+bool SceneGraph::RayHitsShield(const Ship& _ship, const Math::WorldRay& _ray, float& _distance)
+{
+	const Mechanics::ShieldSystem& shields = _ship.GetPrimarySystem().GetShields();
+	if( !shields.IsUp() ) return false;
+
+	// Analytic ray-sphere test relative to the ray origin
+	Vec3 center = Vec3(_ship.GetPosition() - _ray.origin);
+	float radius = shields.GetRadius();
+	float c = lensq(center) - radius * radius;
+	// Shots from inside the shield pass
+	if( c <= 0.0f ) return false;
+	float b = dot(center, _ray.direction);
+	float discriminant = b * b - c;
+	if( b <= 0.0f || discriminant < 0.0f ) return false;
+	float d = b - sqrt(discriminant);
+	if( d >= _distance ) return false;
+	_distance = d;
+	return true;
 }
 
 /*SOHandle SceneGraph::RayQueryCandidate(const SOHandle& _obj, Voxel::Model::ModelData::HitResult& _hit, float& _maxRange) const
@@ -90,121 +231,614 @@ SOHandle SceneGraph::RayQuery(const Math::WorldRay& _ray, Voxel::Model::ModelDat
 // ************************************************************************* //
 void SceneGraph::BoxQuery(const Math::WorldBox _box, Jo::HybridArray<SOHandle, 16>& _out) const
 {
-	auto xReadAccess = m_xIntervalMax.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
-	// TODO: Segment trees or similar. currently only x is restricted logarithmically.
-	// Find first element which is a candidate for x
-	auto it = std::lower_bound(xReadAccess.buf().begin(), xReadAccess.buf().end(), _box.min[0], [](const SOHandle& _i, const Fix& _ref){ return _i->GetBoundingBoxMax()[0] < _ref; });
-	// Iterate as long as the element intersects in x
-	while( it != xReadAccess.buf().end() && (*it)->m_minOfAllMin < _box.max[0] )
+	auto readAccess = m_objects.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+	std::vector<uint32> ids;
+	std::vector<int> candidates;
+	{
+		std::lock_guard<std::mutex> lock(m_spatialHashMutex);
+		QueryIndices(readAccess, _box.min, _box.max, ids, candidates);
+	}
+	for( int i : candidates )
+	{
+		if( readAccess[i]->GetBoundingBoxMin()[0] < _box.max[0] && readAccess[i]->GetBoundingBoxMax()[0] > _box.min[0] &&
+			readAccess[i]->GetBoundingBoxMin()[1] < _box.max[1] && readAccess[i]->GetBoundingBoxMax()[1] > _box.min[1] &&
+			readAccess[i]->GetBoundingBoxMin()[2] < _box.max[2] && readAccess[i]->GetBoundingBoxMax()[2] > _box.min[2] )
+			_out.PushBack(readAccess[i]);
+	}
+}
+
+// ************************************************************************* //
+void SceneGraph::QueryIndices(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, const Math::FixVec3& _min, const Math::FixVec3& _max,
+	std::vector<uint32>& _ids, std::vector<int>& _out) const
+{
+	_ids.clear();
+	_out.clear();
+	m_spatialHash.Query(_min, _max, _ids);
+	std::sort(_ids.begin(), _ids.end());
+
+	// Both are sorted by id: search only behind the previous match. The hash
+	// may contain objects which are not part of this version of the list.
+	auto it = _objects.buf().begin();
+	for( uint32 id : _ids )
 	{
-		// The current element intersects in x direction. Does it also intersect
-		// in the others?
-		if( (*it)->GetBoundingBoxMin()[1] < _box.max[1] && (*it)->GetBoundingBoxMax()[1] > _box.min[1] &&
-			(*it)->GetBoundingBoxMin()[2] < _box.max[2] && (*it)->GetBoundingBoxMax()[2] > _box.min[2] )
-			_out.PushBack(*it);
-		++it;
+		it = std::lower_bound(it, _objects.buf().end(), id, [](const SOHandle& _i, uint32 _id){ return _i->GetID() < _id; });
+		if( it == _objects.buf().end() ) break;
+		if( (*it)->GetID() == id )
+			_out.push_back(int(it - _objects.buf().begin()));
 	}
 }
 
 // ************************************************************************* //
-void SceneGraph::FrustumQuery(Jo::HybridArray<SOHandle, 32>& _out) const
+void SceneGraph::SphereQuery(const FixVec3& _center, float _radius, std::vector<SOHandle>& _out) const
 {
-	auto xReadAccess = m_xIntervalMax.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+	auto readAccess = m_objects.GetReadAccess();
+	std::vector<uint32> ids;
+	std::vector<int> candidates;
+	FixVec3 extent(Vec3(_radius));
+	{
+		std::lock_guard<std::mutex> lock(m_spatialHashMutex);
+		QueryIndices(readAccess, _center - extent, _center + extent, ids, candidates);
+	}
+	_out.clear();
+	for( int i : candidates )
+	{
+		// Distance to the closest point of the box
+		Vec3 boxMin = Vec3(readAccess[i]->GetBoundingBoxMin() - _center);
+		Vec3 boxMax = Vec3(readAccess[i]->GetBoundingBoxMax() - _center);
+		if( lensq(max(boxMin, min(boxMax, Vec3(0.0f)))) <= _radius * _radius )
+			_out.push_back(readAccess[i]);
+	}
+}
+
+// ************************************************************************* //
+void SceneGraph::FrustumQuery(Jo::HybridArray<SOHandle, 32>& _out, SOCapability _capability) const
+{
+	auto readAccess = GetObjects(_capability);
 	// TODO: Frustum culling (currently this returns all objects)
-	for(auto& it: xReadAccess.buf())
+	for(auto& it: readAccess.buf())
 		_out.PushBack(it);
 }
 
 // ************************************************************************* //
-void SceneGraph::UpdateGraph()
+// Index of the single set bit
+static int CapabilityIndex(SOCapability _capability)
 {
-	// We want to add objects and reorder the buffer
-	Utils::ThreadSafeBuffer<SOHandle>::WriteGuard xListAccess;
-	m_xIntervalMax.GetWriteAccess(xListAccess);
+	int index = 0;
+	uint8 bits = (uint8)_capability;
+	Assert(bits && !(bits & (bits - 1)), "Expected a single capability bit.");
+	while( bits > 1 ) { bits >>= 1; ++index; }
+	return index;
+}
 
-	for (int i = 0; i < xListAccess.buf().size(); i++)
+Utils::MultiVersionBuffer<SOHandle>::ReadGuard SceneGraph::GetObjects(SOCapability _capability) const
+{
+	return m_capabilityLists[CapabilityIndex(_capability)].GetReadAccess();
+}
+
+// ************************************************************************* //
+// FNV-1a over the raw bytes
+static void HashBytes(uint64_t& _hash, const void* _data, size_t _size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(_data);
+	for (size_t i = 0; i < _size; ++i)
+	{
+		_hash ^= bytes[i];
+		_hash *= 0x100000001b3ull;
+	}
+}
+
+uint64_t SceneGraph::ComputeStateHash() const
+{
+	auto readAccess = m_objects.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (int i = 0; i < readAccess.size(); ++i)
+	{
+		if( !readAccess[i]->HasCapability(SOCapability::VOXEL_MODEL) ) continue;
+		const Voxel::Model* model = static_cast<const Voxel::Model*>(&readAccess[i]);
+		uint32 id = model->GetID();
+		int numVoxels = model->GetNumVoxels();
+		HashBytes(hash, &id, sizeof(id));
+		HashBytes(hash, &numVoxels, sizeof(numVoxels));
+		HashBytes(hash, &model->GetPosition(), sizeof(FixVec3));
+		HashBytes(hash, &model->GetRotation(), sizeof(Quaternion));
+		HashBytes(hash, &model->GetVelocity(), sizeof(Vec3));
+		HashBytes(hash, &model->GetAngularVelocity(), sizeof(Vec3));
+	}
+	return hash;
+}
+
+// ************************************************************************* //
+void SceneGraph::UpdateGraph()
+{
 	{
-		auto models = static_cast<Voxel::Model*>(&xListAccess.buf()[i])->UpdateCohesion();
-		for (auto& model : models)
-			AddObject(model);
+		auto readAccess = m_objects.GetReadAccess();
+		m_cohesionObjects.clear();
+		for (int i = 0; i < readAccess.size(); i++)
+		{
+			// Sleeping objects did not take any damage. Coarse objects keep their
+			// damage flags until they are near again.
+			if( readAccess[i]->IsSleeping() || readAccess[i]->IsCoarse()
+				|| !readAccess[i]->HasCapability(SOCapability::VOXEL_MODEL) ) continue;
+			m_cohesionObjects.push_back(i);
+		}
+
+		// Each model is split independently. The fragments are added in object
+		// order afterwards to get the same ids for any number of threads.
+		m_cohesionResults.resize(m_cohesionObjects.size());
+		Utils::JobSystem::ParallelFor((int)m_cohesionObjects.size(), [&](int _i){
+			m_cohesionResults[_i] = static_cast<Voxel::Model*>(&readAccess[m_cohesionObjects[_i]])->UpdateCohesion();
+		});
+		for( auto& models : m_cohesionResults )
+			for( auto& model : models )
+				AddObject(model);
 	}
 
-	ManageObjects(xListAccess);
+	// Recycled versions of the list replay this change instead of copying
+	// the list. Objects deleted after the unlink stay until the next update.
+	std::vector<uint32> deletedIDs;
+	UnlinkDeletedObjects(deletedIDs);
+	if( m_objects.HasStaged() || !deletedIDs.empty() )
+	{
+		m_objects.Apply([deletedIDs](std::vector<SOHandle>& _objects, const std::vector<SOHandle>& _added){
+			ManageObjects(_objects, _added, deletedIDs);
+		});
+		auto objectsAccess = m_objects.GetReadAccess();
+		UpdateCapabilityLists(objectsAccess.buf());
+	}
 
 	// Update objects them self (bounding volumes...)
-	for( int i = 0; i < xListAccess.buf().size(); i++ )
+	auto readAccess = m_objects.GetReadAccess();
+	for( int i = 0; i < readAccess.size(); i++ )
 	{
-		xListAccess.buf()[i]->UpdateBoundingBox();
+		if( !readAccess[i]->IsSleeping() )
+			readAccess[i]->UpdateBoundingBox();
 	}
 
-	ResortAxis(xListAccess);
+	// Shielded ray queries inflate their search box by this radius
+	m_maxShieldRadius = 0.0f;
+	auto ships = GetObjects(SOCapability::SHIP);
+	for( int i = 0; i < ships.size(); ++i )
+		m_maxShieldRadius = max(m_maxShieldRadius, static_cast<const Ship&>(*ships[i]).GetPrimarySystem().GetShields().GetRadius());
+
+	UpdateSpatialHash(readAccess.buf());
+}
+
+// ************************************************************************* //
+void SceneGraph::UnlinkDeletedObjects(std::vector<uint32>& _ids)
+{
+	auto readAccess = m_objects.GetReadAccess();
+	for( int i = 0; i < readAccess.size(); ++i )
+		if( readAccess[i]->IsDeleted() )
+			_ids.push_back(readAccess[i]->GetID());
+	if( _ids.empty() ) return;
+
+	std::lock_guard<std::mutex> lock(m_spatialHashMutex);
+	for( uint32 id : _ids )
+		m_spatialHash.Remove(id);
 }
 
 // ************************************************************************* //
 void SceneGraph::Simulate(float _deltaTime)
 {
-	auto xReadAccess = m_xIntervalMax.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+	auto readAccess = m_objects.GetReadAccess();	// Copy shared pointer to assert that the buffer does not change during algorithm.
+
+	m_lod.Update(readAccess, _deltaTime);
+	FindCollisionPairs(readAccess);
+	SweepFastObjects(readAccess, _deltaTime);
+	BuildIslands(readAccess);
 
+	m_pairContact.assign(m_collisionPairs.size(), 0);
+	Utils::JobSystem::ParallelFor((int)m_islands.size(), [&](int _island){
+		CollideIsland(readAccess, m_islands[_island]);
+	});
+	// Systems see the velocities after the collision response, exactly as
+	// if each ship ran them in its own Simulate().
+	RunComponentSystems(readAccess, _deltaTime);
+	Utils::JobSystem::ParallelFor((int)m_islands.size(), [&](int _island){
+		IntegrateIsland(readAccess, m_islands[_island], _deltaTime);
+	});
+
+	// Islands for sleeping contain only the objects which are in contact.
+	for (int i = 0; i < readAccess.size(); ++i)
+		m_islandParent[i] = i;
+	for (size_t p = 0; p < m_collisionPairs.size(); ++p)
+		if( m_pairContact[p] )
+			UniteIslands(m_collisionPairs[p].first, m_collisionPairs[p].second);
+
+	UpdateSleepStates(readAccess, _deltaTime);
+}
+
+// ************************************************************************* //
+// Conservative advancement of two bounding spheres. Each iteration advances
+// by the distance divided by the maximal approaching speed, which cannot skip
+// the contact.
+// Returns true if the spheres get in contact within _deltaTime.
+static bool ConservativeAdvancement(const Voxel::Model& _model0, const Voxel::Model& _model1, float _deltaTime, float& _timeOfImpact)
+{
+	Vec3 relPosition = Vec3(_model1.GetPosition() - _model0.GetPosition());
+	Vec3 relVelocity = _model1.GetVelocity() - _model0.GetVelocity();
+	float speed = len(relVelocity);
+	// Spheres which are separating or already intersecting are left to the discrete test
+	if( speed < 1e-6f || dot(relPosition, relVelocity) >= 0.0f ) return false;
+	float contactDistance = _model0.GetRadius() + _model1.GetRadius();
+	if( len(relPosition) <= contactDistance ) return false;
+	contactDistance -= CCD_PENETRATION * min(_model0.GetRadius(), _model1.GetRadius());
+
+	float t = 0.0f;
+	for( int i = 0; i < CCD_MAX_ITERATIONS; ++i )
+	{
+		float distance = len(relPosition + relVelocity * t) - contactDistance;
+		if( distance <= 1e-3f ) break;
+		t += distance / speed;
+		if( t >= _deltaTime ) return false;
+	}
+	_timeOfImpact = t;
+	return true;
+}
+
+// ************************************************************************* //
+void SceneGraph::SweepFastObjects(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime)
+{
+	size_t numDiscretePairs = m_collisionPairs.size();
+	int n = _objects.size();
+	for (int i = 0; i < n; ++i)
+	{
+		// Coarse objects do not use swept tests
+		if( _objects[i]->GetStepTime() == 0.0f || _objects[i]->IsCoarse() ) continue;
+		Voxel::Model& model = *static_cast<Voxel::Model*>(&_objects[i]);
+		Vec3 motion = model.GetVelocity() * _deltaTime;
+		if( len(motion) <= CCD_MOTION_THRESHOLD * model.GetRadius() ) continue;
+
+		const FixVec3& boxMin = model.GetBoundingBoxMin();
+		const FixVec3& boxMax = model.GetBoundingBoxMax();
+		FixVec3 sweepMin = min(boxMin, boxMin + FixVec3(motion));
+		FixVec3 sweepMax = max(boxMax, boxMax + FixVec3(motion));
+
+		float timeOfImpact = _deltaTime;
+		QueryIndices(_objects, sweepMin, sweepMax, m_queryIDs, m_queryIndices);
+		for (int j : m_queryIndices)
+		{
+			if( j == i ) continue;
+			const ISceneObject& other = *_objects[j];
+			// Coarse objects which skip this step are tested in their last
+			// integrated state.
+			if( !(other.GetBoundingBoxMin()[0] < sweepMax[0] && other.GetBoundingBoxMax()[0] > sweepMin[0]
+				&& other.GetBoundingBoxMin()[1] < sweepMax[1] && other.GetBoundingBoxMax()[1] > sweepMin[1]
+				&& other.GetBoundingBoxMin()[2] < sweepMax[2] && other.GetBoundingBoxMax()[2] > sweepMin[2]) )
+				continue;
+			// Pairs with overlapping boxes are already known from the broadphase
+			if( other.GetBoundingBoxMin()[0] < boxMax[0] && other.GetBoundingBoxMax()[0] > boxMin[0]
+				&& other.GetBoundingBoxMin()[1] < boxMax[1] && other.GetBoundingBoxMax()[1] > boxMin[1]
+				&& other.GetBoundingBoxMin()[2] < boxMax[2] && other.GetBoundingBoxMax()[2] > boxMin[2] )
+				continue;
+
+			float toi;
+			if( ConservativeAdvancement(model, *static_cast<const Voxel::Model*>(&other), _deltaTime, toi) )
+			{
+				timeOfImpact = min(timeOfImpact, toi);
+				// Both must be in the same island to be simulated by the same thread
+				CollisionPair pair = {min(i, j), max(i, j)};
+				m_collisionPairs.push_back(pair);
+			}
+		}
+		if( timeOfImpact < _deltaTime )
+			model.SetTimeOfImpact(timeOfImpact);
+	}
+
+	// Two fast objects may have found each other
+	auto first = m_collisionPairs.begin() + numDiscretePairs;
+	std::sort(first, m_collisionPairs.end(), [](const CollisionPair& _lhs, const CollisionPair& _rhs){
+		return _lhs.first < _rhs.first || (_lhs.first == _rhs.first && _lhs.second < _rhs.second);
+	});
+	m_collisionPairs.erase(std::unique(first, m_collisionPairs.end(), [](const CollisionPair& _lhs, const CollisionPair& _rhs){
+		return _lhs.first == _rhs.first && _lhs.second == _rhs.second;
+	}), m_collisionPairs.end());
+}
+
+// ************************************************************************* //
+void SceneGraph::BuildIslands(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects)
+{
+	int n = _objects.size();
+	m_islandParent.resize(n);
+	for (int i = 0; i < n; ++i)
+		m_islandParent[i] = i;
+	for (auto& pair : m_collisionPairs)
+		UniteIslands(pair.first, pair.second);
+
+	// Sleeping objects take part only if they have an awake partner
+	m_islandOfObject.assign(n, -1);
+	for (auto& pair : m_collisionPairs)
+	{
+		m_islandOfObject[pair.first] = 0;
+		m_islandOfObject[pair.second] = 0;
+	}
+
+	// Enumerate the islands in order of their smallest object
+	m_islands.clear();
+	for (int i = 0; i < n; ++i)
+	{
+		if( _objects[i]->GetStepTime() == 0.0f && m_islandOfObject[i] == -1 ) continue;
+		int root = FindIsland(i);
+		if( root == i )
+		{
+			Island island = {0, 0, 0, 0};
+			m_islandOfObject[i] = (int)m_islands.size();
+			m_islands.push_back(island);
+		} else m_islandOfObject[i] = m_islandOfObject[root];	// Roots are the smallest index
+		m_islands[m_islandOfObject[i]].numObjects++;
+	}
+	for (auto& pair : m_collisionPairs)
+		m_islands[m_islandOfObject[pair.first]].numPairs++;
+
+	// Counting sort of objects and pairs into the islands
+	int objectOffset = 0, pairOffset = 0;
+	for (auto& island : m_islands)
+	{
+		island.firstObject = objectOffset;
+		island.firstPair = pairOffset;
+		objectOffset += island.numObjects;
+		pairOffset += island.numPairs;
+		island.numObjects = 0;
+		island.numPairs = 0;
+	}
+	m_islandObjects.resize(objectOffset);
+	m_islandPairs.resize(pairOffset);
+	for (int i = 0; i < n; ++i)
+	{
+		if( _objects[i]->GetStepTime() == 0.0f && m_islandOfObject[i] == -1 ) continue;
+		Island& island = m_islands[m_islandOfObject[i]];
+		m_islandObjects[island.firstObject + island.numObjects++] = i;
+	}
+	for (int p = 0; p < (int)m_collisionPairs.size(); ++p)
+	{
+		Island& island = m_islands[m_islandOfObject[m_collisionPairs[p].first]];
+		m_islandPairs[island.firstPair + island.numPairs++] = p;
+	}
+}
+
+// ************************************************************************* //
+// Coarse collision of two bounding spheres. The impulse is elastic, so
+// momentum and kinetic energy are conserved.
+// Returns true if the spheres are in contact.
+static bool SphereCollision(Voxel::Model& _model0, Voxel::Model& _model1)
+{
+	Vec3 normal = Vec3(_model1.GetPosition() - _model0.GetPosition());
+	float distance = len(normal);
+	if( distance >= _model0.GetRadius() + _model1.GetRadius() ) return false;
+	if( distance < 1e-6f ) return true;
+	normal /= distance;
+
+	float approach = dot(_model0.GetVelocity() - _model1.GetVelocity(), normal);
+	float mass0 = _model0.GetMass();
+	float mass1 = _model1.GetMass();
+	if( approach > 0.0f && mass0 > 0.0f && mass1 > 0.0f )
+	{
+		float impulse = 2.0f * approach / (1.0f / mass0 + 1.0f / mass1);
+		_model0.AddVelocity(normal * (-impulse / mass0));
+		_model1.AddVelocity(normal * (impulse / mass1));
+	}
+	return true;
+}
+
+// ************************************************************************* //
+void SceneGraph::CollideIsland(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, const Island& _island)
+{
 	CollisionCheck collisionCheck;
-	//check every possible pair for collision
-	for (int i = 0; i < xReadAccess.size(); ++i)
-		for (int j = i + 1; j < xReadAccess.size(); ++j)
-			collisionCheck.Run(*(static_cast<Voxel::Model*>(&xReadAccess[i])), *(static_cast<Voxel::Model*>(&xReadAccess[j])));
+	for (int p = _island.firstPair; p < _island.firstPair + _island.numPairs; ++p)
+	{
+		const CollisionPair& pair = m_collisionPairs[m_islandPairs[p]];
+		Voxel::Model& model0 = *static_cast<Voxel::Model*>(&_objects[pair.first]);
+		Voxel::Model& model1 = *static_cast<Voxel::Model*>(&_objects[pair.second]);
+		if( model0.IsCoarse() || model1.IsCoarse() )
+			m_pairContact[m_islandPairs[p]] = SphereCollision(model0, model1);
+		else
+			m_pairContact[m_islandPairs[p]] = collisionCheck.Run(model0, model1);
+	}
+}
 
-	for (int i = 0; i < xReadAccess.size(); ++i){
-		xReadAccess[i]->Simulate(_deltaTime);
+// ************************************************************************* //
+void SceneGraph::RunComponentSystems(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime)
+{
+	m_activeShips.clear();
+	m_shipStepTimes.clear();
+	// Ships which are skipped by the simulation LOD run their systems in
+	// their next coarse step together with the integration.
+	auto ships = GetObjects(SOCapability::SHIP);
+	for (int i = 0; i < ships.size(); ++i)
+	{
+		ISceneObject& obj = *ships[i];
+		if( obj.IsSleeping() || obj.GetStepTime() == 0.0f ) continue;
+		m_activeShips.push_back(static_cast<Ship*>(&obj));
+		m_shipStepTimes.push_back(obj.GetStepTime());
 	}
+	m_componentScheduler.Run(m_activeShips.data(), m_shipStepTimes.data(), (int)m_activeShips.size());
+	ScanSensors(_objects);
 }
 
 // ************************************************************************* //
-void SceneGraph::ResortAxis(Utils::ThreadSafeBuffer<SOHandle>::WriteGuard& _xListAccess)
+void SceneGraph::ScanSensors(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects)
 {
-	// Resort if not empty
-	if(_xListAccess.buf().size() > 1)
+	m_scanningSensors.clear();
+	for( auto sensor : m_componentScheduler.GetSensors() )
+		if( sensor->IsScanDue() )
+			m_scanningSensors.push_back(sensor);
+
+	// Each sensor has its own query buffers
+	Utils::JobSystem::ParallelFor((int)m_scanningSensors.size(), [&](int _i){
+		Mechanics::SensorSystem& sensor = *m_scanningSensors[_i];
+		const FixVec3& center = sensor.m_ship.GetPosition();
+		FixVec3 extent(Vec3(sensor.GetScanRange()));
+		QueryIndices(_objects, center - extent, center + extent, sensor.m_queryIDs, sensor.m_queryIndices);
+		sensor.Scan(_objects.buf(), sensor.m_queryIndices);
+	});
+}
+
+// ************************************************************************* //
+void SceneGraph::IntegrateIsland(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, const Island& _island, float _deltaTime)
+{
+	for (int o = _island.firstObject; o < _island.firstObject + _island.numObjects; ++o)
 	{
-		// Sort axis
-		std::sort(_xListAccess.buf().begin(), _xListAccess.buf().end(), [](const SOHandle& _lhs, const SOHandle& _rhs){
-			return _lhs->GetBoundingBoxMax()[0] < _rhs->GetBoundingBoxMax()[0];
-		});
+		ISceneObject& obj = *_objects[m_islandObjects[o]];
+		if( obj.IsSleeping() ) continue;
+		if( obj.GetStepTime() > 0.0f )
+			obj.Simulate(obj.GetStepTime());
+		// Objects woken up by a collision start with a regular step. Coarse
+		// partners which skip this step keep their pending time, the
+		// collision only changed their velocity.
+		else if( obj.m_pendingTime == 0.0f )
+			obj.Simulate(_deltaTime);
+	}
+}
 
-		// Update additional information for faster queries
-		int n = (int)_xListAccess.buf().size();
-		_xListAccess.buf()[n-1]->m_minOfAllMin = _xListAccess.buf()[n-1]->GetBoundingBoxMin()[0];
-		for( int i = n-2; i >= 0; --i )
+// ************************************************************************* //
+void SceneGraph::FindCollisionPairs(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects)
+{
+	m_collisionPairs.clear();
+	int n = _objects.size();
+	for (int i = 0; i < n; ++i)
+	{
+		const ISceneObject& obj = *_objects[i];
+		// Sleeping and skipped coarse objects do not search partners
+		if( obj.GetStepTime() == 0.0f ) continue;
+		const FixVec3& boxMin = obj.GetBoundingBoxMin();
+		const FixVec3& boxMax = obj.GetBoundingBoxMax();
+
+		// Stepping partners find the pair on their own, so only the one with
+		// the smaller index adds it. Sleeping objects and coarse objects
+		// which skip this step are tested in their last integrated state,
+		// otherwise coarse objects in sectors with different phases would
+		// never meet.
+		QueryIndices(_objects, boxMin, boxMax, m_queryIDs, m_queryIndices);
+		for (int j : m_queryIndices)
 		{
-			Fix minOfMin = min(_xListAccess.buf()[i]->GetBoundingBoxMin()[0], _xListAccess.buf()[i+1]->m_minOfAllMin);
-			_xListAccess.buf()[i]->m_minOfAllMin = minOfMin;
+			if( j == i ) continue;
+			const ISceneObject& other = *_objects[j];
+			if( other.GetStepTime() > 0.0f && j < i ) continue;
+			if( other.GetBoundingBoxMin()[0] < boxMax[0] && other.GetBoundingBoxMax()[0] > boxMin[0]
+				&& other.GetBoundingBoxMin()[1] < boxMax[1] && other.GetBoundingBoxMax()[1] > boxMin[1]
+				&& other.GetBoundingBoxMin()[2] < boxMax[2] && other.GetBoundingBoxMax()[2] > boxMin[2] )
+			{
+				CollisionPair pair = {min(i, j), max(i, j)};
+				m_collisionPairs.push_back(pair);
+			}
 		}
 	}
 }
 
 // ************************************************************************* //
-void SceneGraph::ManageObjects(Utils::ThreadSafeBuffer<SOHandle>::WriteGuard& _xListAccess)
+int SceneGraph::FindIsland(int _object)
 {
-	// Delete the old ones
-	int n = NumActiveObjects();
-	for( int i = 0; i < n; i++ )
+	// Path halving
+	while( m_islandParent[_object] != _object )
 	{
-		if(_xListAccess.buf()[i]->IsDeleted()) {
-			_xListAccess.buf()[i] = std::move(_xListAccess.buf()[--n]);
-			_xListAccess.buf().pop_back();
+		m_islandParent[_object] = m_islandParent[m_islandParent[_object]];
+		_object = m_islandParent[_object];
+	}
+	return _object;
+}
+
+// ************************************************************************* //
+void SceneGraph::UniteIslands(int _object0, int _object1)
+{
+	int root0 = FindIsland(_object0);
+	int root1 = FindIsland(_object1);
+	// Keep the smaller index as root to be independent of the pair order
+	if( root0 < root1 ) m_islandParent[root1] = root0;
+	else if( root1 < root0 ) m_islandParent[root0] = root1;
+}
+
+// ************************************************************************* //
+void SceneGraph::UpdateSleepStates(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime)
+{
+	int n = _objects.size();
+	m_islandAwake.assign(n, 0);
+	m_islandActive.assign(n, 0);
+
+	// An island stays awake if any awake member did not rest long enough and
+	// it is activated if any member is really moving.
+	for (int i = 0; i < n; ++i)
+	{
+		ISceneObject& obj = *_objects[i];
+		if( obj.IsSleeping() || obj.GetStepTime() == 0.0f ) continue;
+		int island = FindIsland(i);
+		if( obj.IsResting() )
+			obj.m_restingTime += obj.GetStepTime();
+		else {
+			obj.m_restingTime = 0.0f;
+			m_islandActive[island] = 1;
 		}
+		if( obj.m_restingTime < SLEEP_TIME )
+			m_islandAwake[island] = 1;
 	}
 
-	// Insert all new objects from the queue
-	int nnew = (int)m_newObjects.size();
-	if(nnew) {
-		for( int i = 0; i < nnew; ++i )
-			_xListAccess.buf().push_back( m_newObjects[i] );
-		m_newObjects.clear();
+	for (int i = 0; i < n; ++i)
+	{
+		ISceneObject& obj = *_objects[i];
+		int island = FindIsland(i);
+		if( obj.IsSleeping() )
+		{
+			// Sleeping objects in contact with moving ones wake up
+			if( m_islandActive[island] )
+				obj.WakeUp();
+		} else if( obj.GetStepTime() > 0.0f && !m_islandAwake[island] ) {
+			obj.m_sleeping = true;
+			obj.OnFallAsleep();
+		}
+	}
+}
+
+// ************************************************************************* //
+void SceneGraph::UpdateSpatialHash(const std::vector<SOHandle>& _objects)
+{
+	std::lock_guard<std::mutex> lock(m_spatialHashMutex);
+	// Sleeping objects did not move
+	for( auto& it : _objects )
+		if( !it->IsSleeping() )
+			m_spatialHash.Update(it->GetID(), it->GetBoundingBoxMin(), it->GetBoundingBoxMax());
+}
+
+// ************************************************************************* //
+void SceneGraph::ManageObjects(std::vector<SOHandle>& _objects, const std::vector<SOHandle>& _added, const std::vector<uint32>& _deletedIDs)
+{
+	// Delete the old ones without changing the order of the others
+	if( !_deletedIDs.empty() )
+		_objects.erase(std::remove_if(_objects.begin(), _objects.end(), [&_deletedIDs](const SOHandle& _object){
+			return std::binary_search(_deletedIDs.begin(), _deletedIDs.end(), _object->GetID());
+		}), _objects.end());
+
+	// Insert all new objects. The list stays sorted by id, which is the
+	// iteration order for all systems.
+	auto byID = [](const SOHandle& _lhs, const SOHandle& _rhs){ return _lhs->GetID() < _rhs->GetID(); };
+	size_t numOld = _objects.size();
+	_objects.insert(_objects.end(), _added.begin(), _added.end());
+	std::sort(_objects.begin() + numOld, _objects.end(), byID);
+	// Ids are taken before staging, so a concurrent insertion can have a
+	// smaller id than the last one of the list.
+	std::inplace_merge(_objects.begin(), _objects.begin() + numOld, _objects.end(), byID);
+}
+
+// ************************************************************************* //
+void SceneGraph::UpdateCapabilityLists(const std::vector<SOHandle>& _objects)
+{
+	for( int c = 0; c < NUM_SO_CAPABILITIES; ++c )
+	{
+		SOCapability capability = SOCapability(1 << c);
+		Utils::MultiVersionBuffer<SOHandle>::WriteGuard listAccess;
+		// Rebuilt from scratch, the old content is not needed
+		m_capabilityLists[c].GetWriteAccess(listAccess, false);
+		for( auto& it : _objects )
+			if( it->HasCapability(capability) )
+				listAccess.buf().push_back(it);
 	}
 }
 
 // ************************************************************************* //
 const float IMPULSE_DAMAGE = 0.2f; //totally arbitrary factor
 
-void SceneGraph::CollisionCheck::Run(Voxel::Model& _model0, Voxel::Model& _model1)
+bool SceneGraph::CollisionCheck::Run(Voxel::Model& _model0, Voxel::Model& _model1)
 {
+	m_hits.clear();
+
 	//use already computed bounding box for the first try
 	float r0 = _model0.GetRadius();
 	r0 *= r0;
@@ -263,7 +897,7 @@ void SceneGraph::CollisionCheck::Run(Voxel::Model& _model0, Voxel::Model& _model
 			TreeCollision(pos0, *node0, pos1, *node1);
 		}
 
-		if (!m_hits.size()) return;
+		if (!m_hits.size()) return false;
 
 		//resolve hits
 
@@ -296,7 +930,7 @@ void SceneGraph::CollisionCheck::Run(Voxel::Model& _model0, Voxel::Model& _model
 		Vec3 normal = normalize(hitLocSlf - hitLocOth);
 
 		//check that they are really closing and not just intersecting from a previous crash
-		if (dot((velocitySlf - velocityOth), normal) >= 0) return;
+		if (dot((velocitySlf - velocityOth), normal) >= 0) return true;
 
 		float epsilon = 0.04f;
 
@@ -328,8 +962,11 @@ void SceneGraph::CollisionCheck::Run(Voxel::Model& _model0, Voxel::Model& _model
 			m_modelOth->Damage(hit.gridPosOth, damageOth);
 	//		m_modelSlf->Set(IVec3(hit.gridPosSlf), Voxel::ComponentType::UNDEFINED);
 		}
-	
+
+		return true;
 	}
+
+	return false;
 }
 
 // ************************************************************************* //
@@ -393,4 +1030,82 @@ void SceneGraph::CollisionCheck::TreeCollision(const IVec4& _position0, const Vo
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+// ************************************************************************* //
+static double SnapshotClock()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SceneGraph::PublishSnapshot(float _stepDuration)
+{
+	auto readAccess = m_objects.GetReadAccess();
+	SceneSnapshot& snapshot = m_snapshots.GetWriteBuffer();
+	snapshot.objects.clear();
+	snapshot.stepDuration = _stepDuration;
+
+	// Both lists are sorted by id: merge to find the previous state. New
+	// objects start without any motion.
+	size_t last = 0;
+	for( int i = 0; i < readAccess.size(); ++i )
+	{
+		if( !readAccess[i]->HasCapability(SOCapability::VOXEL_MODEL) ) continue;
+		const Voxel::Model* model = static_cast<const Voxel::Model*>(&readAccess[i]);
+		TransformSnapshot entry;
+		entry.id = model->GetID();
+		entry.position = model->GetPosition();
+		entry.rotation = model->GetRotation();
+		while( last < m_lastSnapshot.size() && m_lastSnapshot[last].id < entry.id )
+			++last;
+		if( last < m_lastSnapshot.size() && m_lastSnapshot[last].id == entry.id )
+		{
+			entry.previousPosition = m_lastSnapshot[last].position;
+			entry.previousRotation = m_lastSnapshot[last].rotation;
+		} else {
+			entry.previousPosition = entry.position;
+			entry.previousRotation = entry.rotation;
+		}
+		snapshot.objects.push_back(entry);
+	}
+
+	m_lastSnapshot = snapshot.objects;
+	snapshot.time = SnapshotClock();
+	m_snapshots.Publish();
+}
+
+// ************************************************************************* //
+void SceneGraph::BeginRenderFrame()
+{
+	m_snapshots.Acquire();
+	const SceneSnapshot& snapshot = m_snapshots.GetReadBuffer();
+	if( snapshot.stepDuration > 0.0f )
+		m_renderAlpha = clamp(float((SnapshotClock() - snapshot.time) / snapshot.stepDuration), 0.0f, 1.0f);
+	else m_renderAlpha = 1.0f;
+}
+
+// ************************************************************************* //
+bool SceneGraph::GetRenderTransformation(const ISceneObject* _object, Transformation& _out) const
+{
+	const std::vector<TransformSnapshot>& objects = m_snapshots.GetReadBuffer().objects;
+	auto it = std::lower_bound(objects.begin(), objects.end(), _object->GetID(),
+		[](const TransformSnapshot& _entry, uint32 _id){ return _entry.id < _id; });
+	if( it == objects.end() || it->id != _object->GetID() )
+		return false;
+
+	FixVec3 position = it->previousPosition + FixVec3(Vec3(it->position - it->previousPosition) * m_renderAlpha);
+	// Normalized linear interpolation along the shorter arc. The rotation
+	// of one step is small enough that it does not differ from a slerp.
+	const Quaternion& q0 = it->previousRotation;
+	const Quaternion& q1 = it->rotation;
+	float sign = (q0.i * q1.i + q0.j * q1.j + q0.k * q1.k + q0.r * q1.r) < 0.0f ? -1.0f : 1.0f;
+	Quaternion rotation;
+	rotation.i = q0.i + (sign * q1.i - q0.i) * m_renderAlpha;
+	rotation.j = q0.j + (sign * q1.j - q0.j) * m_renderAlpha;
+	rotation.k = q0.k + (sign * q1.k - q0.k) * m_renderAlpha;
+	rotation.r = q0.r + (sign * q1.r - q0.r) * m_renderAlpha;
+	rotation = normalize(rotation);
+
+	_out = Transformation(position, rotation);
+	return true;
+}
@@ -4,12 +4,22 @@
 #include "math/ray.hpp"
 #include "math/box.hpp"
 #include "sceneobject.hpp"
-#include "utilities/threadsafebuffer.hpp"
+#include "utilities/multiversionbuffer.hpp"
+#include "utilities/jobsystem.hpp"
+#include "utilities/triplebuffer.hpp"
+#include "spatialhash.hpp"
+#include "simulationlod.hpp"
+#include "componentsystems/componentscheduler.hpp"
+#include <mutex>
 
 
 /// \brief A scene management for several queries.
 /// \details This class provides the possibilities to return all objects which
 ///		intersect a frustum, a sphere or a ray.
+///
+///		All objects are kept in a list sorted by id. Spatial queries go
+///		through a hierarchical spatial hash (sector, system, local grid), so
+///		objects in distant star systems do not take part in them.
 class SceneGraph
 {
 public:
@@ -22,33 +32,251 @@ public:
 	/// \param [out] _hit Descriptor where the returned model was hit
 	/// \param [in] _maxRange The ray is clamped in a certain distance to
 	///		improve performance and avoid extremely far objects to be selected.
-	SOHandle RayQuery(const Math::WorldRay& _ray, Voxel::Model::ModelData::HitResult& _hit, float _maxRange = 5000.0f) const;
+	/// \param [in] _ignoreID ID of an object which cannot be hit, e.g. the
+	///		shooter, or 0.
+	/// \param [out] _distance Optional distance along the ray to the hit.
+	SOHandle RayQuery(const Math::WorldRay& _ray, Voxel::Model::ModelData::HitResult& _hit, float _maxRange = 5000.0f,
+		uint32 _ignoreID = 0, float* _distance = nullptr) const;
+
+	/// \brief A single ray of a batch query.
+	struct RayQueryInfo
+	{
+		Math::WorldRay ray;
+		float maxRange;					///< The ray is clamped in this distance
+		uint32 ignoreID;				///< ID of an object which cannot be hit or 0
+		bool stopAtShields;				///< Raised shields of ships block the ray
+	};
+
+	/// \brief Result of a single ray of a batch query.
+	struct RayQueryResult
+	{
+		SOHandle object;				///< The first object hit or nullptr
+		Voxel::Model::ModelData::HitResult hit;
+		float distance;					///< Distance to the hit or the maximum range
+		bool shield;					///< The object was hit at its shield and hit is undefined
+	};
+
+	/// \brief Find the first objects hit by many rays at once.
+	/// \details The rays are binned by the objects whose bounding boxes they
+	///		pass, such that the transformation of each model into its local
+	///		space is computed once for all rays which reach it.
+	///
+	///		The results are the same as from RayQuery() for each single ray
+	///		and do not depend on the number of threads.
+	///
+	///		Rays with stopAtShields are tested against the shield spheres of
+	///		ships first. A ship whose shield is hit is not traversed at all.
+	///		Their search box is inflated by the largest shield radius, such
+	///		that shields are also hit where they reach beyond the box.
+	/// \param [in] _rays Array of _numRays rays.
+	/// \param [out] _results Array with space for _numRays results.
+	/// \param [in] _parallel Distribute groups of rays to the job system.
+	///		This must not be used from inside a job, because the waiting
+	///		thread could pick up another query while holding the lock.
+	void RayQueryBatch(const RayQueryInfo* _rays, int _numRays, RayQueryResult* _results, bool _parallel = false);
 
 	/// \brief Find all objects whose bounding boxes intersect with the given box.
 	/// \param [out] _out Empty container to be filled with the query results.
 	void BoxQuery(const Math::WorldBox _box, Jo::HybridArray<SOHandle, 16>& _out) const;
 
+	/// \brief Find all objects whose bounding boxes intersect a sphere.
+	/// \param [out] _out Container to be filled with the query results in
+	///		ascending id order. It is cleared first.
+	void SphereQuery(const Math::FixVec3& _center, float _radius, std::vector<SOHandle>& _out) const;
+
 	/// \brief Get all objects whose bounding boxes intersect a frustum.
 	/// \param [in] _frustum TODO
-	void FrustumQuery(Jo::HybridArray<SOHandle, 32>& _out) const;
+	/// \param [in] _capability Only objects with this capability are
+	///		returned. Must be a single bit.
+	void FrustumQuery(Jo::HybridArray<SOHandle, 32>& _out, SOCapability _capability = SOCapability::VOXEL_MODEL) const;
+
+	/// \brief Get the dense list of all objects with a capability.
+	/// \details The list is consistent as long as the guard exists. Systems
+	///		should iterate these instead of all objects and type checks.
+	/// \param [in] _capability A single capability bit.
+	Utils::MultiVersionBuffer<SOHandle>::ReadGuard GetObjects(SOCapability _capability) const;
+
+	int NumActiveObjects() const { return m_objects.GetReadAccess().size(); }
 
-	int NumActiveObjects() const { return m_xIntervalMax.GetReadAccess().size(); }
+	/// \brief Compute a hash over the positions, rotations and velocities of
+	///		all models to detect desynchronized simulations.
+	uint64_t ComputeStateHash() const;
 
 	/// \brief Remove destroyed objects and insert the new ones.
 	void UpdateGraph();
 
 	/// \brief Simulate physics and AI and ships...
+	/// \details Sleeping objects are neither integrated nor tested against
+	///		each other. Objects in contact form islands which fall asleep and
+	///		wake up together.
+	///
+	///		Objects with overlapping bounding boxes are grouped into islands
+	///		which are simulated in parallel (narrowphase, impulses, damage and
+	///		integration). Islands do not share objects and process their pairs
+	///		in a fixed order, so the result is independent of the thread count.
+	///
+	///		Objects far from the focus of the level of detail are integrated
+	///		only on the ticks of their sector and collide by bounding spheres.
 	void Simulate(float _deltaTime);
+
+	/// \brief Access the simulation level of detail to set its focus points.
+	SimulationLOD& GetLOD() { return m_lod; }
+
+	/// \brief Hand the transformations of all models over to the renderer.
+	/// \details Called by the simulation thread after each complete step
+	///		(after UpdateGraph()). Each model is stored with its transformation
+	///		before and after the step.
+	/// \param [in] _stepDuration Real time of one step in seconds.
+	void PublishSnapshot(float _stepDuration);
+
+	/// \brief Take the newest snapshot and compute how far the current
+	///		frame is between its two states.
+	/// \details Called by the render thread once per frame. Rendering lags
+	///		at most one step behind the simulation but never reads the
+	///		transformations the simulation is just writing.
+	void BeginRenderFrame();
+
+	/// \brief Interpolated transformation of a model in the current frame.
+	/// \return false if the object was not in the snapshot yet (then _out
+	///		is not changed).
+	bool GetRenderTransformation(const ISceneObject* _object, Math::Transformation& _out) const;
 private:
-	std::vector<SOHandle> m_newObjects;	///< Added since last update
-	Utils::ThreadSafeBuffer<SOHandle> m_xIntervalMax;
+	std::atomic<uint32> m_nextID;				///< ID for the next added object
+	Utils::MultiVersionBuffer<SOHandle> m_objects;	///< All objects sorted by id. New objects are staged by Append().
+	SpatialHash m_spatialHash;					///< Ids of all objects by their bounding boxes
+	mutable std::mutex m_spatialHashMutex;		///< Protects the hash against queries from other threads
+	float m_maxShieldRadius;					///< Largest shield sphere of all ships (UpdateGraph())
+	std::vector<uint32> m_queryIDs;				///< Recycled memory for broadphase queries
+	std::vector<int> m_queryIndices;			///< Recycled memory for broadphase queries
+	Utils::MultiVersionBuffer<SOHandle> m_capabilityLists[NUM_SO_CAPABILITIES];	///< One dense list per capability bit
+
+	/// \brief Indices of two objects in the object list whose bounding boxes overlap.
+	struct CollisionPair
+	{
+		int first;
+		int second;
+	};
+	std::vector<CollisionPair> m_collisionPairs;	///< Broadphase result of the current step
+	std::vector<char> m_pairContact;				///< Per pair: narrowphase found a contact
+
+	/// \brief A group of objects which may interact during one step. The
+	///		members are ranges in m_islandObjects and m_islandPairs.
+	struct Island
+	{
+		int firstObject;
+		int numObjects;
+		int firstPair;
+		int numPairs;
+	};
+	std::vector<Island> m_islands;
+	std::vector<int> m_islandObjects;				///< Object indices sorted by island
+	std::vector<int> m_islandPairs;					///< Pair indices sorted by island
+	std::vector<int> m_islandOfObject;				///< Island index per object or -1
+	std::vector<int> m_cohesionObjects;				///< Indices of models whose cohesion is checked
+	std::vector<std::vector<Voxel::Model*>> m_cohesionResults;	///< Fragments per entry of m_cohesionObjects
+	SimulationLOD m_lod;
+	Mechanics::ComponentScheduler m_componentScheduler;
+	std::vector<Ship*> m_activeShips;				///< Ships which are simulated in the current step
+	std::vector<float> m_shipStepTimes;				///< Step time per entry of m_activeShips
+	std::vector<Mechanics::SensorSystem*> m_scanningSensors;	///< Sensors which scan in the current step
+
+	/// \brief Transformation of a model before and after a step.
+	struct TransformSnapshot
+	{
+		uint32 id;
+		Math::FixVec3 previousPosition;
+		Math::FixVec3 position;
+		ei::Quaternion previousRotation;
+		ei::Quaternion rotation;
+	};
+	struct SceneSnapshot
+	{
+		std::vector<TransformSnapshot> objects;		///< Sorted by id
+		double time = 0.0;							///< Real time when the step finished
+		float stepDuration = 0.0f;
+	};
+	Utils::TripleBuffer<SceneSnapshot> m_snapshots;
+	std::vector<TransformSnapshot> m_lastSnapshot;	///< Copy of the last published objects (simulation thread)
+	float m_renderAlpha;							///< Interpolation factor of the current frame (render thread)
+
+	std::vector<int> m_islandParent;				///< Union-find forest over the object list
+	std::vector<char> m_islandAwake;				///< Per island root: must the island stay awake?
+	std::vector<char> m_islandActive;				///< Per island root: contains a moving object?
+
+	/// \brief Resolve the rays [_first, _first + _num) of a batch query.
+	void RayQueryBatchRange(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects,
+		const RayQueryInfo* _rays, int _first, int _num, RayQueryResult* _results) const;
+	/// \brief Test a ray against the shield sphere of a ship.
+	/// \param [inout] _distance The closest hit so far. Shortened if the
+	///		shield is hit before.
+	static bool RayHitsShield(const Ship& _ship, const Math::WorldRay& _ray, float& _distance);
+
+	/// \brief Collect all pairs of overlapping bounding boxes where at least
+	///		one partner is awake.
+	/// \details Only awake objects search for partners, such that the costs
+	///		of sleeping objects are a single comparison each.
+	void FindCollisionPairs(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects);
+
+	/// \brief Find the representative of the island of an object.
+	int FindIsland(int _object);
+	/// \brief Merge the islands of two objects which are in contact.
+	void UniteIslands(int _object0, int _object1);
+
+	/// \brief Continuous collision detection for fast objects.
+	/// \details Objects which move more than a fraction of their size per
+	///		step are tested with conservative advancement of the bounding
+	///		spheres against all objects in their swept box. The integration
+	///		is clamped to the time of impact and the pairs are added to the
+	///		broadphase result.
+	void SweepFastObjects(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime);
+
+	/// \brief Group all awake objects and their broadphase partners into
+	///		independent islands.
+	void BuildIslands(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects);
+
+	/// \brief Resolve the contacts of one island.
+	void CollideIsland(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, const Island& _island);
+
+	/// \brief Run the component systems of all ships which are integrated
+	///		in this step at once.
+	void RunComponentSystems(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime);
+
+	/// \brief Update the contacts of all sensors which ticked in this step.
+	/// \details Each sensor makes one broadphase query around its ship.
+	///		The spatial hash does not change during Simulate(), so the
+	///		queries run in parallel without the lock.
+	void ScanSensors(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects);
+
+	/// \brief Integrate all objects of one island.
+	void IntegrateIsland(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, const Island& _island, float _deltaTime);
+
+	/// \brief Accumulate resting times and put islands asleep or wake them.
+	void UpdateSleepStates(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime);
+
+	/// \brief Move all awake objects to the cells of their new bounding boxes.
+	void UpdateSpatialHash(const std::vector<SOHandle>& _objects);
+
+	/// \brief Find the indices of all objects in the list whose hash cells
+	///		could intersect a box.
+	/// \details Must be called with m_spatialHashMutex locked or from the
+	///		simulation thread.
+	/// \param [out] _ids Recycled memory for the ids from the hash.
+	/// \param [out] _out Indices into _objects in ascending order.
+	void QueryIndices(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, const Math::FixVec3& _min, const Math::FixVec3& _max,
+		std::vector<uint32>& _ids, std::vector<int>& _out) const;
+
+	/// \brief Remove all objects of the published list which are marked
+	///		for deletion from the spatial hash.
+	/// \param [out] _ids Sorted ids of the removed objects.
+	void UnlinkDeletedObjects(std::vector<uint32>& _ids);
 
-	/// \details Repairs the DRef array (which does not need to be correct before call).
-	///		Also add all new objects.
-	void ResortAxis(Utils::ThreadSafeBuffer<SOHandle>::WriteGuard& _xListAccess);
+	/// \brief Remove deleted and insert new objects (a replayable change of
+	///		the object list).
+	/// \param [in] _deletedIDs Sorted ids of the objects to remove.
+	static void ManageObjects(std::vector<SOHandle>& _objects, const std::vector<SOHandle>& _added, const std::vector<uint32>& _deletedIDs);
 
-	/// \brief Add and remove objects from the queue
-	void ManageObjects(Utils::ThreadSafeBuffer<SOHandle>::WriteGuard& _xListAccess);
+	/// \brief Rebuild the per capability lists from the full object list.
+	void UpdateCapabilityLists(const std::vector<SOHandle>& _objects);
 
 	//SOHandle RayQueryCandidate(const SOHandle& _obj, Voxel::Model::ModelData::HitResult& _hit, float& _maxRange) const;
 
@@ -72,7 +300,9 @@ private:
 	public:
 		CollisionCheck(){};
 
-		void Run(Voxel::Model& _model0, Voxel::Model& _model1);
+		/// \brief Test two models against each other and resolve the collision.
+		/// \return true if the two models are in contact.
+		bool Run(Voxel::Model& _model0, Voxel::Model& _model1);
 	private:
 		//model reference
 		Voxel::Model* m_modelSlf;
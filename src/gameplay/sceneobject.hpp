@@ -2,14 +2,35 @@
 
 #include "utilities/assert.hpp"
 #include "math/box.hpp"
+#include "utilities/flagoperators.hpp"
 #include <atomic>
 
+/// \brief Concrete class of a scene object.
+/// \details Allows to cast without RTTI after a cheap check.
+enum struct SOType: uint8
+{
+	UNKNOWN,
+	MODEL,					///< Voxel::Model
+	SHIP					///< Ship (which is also a Voxel::Model)
+};
+
+/// \brief Properties of scene objects. The scene keeps a dense list of
+///		handles for each single bit.
+enum struct SOCapability: uint8
+{
+	NONE = 0,
+	VOXEL_MODEL = 1,		///< Can be cast to a Voxel::Model and drawn
+	SHIP = 2				///< Can be cast to a Ship
+};
+const int NUM_SO_CAPABILITIES = 2;
+
 /// \brief All objects which should be handled by scene management must inherit
 ///		this interface.
 class ISceneObject
 {
 public:
-	ISceneObject() : m_referenceCounter(0), m_deleteRequest(false) {}
+	ISceneObject() : m_referenceCounter(0), m_deleteRequest(false), m_sleeping(false), m_restingTime(0.0f), m_id(0),
+		m_type(SOType::UNKNOWN), m_capabilities(SOCapability::NONE), m_coarse(false), m_pendingTime(0.0f), m_stepTime(0.0f) {}
 	virtual ~ISceneObject() {Assert(m_referenceCounter == 0, "Wrong reference counting occurred!");}
 
 	/// \brief Remove the object from game
@@ -27,15 +48,58 @@ public:
 
 	/// \brief Do one simulation step, i.e. integrate positions.
 	virtual void Simulate(float _deltaTime) {}
+
+	/// \brief Sleeping objects are skipped in integration, cohesion updates and
+	///		collision pair generation until something wakes them up.
+	bool IsSleeping() const	{ return m_sleeping; }
+
+	/// \brief Reactivate a sleeping object (contact, damage, impulse...).
+	void WakeUp()			{ m_sleeping = false; m_restingTime = 0.0f; }
+
+	/// \brief Is the object slow enough to be put asleep?
+	/// \details Objects which must be simulated each tick (e.g. ships) return
+	///		false always.
+	virtual bool IsResting() const { return false; }
+
+	/// \brief Called once when the scene puts the object asleep.
+	virtual void OnFallAsleep() {}
+
+	/// \brief Unique number in order of insertion into the scene.
+	/// \details Used to break ties such that iteration orders are reproducible.
+	uint32 GetID() const { return m_id; }
+
+	/// \brief Is the object far away from all players and simulated with
+	///		a reduced rate and bounding spheres only? \see SimulationLOD
+	bool IsCoarse() const	{ return m_coarse; }
+
+	/// \brief Time which the object integrates in the current step. This is
+	///		0 if the object is skipped.
+	float GetStepTime() const	{ return m_stepTime; }
+
+	SOType GetType() const						{ return m_type; }
+	SOCapability GetCapabilities() const		{ return m_capabilities; }
+	bool HasCapability(SOCapability _capability) const	{ return (m_capabilities & _capability) != SOCapability::NONE; }
 protected:
 	Math::WorldBox m_boundingBox;
 
+	/// \brief Called by the constructors of derived classes. The type must
+	///		not change after the object was added to the scene.
+	void SetType(SOType _type, SOCapability _capabilities)	{ m_type = _type; m_capabilities = _capabilities; }
+
 private:
 	std::atomic_int_fast32_t m_referenceCounter;		///< Memory management of the scene
 	bool m_deleteRequest;
-	Math::Fix m_minOfAllMin;	// Helper information for axis separating interval queries
+	bool m_sleeping;
+	float m_restingTime;		///< Time in seconds the object is resting without interruption
+	uint32 m_id;
+	SOType m_type;
+	SOCapability m_capabilities;
+	bool m_coarse;
+	float m_pendingTime;		///< Time in seconds which was not integrated yet
+	float m_stepTime;			///< Time in seconds to integrate in the current step
 	friend class SOHandle;
 	friend class SceneGraph;
+	friend class SimulationLOD;
 };
 
 /// \brief Specialized pointer type (shared pointer) for scene objects
@@ -2,13 +2,35 @@
 
 using namespace ei;
 
+const float Ship::LEVER_TOLERANCE = 0.5f;
 
+// ********************************************************************* //
+/// \brief Is this a component which belongs to some system?
+static bool IsFunctional(Voxel::ComponentType _type)
+{
+	return Voxel::TypeInfo::IsComputer(_type)
+		|| Voxel::TypeInfo::IsStorage(_type)
+		|| Voxel::TypeInfo::IsReactor(_type)
+		|| Voxel::TypeInfo::IsBattery(_type)
+		|| Voxel::TypeInfo::IsDrive(_type)
+		|| Voxel::TypeInfo::IsWeapon(_type)
+		|| Voxel::TypeInfo::IsShield(_type)
+		|| Voxel::TypeInfo::IsSensor(_type);
+}
+
+// ********************************************************************* //
 Ship::Ship() :
 	m_computerSystemAllocation(256, false),
 	m_primarySystem(*this, "CentralComputer"),
+	m_energyNetwork(m_primarySystem),
 	m_targetVelocity(0.0f),
-	m_centralComputerPosition(2012, 2012, 2012)
+	m_centralComputerPosition(2012, 2012, 2012),
+	m_systemsProcessed(false),
+	m_parameterCenter(0.0f),
+	m_parametersDirty(true),
+	m_ticks(0)
 {
+	SetType(SOType::SHIP, SOCapability::VOXEL_MODEL | SOCapability::SHIP);
 	Model::Set(m_centralComputerPosition, Voxel::ComponentType::COMPUTER);
 	
 	//default view that allows scrolling
@@ -39,9 +61,8 @@ Ship::~Ship()
 // ********************************************************************* //
 void Ship::AddComponent(const IVec3& _position, const Voxel::Voxel& _component)
 {
+	// The systems are updated by OnVoxelChanged()
 	Model::Set(_position, _component);
-	// Add to systems after insertion
-	//m_primarySystem.OnAdd(_position, _type);
 	// Report the change to each neighbor
 	// TODO: first sample the area, than call OnChange(area)
 }
@@ -51,9 +72,8 @@ void Ship::RemoveComponent(const IVec3& _position)
 {
 	if( all(_position == m_centralComputerPosition) )
 		throw "You cant remove the central computer! This leads to unimplemented handling (conversion to model/game over...)";
-	Voxel::ComponentType type = Model::Get(_position);
+	// The systems are updated by OnVoxelChanged()
 	Model::Set(_position, Voxel::ComponentType::UNDEFINED);
-	//m_primarySystem.OnRemove(_position, type);
 	// Report the change to each neighbor
 	// TODO: first sample the area, than call OnChange(area)
 }
@@ -71,6 +91,8 @@ void Ship::Save( Jo::Files::IFile& _file ) const
 // ********************************************************************* //
 void Ship::Load( const Jo::Files::IFile& _file )
 {
+	// Everything is rebuilt afterwards, no need to handle single voxels
+	m_parametersDirty = true;
 	Model::Load(_file);
 	// Load ship state
 	_file.Read(sizeof(float), &m_targetVelocity);
@@ -82,27 +104,40 @@ void Ship::Load( const Jo::Files::IFile& _file )
 // ********************************************************************* //
 void Ship::Simulate(float _deltaTime)
 {
-	Mechanics::SystemRequierements requirements;
-	// Get movement directions in object space
-	Vec3 deltaAngularVelMod = m_targetAngularVelocity - GetInverseRotationMatrix() * Model::m_angularVelocity;
-	Vec3 deltaVelMod = m_targetVelocity - GetInverseRotationMatrix() * Model::m_velocity;
-	// Estimate the required forces to reach the target velocities
-	requirements.torque = m_inertiaTensor * (deltaAngularVelMod / _deltaTime);
-	requirements.thrust = (m_mass / _deltaTime) * deltaVelMod;
-	requirements.cursorDirection = m_pointingDirection;
-
 	// Do energy management
-	m_primarySystem.Estimate(_deltaTime, requirements);
-	m_primarySystem.Process(_deltaTime, requirements);
+	if( !m_systemsProcessed )
+	{
+		PrepareSystems(_deltaTime);
+		m_energyNetwork.Estimate(_deltaTime, m_requirements);
+		m_energyNetwork.Solve();
+		m_energyNetwork.Process(_deltaTime, m_requirements);
+	}
+	m_systemsProcessed = false;
 
 	// Accelerate dependent on available torque and force.
-	AddAngularVelocity( GetRotationMatrix() * (_deltaTime * (m_inertiaTensorInverse * requirements.torque)) );
-	AddVelocity( GetRotationMatrix() * ((_deltaTime / m_mass) * requirements.thrust) );
+	AddAngularVelocity( GetRotationMatrix() * (_deltaTime * (m_inertiaTensorInverse * m_requirements.torque)) );
+	AddVelocity( GetRotationMatrix() * ((_deltaTime / m_mass) * m_requirements.thrust) );
 
 	// Also simulate the physics
 	Model::Simulate(_deltaTime);
 }
 
+// ********************************************************************* //
+void Ship::PrepareSystems(float _deltaTime)
+{
+	++m_ticks;
+	if( m_parametersDirty )
+		ComputeParameters();
+
+	// Get movement directions in object space
+	Vec3 deltaAngularVelMod = m_targetAngularVelocity - GetInverseRotationMatrix() * Model::m_angularVelocity;
+	Vec3 deltaVelMod = m_targetVelocity - GetInverseRotationMatrix() * Model::m_velocity;
+	// Estimate the required forces to reach the target velocities
+	m_requirements.torque = m_inertiaTensor * (deltaAngularVelMod / _deltaTime);
+	m_requirements.thrust = (m_mass / _deltaTime) * deltaVelMod;
+	m_requirements.cursorDirection = m_pointingDirection;
+}
+
 // ********************************************************************* //
 unsigned Ship::AllocNewSystemID()
 {
@@ -129,15 +164,19 @@ const Vec3& Ship::GetNextView()
 void Ship::ComputeParameters()
 {
 	ComputeInertia();
+	m_occupancy.Build(m_voxelTree);
 	// Delete the old state.
-	m_primarySystem.ClearSystem();
+	m_energyNetwork.Invalidate();
+	m_energyNetwork.ClearSystems();
 	m_views.resize(1); // keep only the default centered view
 	m_currentView = 0;
+	m_parameterCenter = GetCenter();
+	m_parametersDirty = false;
 	// Iterate over the tree, compute values for each element and reassign to systems.
 	struct UpdateProcessor: public Model::ModelData::SVOProcessor
 	{
-		UpdateProcessor(Mechanics::ComputerSystem& _system, Ship& _ship) :
-			m_system(_system),
+		UpdateProcessor(Mechanics::EnergyNetwork& _network, Ship& _ship) :
+			m_network(_network),
 			m_ship(_ship)
 		{
 		}
@@ -147,25 +186,84 @@ void Ship::ComputeParameters()
 			if( !_node->Children() )
 			{
 				// This is a component. Add it, if it is a functional unit.
-				if(Voxel::TypeInfo::IsComputer(_node->Data().type)
-					|| Voxel::TypeInfo::IsStorage(_node->Data().type)
-					|| Voxel::TypeInfo::IsReactor(_node->Data().type)
-					|| Voxel::TypeInfo::IsBattery(_node->Data().type)
-					|| Voxel::TypeInfo::IsDrive(_node->Data().type)
-					|| Voxel::TypeInfo::IsWeapon(_node->Data().type)
-					|| Voxel::TypeInfo::IsShield(_node->Data().type)
-					|| Voxel::TypeInfo::IsSensor(_node->Data().type))
-					m_system.OnAdd(IVec3(_position), _node->Data().type, _node->Data().sysAssignment);
+				if(IsFunctional(_node->Data().type))
+				{
+					Mechanics::ComputerSystem* computer = m_network.Find(_node->Data().sysAssignment);
+					if(computer) computer->OnAdd(IVec3(_position), _node->Data().type, _node->Data().sysAssignment);
+				}
 				else if (_node->Data().type == Voxel::ComponentType::CAMERA)
 					m_ship.AddView(IVec3(_position));
 			}
 			return true;
 		}
 	private:
-		Mechanics::ComputerSystem& m_system;
+		Mechanics::EnergyNetwork& m_network;
 		Ship& m_ship;
 	};
 
-	UpdateProcessor proc(m_primarySystem, *this);
+	UpdateProcessor proc(m_energyNetwork, *this);
 	m_voxelTree.Traverse( proc );
-}
\ No newline at end of file
+}
+
+// ********************************************************************* //
+void Ship::UpdateParameters()
+{
+	if( m_parametersDirty )
+		ComputeParameters();
+	else
+		ComputeInertia();
+}
+
+// ********************************************************************* //
+void Ship::OnVoxelChanged( const IVec4& _position, const Voxel::Voxel& _oldVoxel, const Voxel::Voxel& _newVoxel )
+{
+	ApplyComponentChange( _position, _oldVoxel, _newVoxel );
+	CheckLevers();
+}
+
+// ********************************************************************* //
+void Ship::OnVoxelsChanged( const std::vector<VoxelChange>& _changes )
+{
+	for( auto& change : _changes )
+		ApplyComponentChange( change.position, change.oldVoxel, change.newVoxel );
+	CheckLevers();
+}
+
+// ********************************************************************* //
+void Ship::ApplyComponentChange( const IVec4& _position, const Voxel::Voxel& _oldVoxel, const Voxel::Voxel& _newVoxel )
+{
+	// Components are leaves on level 0. A pending rebuild covers everything.
+	if( _position[3] != 0 || m_parametersDirty )
+		return;
+
+	IVec3 position(_position);
+	bool occupancyChanged = m_occupancy.Set(position, _newVoxel.type != Voxel::ComponentType::UNDEFINED);
+	// Damage changes voxels without changing their function
+	if( _oldVoxel.type == _newVoxel.type && _oldVoxel.sysAssignment == _newVoxel.sysAssignment )
+		return;
+
+	// The id table replaces a search through the computer hierarchy
+	Mechanics::ComputerSystem* oldComputer = m_energyNetwork.Find(_oldVoxel.sysAssignment);
+	Mechanics::ComputerSystem* newComputer = m_energyNetwork.Find(_newVoxel.sysAssignment);
+	if( IsFunctional(_oldVoxel.type) && oldComputer )
+		oldComputer->OnRemove(position, _oldVoxel.type, _oldVoxel.sysAssignment);
+	else if( _oldVoxel.type == Voxel::ComponentType::CAMERA )
+		m_parametersDirty = true;	// Views have no identity to remove them
+	// Update the surrounding of other components before the new one
+	// computes its own.
+	if( occupancyChanged )
+		m_energyNetwork.OnChange(position);
+	if( IsFunctional(_newVoxel.type) && newComputer )
+		newComputer->OnAdd(position, _newVoxel.type, _newVoxel.sysAssignment);
+	else if( _newVoxel.type == Voxel::ComponentType::CAMERA )
+		AddView(position);
+}
+
+// ********************************************************************* //
+void Ship::CheckLevers()
+{
+	// Torques of the thrusters depend on the center of mass. Small shifts
+	// are tolerated, larger ones require new levers.
+	if( lensq(GetCenter() - m_parameterCenter) > LEVER_TOLERANCE * LEVER_TOLERANCE )
+		m_parametersDirty = true;
+}
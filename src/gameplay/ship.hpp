@@ -2,7 +2,9 @@
 
 #include "predeclarations.hpp"
 #include "voxel/model.hpp"
+#include "voxel/occupancygrid.hpp"
 #include "componentsystems/computersystem.hpp"
+#include "componentsystems/energynetwork.hpp"
 
 /// \brief A ship is a model with additional simulation and control options.
 /// \details A standard ship design contains a single computer with one
@@ -53,12 +55,32 @@ public:
 	const ei::IVec3& GetCentralComputerPosition() const { return m_centralComputerPosition; }
 
 	/// \brief Simulate ship logic
+	/// \details Runs the systems itself if no ComponentScheduler did it for
+	///		this step.
 	virtual void Simulate(float _deltaTime) override;
 
+	/// \brief Compute the forces which are required to reach the target
+	///		velocities before the systems are estimated.
+	void PrepareSystems(float _deltaTime);
+
+	/// \brief Step counter of the systems including a per ship offset.
+	/// \details Systems with a tick interval run if this is a multiple of
+	///		the interval. The offset spreads the work of many ships over the
+	///		steps instead of running all of them in the same one. It is the
+	///		scene object id, so replays get the same phases.
+	uint32 GetTick() const { return m_ticks + GetID(); }
+
+	/// \brief Ships run their systems each tick and never fall asleep.
+	virtual bool IsResting() const override { return false; }
+
 	unsigned AllocNewSystemID();
 	void ReleaseSystemID( unsigned _id );
 
 	Mechanics::ComputerSystem& GetPrimarySystem() { return m_primarySystem; }
+	const Mechanics::ComputerSystem& GetPrimarySystem() const { return m_primarySystem; }
+
+	/// \brief Solid voxels of the ship for fast visibility tests of components.
+	const Voxel::OccupancyGrid& GetOccupancy() const { return m_occupancy; }
 
 	/// \brief Returns the local offset of the next available view.
 	const ei::Vec3& GetNextView();
@@ -69,23 +91,46 @@ public:
 
 	/// \brief Compute complex informations if the underlying model changed
 	void ComputeParameters();
+
+	/// \brief Update the inertia after components changed. The systems are
+	///		already updated incrementally, they are only rebuilt if a change
+	///		could not be handled locally.
+	void UpdateParameters();
 protected:
 	void AddView(const ei::IVec3& _pos) { m_views.push_back(_pos + ei::Vec3(0.5f,0.6f,0.56f) - GetCenter()); }
 
+	/// \brief Add or remove single components to the systems.
+	virtual void OnVoxelChanged( const ei::IVec4& _position, const Voxel::Voxel& _oldVoxel, const Voxel::Voxel& _newVoxel ) override;
+	/// \brief Add or remove the components of a batched edit. The levers
+	///		are checked once for all of them.
+	virtual void OnVoxelsChanged( const std::vector<VoxelChange>& _changes ) override;
+	/// \brief Update the systems for one changed voxel (shared part of
+	///		OnVoxelChanged() and OnVoxelsChanged()).
+	void ApplyComponentChange( const ei::IVec4& _position, const Voxel::Voxel& _oldVoxel, const Voxel::Voxel& _newVoxel );
+	/// \brief Mark the parameters dirty if the center of mass moved too far.
+	void CheckLevers();
+
+	/// \brief Maximum distance in meters the center of mass may move before
+	///		the levers of all thrusters are recomputed.
+	static const float LEVER_TOLERANCE;
+
 	std::vector<bool> m_computerSystemAllocation;	///< One ship can have up to 256 computer systems. The primary system is 0. true means the system id is used.
 	Mechanics::ComputerSystem m_primarySystem;
+	Mechanics::EnergyNetwork m_energyNetwork;	///< All computers, recompiled when the systems are rebuilt
+	Voxel::OccupancyGrid m_occupancy;
 	ei::IVec3 m_centralComputerPosition;
 	std::vector<ei::Vec3> m_views; ///< Cameras or cockpits of this ship.
 	int m_currentView; 
-	/*int m_ticks;		///< Simulation counter which reduces the number of specific simulation steps. Is reset to 0 when it reaches WEAPON_TICKS * THRUSTER_TICKS * ....
-	// individual systems every n ticks. This list defines the number of frames
-	// between each simulation call. One means every frame.
-	const int WEAPON_TICKS = 3;
-	const int DRIVE_TICKS = 1;
-	const int COMPUTER_TICKS = 2;*/
+	Mechanics::SystemRequierements m_requirements;	///< Demand and result of the systems in the current step
+	bool m_systemsProcessed;		///< The systems already ran for the next Simulate()
+	ei::Vec3 m_parameterCenter;		///< Center of mass when the systems were built last
+	bool m_parametersDirty;			///< The systems must be rebuilt by ComputeParameters()
+	uint32 m_ticks;					///< Number of system steps so far
 
 	// Controllable state
 	ei::Vec3 m_targetAngularVelocity;		///< Model space angular velocity
 	ei::Vec3 m_targetVelocity;			///< Model space velocity
 	ei::Vec3 m_pointingDirection;			///< world space pointing direction
+
+	friend class Mechanics::ComponentScheduler;
 };
\ No newline at end of file
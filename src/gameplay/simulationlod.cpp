@@ -0,0 +1,83 @@
+#include "simulationlod.hpp"
+#include "spatialhash.hpp"
+#include <cstdlib>
+
+using namespace ei;
+using namespace Math;
+
+const int SimulationLOD::LOG_SECTOR_SIZE = SpatialHash::LOG_CELL_SIZE[1];
+
+// ************************************************************************* //
+SimulationLOD::SimulationLOD() :
+	m_tick(0),
+	m_numCoarse(0)
+{
+}
+
+// ************************************************************************* //
+void SimulationLOD::SetFocus(const FixVec3* _points, int _numPoints)
+{
+	m_focusSectors.clear();
+	for( int i = 0; i < _numPoints; ++i )
+		m_focusSectors.push_back(GetSector(_points[i]));
+}
+
+// ************************************************************************* //
+void SimulationLOD::Update(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime)
+{
+	++m_tick;
+	m_numCoarse = 0;
+	for( int i = 0; i < _objects.size(); ++i )
+	{
+		ISceneObject& obj = *_objects[i];
+		FixVec3 center = obj.GetBoundingBoxMin() + FixVec3(Vec3(obj.GetBoundingBoxMax() - obj.GetBoundingBoxMin()) * 0.5f);
+		SectorKey sector = GetSector(center);
+		obj.m_coarse = !m_focusSectors.empty() && !IsNear(sector);
+		if( obj.m_coarse ) ++m_numCoarse;
+
+		// Sleeping objects do not accumulate any time
+		if( obj.IsSleeping() )
+		{
+			obj.m_pendingTime = 0.0f;
+			obj.m_stepTime = 0.0f;
+			continue;
+		}
+
+		obj.m_pendingTime += _deltaTime;
+		if( !obj.m_coarse || GetPhase(sector) == m_tick % COARSE_INTERVAL )
+		{
+			obj.m_stepTime = obj.m_pendingTime;
+			obj.m_pendingTime = 0.0f;
+		} else
+			obj.m_stepTime = 0.0f;
+	}
+}
+
+// ************************************************************************* //
+SimulationLOD::SectorKey SimulationLOD::GetSector(const FixVec3& _position)
+{
+	SectorKey sector = {_position[0].Floor(LOG_SECTOR_SIZE), _position[1].Floor(LOG_SECTOR_SIZE), _position[2].Floor(LOG_SECTOR_SIZE)};
+	return sector;
+}
+
+// ************************************************************************* //
+bool SimulationLOD::IsNear(const SectorKey& _sector) const
+{
+	for( auto& focus : m_focusSectors )
+	{
+		if( std::abs(focus.x - _sector.x) <= 1
+			&& std::abs(focus.y - _sector.y) <= 1
+			&& std::abs(focus.z - _sector.z) <= 1 )
+			return true;
+	}
+	return false;
+}
+
+// ************************************************************************* //
+uint32 SimulationLOD::GetPhase(const SectorKey& _sector)
+{
+	uint64_t hash = uint64_t(_sector.x) * 0x9e3779b97f4a7c15ull
+		^ uint64_t(_sector.y) * 0xc2b2ae3d27d4eb4full
+		^ uint64_t(_sector.z) * 0x165667b19e3779f9ull;
+	return uint32(hash >> 32) % COARSE_INTERVAL;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "math/fixedpoint.hpp"
+#include "sceneobject.hpp"
+#include "utilities/multiversionbuffer.hpp"
+#include <vector>
+
+/// \brief Level of detail for the simulation of objects far away from all
+///		players.
+/// \details Space is divided into sectors (the system cells of the
+///		SpatialHash). Objects in or next to a sector with a focus point are
+///		simulated each step. All others are coarse: their sector ticks only
+///		every COARSE_INTERVAL steps with the accumulated time, they collide
+///		by bounding spheres only and skip cohesion checks. Pairs are tested
+///		whenever one of both objects ticks, the other one in its last
+///		integrated state, so objects in sectors of different phases meet.
+///
+///		The level of detail only decides when time is integrated and never
+///		touches velocities, so momentum and energy are conserved on
+///		transitions. An object which becomes near integrates all its
+///		pending time at once.
+class SimulationLOD
+{
+public:
+	/// \brief Number of steps between two ticks of a coarse sector.
+	static const int COARSE_INTERVAL = 8;
+	/// \brief Logarithmic edge length of a sector in meters.
+	static const int LOG_SECTOR_SIZE;
+
+	SimulationLOD();
+
+	/// \brief Set the positions around which the full simulation runs.
+	/// \details Without any focus point all objects are simulated fully.
+	void SetFocus(const Math::FixVec3* _points, int _numPoints);
+
+	/// \brief Classify all objects and decide how much time each one
+	///		integrates in this step.
+	/// \details Called once at the beginning of each simulation step.
+	void Update(const Utils::MultiVersionBuffer<SOHandle>::ReadGuard& _objects, float _deltaTime);
+
+	/// \brief Number of coarse objects in the last Update().
+	int NumCoarse() const { return m_numCoarse; }
+private:
+	struct SectorKey
+	{
+		int64_t x, y, z;
+	};
+	std::vector<SectorKey> m_focusSectors;
+	uint32 m_tick;
+	int m_numCoarse;
+
+	static SectorKey GetSector(const Math::FixVec3& _position);
+
+	/// \brief Is the sector or one of its neighbors a focus sector?
+	bool IsNear(const SectorKey& _sector) const;
+
+	/// \brief In which of the COARSE_INTERVAL steps does a coarse sector tick?
+	/// \details Different sectors are spread over all steps.
+	static uint32 GetPhase(const SectorKey& _sector);
+};
@@ -0,0 +1,176 @@
+#include "spatialhash.hpp"
+#include "utilities/assert.hpp"
+#include <algorithm>
+
+using namespace ei;
+using namespace Math;
+
+// Sectors of ~16000 km, systems of ~65 km and local cells of 256 m
+const int SpatialHash::LOG_CELL_SIZE[NUM_LEVELS] = {24, 16, 8};
+
+// Parent cell of a cell on the next finer level
+static int64_t ParentCoord(int64_t _coord, int _level)
+{
+	return _coord >> (SpatialHash::LOG_CELL_SIZE[_level-1] - SpatialHash::LOG_CELL_SIZE[_level]);
+}
+
+// ************************************************************************* //
+void SpatialHash::Update(uint32 _id, const FixVec3& _min, const FixVec3& _max)
+{
+	Location location = Locate(_min, _max);
+	auto it = m_locations.find(_id);
+	if( it != m_locations.end() )
+	{
+		// Fast path: still in the same cell
+		if( it->second.level == location.level && it->second.cell == location.cell )
+			return;
+		Erase(_id, it->second);
+		it->second = location;
+	} else
+		m_locations.emplace(_id, location);
+	Insert(_id, location);
+}
+
+// ************************************************************************* //
+void SpatialHash::Remove(uint32 _id)
+{
+	auto it = m_locations.find(_id);
+	if( it == m_locations.end() ) return;
+	Erase(_id, it->second);
+	m_locations.erase(it);
+}
+
+// ************************************************************************* //
+void SpatialHash::Query(const FixVec3& _min, const FixVec3& _max, std::vector<uint32>& _out) const
+{
+	_out.insert(_out.end(), m_hugeObjects.begin(), m_hugeObjects.end());
+	if( m_cells[0].empty() ) return;
+
+	// Objects are stored by their minimum, which can be up to one cell
+	// before the query box.
+	CellKey lo[NUM_LEVELS], hi[NUM_LEVELS];
+	for( int l = 0; l < NUM_LEVELS; ++l )
+	{
+		lo[l].x = _min[0].Floor(LOG_CELL_SIZE[l]) - 1;
+		lo[l].y = _min[1].Floor(LOG_CELL_SIZE[l]) - 1;
+		lo[l].z = _min[2].Floor(LOG_CELL_SIZE[l]) - 1;
+		hi[l].x = _max[0].Floor(LOG_CELL_SIZE[l]);
+		hi[l].y = _max[1].Floor(LOG_CELL_SIZE[l]);
+		hi[l].z = _max[2].Floor(LOG_CELL_SIZE[l]);
+	}
+
+	// Either look up each sector in range or test each occupied sector,
+	// whatever is less.
+	double numInRange = double(hi[0].x - lo[0].x + 1) * double(hi[0].y - lo[0].y + 1) * double(hi[0].z - lo[0].z + 1);
+	if( numInRange < double(m_cells[0].size()) )
+	{
+		CellKey key;
+		for( key.z = lo[0].z; key.z <= hi[0].z; ++key.z )
+			for( key.y = lo[0].y; key.y <= hi[0].y; ++key.y )
+				for( key.x = lo[0].x; key.x <= hi[0].x; ++key.x )
+				{
+					auto it = m_cells[0].find(key);
+					if( it != m_cells[0].end() )
+						QueryCell(0, it->second, lo, hi, _out);
+				}
+	} else {
+		for( auto& it : m_cells[0] )
+		{
+			const CellKey& key = it.first;
+			if( key.x >= lo[0].x && key.x <= hi[0].x
+				&& key.y >= lo[0].y && key.y <= hi[0].y
+				&& key.z >= lo[0].z && key.z <= hi[0].z )
+				QueryCell(0, it.second, lo, hi, _out);
+		}
+	}
+}
+
+// ************************************************************************* //
+void SpatialHash::QueryCell(int _level, const Cell& _cell, const CellKey* _lo, const CellKey* _hi, std::vector<uint32>& _out) const
+{
+	_out.insert(_out.end(), _cell.objects.begin(), _cell.objects.end());
+
+	int childLevel = _level + 1;
+	for( auto& key : _cell.children )
+	{
+		if( key.x >= _lo[childLevel].x && key.x <= _hi[childLevel].x
+			&& key.y >= _lo[childLevel].y && key.y <= _hi[childLevel].y
+			&& key.z >= _lo[childLevel].z && key.z <= _hi[childLevel].z )
+			QueryCell(childLevel, m_cells[childLevel].at(key), _lo, _hi, _out);
+	}
+}
+
+// ************************************************************************* //
+SpatialHash::Location SpatialHash::Locate(const FixVec3& _min, const FixVec3& _max)
+{
+	double extent = max(max(double(_max[0] - _min[0]), double(_max[1] - _min[1])), double(_max[2] - _min[2]));
+	Location location;
+	location.level = NUM_LEVELS;
+	// Finest level whose cells are large enough
+	for( int l = NUM_LEVELS - 1; l >= 0; --l )
+		if( extent <= double(int64_t(1) << LOG_CELL_SIZE[l]) )
+		{
+			location.level = l;
+			break;
+		}
+
+	if( location.level < NUM_LEVELS )
+	{
+		location.cell.x = _min[0].Floor(LOG_CELL_SIZE[location.level]);
+		location.cell.y = _min[1].Floor(LOG_CELL_SIZE[location.level]);
+		location.cell.z = _min[2].Floor(LOG_CELL_SIZE[location.level]);
+	} else location.cell.x = location.cell.y = location.cell.z = 0;
+	return location;
+}
+
+// ************************************************************************* //
+void SpatialHash::Insert(uint32 _id, const Location& _location)
+{
+	if( _location.level == NUM_LEVELS )
+		m_hugeObjects.push_back(_id);
+	else
+		AcquireCell(_location.level, _location.cell).objects.push_back(_id);
+}
+
+// ************************************************************************* //
+void SpatialHash::Erase(uint32 _id, const Location& _location)
+{
+	std::vector<uint32>& objects = _location.level == NUM_LEVELS ? m_hugeObjects : m_cells[_location.level].at(_location.cell).objects;
+	auto it = std::find(objects.begin(), objects.end(), _id);
+	Assert(it != objects.end(), "Object is not in the cell of its location.");
+	*it = objects.back();
+	objects.pop_back();
+
+	if( _location.level < NUM_LEVELS )
+		ReleaseCell(_location.level, _location.cell);
+}
+
+// ************************************************************************* //
+SpatialHash::Cell& SpatialHash::AcquireCell(int _level, const CellKey& _cell)
+{
+	auto result = m_cells[_level].emplace(_cell, Cell());
+	if( result.second && _level > 0 )
+	{
+		CellKey parent = {ParentCoord(_cell.x, _level), ParentCoord(_cell.y, _level), ParentCoord(_cell.z, _level)};
+		AcquireCell(_level - 1, parent).children.push_back(_cell);
+	}
+	return result.first->second;
+}
+
+// ************************************************************************* //
+void SpatialHash::ReleaseCell(int _level, const CellKey& _cell)
+{
+	auto it = m_cells[_level].find(_cell);
+	if( !it->second.objects.empty() || !it->second.children.empty() )
+		return;
+	m_cells[_level].erase(it);
+
+	if( _level > 0 )
+	{
+		CellKey parent = {ParentCoord(_cell.x, _level), ParentCoord(_cell.y, _level), ParentCoord(_cell.z, _level)};
+		std::vector<CellKey>& siblings = m_cells[_level - 1].at(parent).children;
+		*std::find(siblings.begin(), siblings.end(), _cell) = siblings.back();
+		siblings.pop_back();
+		ReleaseCell(_level - 1, parent);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "math/fixedpoint.hpp"
+#include <unordered_map>
+#include <vector>
+
+/// \brief A hierarchical spatial hash for objects at galaxy scale positions.
+/// \details There are three levels of loose grid cells: sectors, systems and
+///		a local grid. Each object is stored in exactly one cell: the cell of
+///		the finest level whose edge length is at least the extent of the
+///		object and which contains the minimum corner of its bounding box.
+///		Objects larger than a sector are kept in an extra list which is part
+///		of every query.
+///
+///		Cells know their occupied child cells, so queries only descend into
+///		sectors and systems which contain something. Objects which move
+///		within their cell do not change the structure at all.
+class SpatialHash
+{
+public:
+	static const int NUM_LEVELS = 3;
+	/// \brief Logarithmic edge lengths of sectors, systems and local cells in meters.
+	static const int LOG_CELL_SIZE[NUM_LEVELS];
+
+	/// \brief Add an object or move it to the cell of its new bounding box.
+	void Update(uint32 _id, const Math::FixVec3& _min, const Math::FixVec3& _max);
+
+	/// \brief Remove an object. Unknown ids are ignored.
+	void Remove(uint32 _id);
+
+	/// \brief Find all objects whose cells could intersect a box.
+	/// \details The result is a superset which must be tested against the
+	///		real bounding boxes. Each id is returned once in an unspecified
+	///		order.
+	/// \param [out] _out The ids are appended.
+	void Query(const Math::FixVec3& _min, const Math::FixVec3& _max, std::vector<uint32>& _out) const;
+
+	int NumObjects() const { return (int)m_locations.size(); }
+	int NumCells(int _level) const { return (int)m_cells[_level].size(); }
+private:
+	struct CellKey
+	{
+		int64_t x, y, z;
+		bool operator == (const CellKey& _other) const { return x == _other.x && y == _other.y && z == _other.z; }
+	};
+	struct CellKeyHash
+	{
+		size_t operator () (const CellKey& _key) const
+		{
+			uint64_t hash = uint64_t(_key.x) * 0x9e3779b97f4a7c15ull;
+			hash ^= uint64_t(_key.y) * 0xc2b2ae3d27d4eb4full + (hash >> 29);
+			hash ^= uint64_t(_key.z) * 0x165667b19e3779f9ull + (hash >> 32);
+			return (size_t)hash;
+		}
+	};
+
+	struct Cell
+	{
+		std::vector<uint32> objects;
+		std::vector<CellKey> children;	///< Occupied cells of the next finer level
+	};
+
+	/// \brief Where an object is stored. Level NUM_LEVELS is the list of
+	///		objects larger than a sector.
+	struct Location
+	{
+		int level;
+		CellKey cell;
+	};
+
+	std::unordered_map<CellKey, Cell, CellKeyHash> m_cells[NUM_LEVELS];
+	std::unordered_map<uint32, Location> m_locations;
+	std::vector<uint32> m_hugeObjects;
+
+	/// \brief Find the level and cell of a bounding box.
+	static Location Locate(const Math::FixVec3& _min, const Math::FixVec3& _max);
+
+	void Insert(uint32 _id, const Location& _location);
+	void Erase(uint32 _id, const Location& _location);
+
+	/// \brief Create a cell and register it in its (created) parents.
+	Cell& AcquireCell(int _level, const CellKey& _cell);
+	/// \brief Delete an empty cell and its parents if they become empty.
+	void ReleaseCell(int _level, const CellKey& _cell);
+
+	/// \brief Add the objects of a cell and recurse into the children
+	///		which are inside the query range.
+	void QueryCell(int _level, const Cell& _cell, const CellKey* _lo, const CellKey* _hi, std::vector<uint32>& _out) const;
+};
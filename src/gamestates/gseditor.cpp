@@ -293,7 +293,7 @@ void GSEditor::KeyClick( int _key )
 			// Add a voxel of the chosen type
 			m_ship->AddComponent( m_lvl0Position, m_currentComponent );
 		}
-		m_ship->ComputeParameters();
+		m_ship->UpdateParameters();
 		m_recreateThrustVis = true;
 
 		UpdateModelInformation();
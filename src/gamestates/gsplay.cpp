@@ -13,6 +13,7 @@
 #include "utilities/stringutils.hpp"
 #include "math/fixedpoint.hpp"
 #include "math/ray.hpp"
+#include "utilities/scriptruntime.hpp"
 #include "graphic/highlevel/particlesystem.hpp"
 #include <ei/vector.hpp>
 
@@ -40,7 +41,10 @@ Voxel::Model* splitTest;
 // ************************************************************************* //
 GSPlay::GSPlay(Monolith* _game) 
 	: IGameState(_game),
-	m_fireManager(m_scene)
+	m_fireManager(m_scene),
+	m_fleetTimer(0),
+	m_fleetTime(0.0),
+	m_numFleetSteps(0)
 {
 	LOG_LVL2("Starting to create game state Play");
 
@@ -82,17 +86,21 @@ void GSPlay::OnBegin()
 {
 	if( m_scene.NumActiveObjects() == 0 )
 	{
+		SetupLockstep();
+
 		collTest01 = new Voxel::Model();
 		collTest02 = new Voxel::Model();
 
 
 		//test case 1: linear movement into rotation
 
-		collTest01->Load(Jo::Files::HDDFile("savegames/collision01.vmo"));
+		// Both share the voxels until they are damaged
+		auto collisionModel = Voxel::Model::LoadShared("savegames/collision01.vmo");
+		collTest01->InstanceOf(collisionModel);
 		collTest01->SetPosition(FixVec3(Fix(20.0), Fix(0.0), Fix(0.0)));//
 		collTest01->Rotate(0.f, 0.5f*PI, 0.0f*PI);
 		collTest01->AddVelocity(Vec3(0.f, 2.f, 0.f));
-		collTest02->Load(Jo::Files::HDDFile("savegames/collision01.vmo"));
+		collTest02->InstanceOf(collisionModel);
 		collTest02->Rotate(0.25f*PI, 0.0f*PI, 1.0f*PI);
 		
 		//test case 2: rotation into rotation
@@ -137,6 +145,8 @@ void GSPlay::OnBegin()
 		m_player->Possess(shipHandle);
 	//	playerModel->SetRotation(aiTestShip->GetRotation());
 
+		SpawnTestFleets();
+
 		m_hud->m_mainMessageBox->DisplayMsg("Welcome to the Monolith \ntest-universe. ", 3.f);
 	/*	for( int i = 0; i < 25; ++i )
 		{
@@ -162,16 +172,102 @@ void GSPlay::OnBegin()
 // ************************************************************************* //
 void GSPlay::OnEnd()
 {
+	if( m_numFleetSteps )
+	{
+		int numShips = 0;
+		for( auto& fleet : m_fleets )
+			numShips += fleet->NumShips();
+		double stepTime = m_fleetTime / m_numFleetSteps;
+		LOG_LVL1("Fleets: " + std::to_string(numShips) + " ships in " + std::to_string((int)m_fleets.size())
+			+ " fleets, " + std::to_string(stepTime * 1000.0) + " ms per step, "
+			+ std::to_string(stepTime * 1e6 / ei::max(1, numShips)) + " us per ship");
+	}
+
+	if( m_inputLog.GetMode() == Replay::InputLog::Mode::RECORD )
+	{
+		std::string fileName = m_game->Config[std::string("Game")][std::string("RecordInput")];
+		try {
+			Jo::Files::HDDFile file(fileName, Jo::Files::HDDFile::OVERWRITE);
+			m_inputLog.Save(file);
+		} catch(const std::string& _message) {
+			LOG_ERROR("Failed to write the input log with message:\n" + _message);
+		}
+	}
+
 	LOG_LVL2("Left game state Play");
 }
 
+// ************************************************************************* //
+void GSPlay::SetupLockstep()
+{
+	auto& cgame = m_game->Config[std::string("Game")];
+	Jo::Files::MetaFileWrapper::Node* replayFile;
+	if( cgame.HasChild(std::string("ReplayInput"), &replayFile) && !std::string(*replayFile).empty() )
+	{
+		try {
+			m_inputLog.StartReplay(Jo::Files::HDDFile(*replayFile));
+		} catch(const std::string& _message) {
+			LOG_ERROR("Failed to load the input log with message:\n" + _message);
+		}
+	}
+
+	if( m_inputLog.GetMode() == Replay::InputLog::Mode::OFF
+		&& cgame[std::string("Deterministic")].Get(false)
+		&& cgame.HasChild(std::string("RecordInput")) )
+		m_inputLog.StartRecording(cgame[std::string("Seed")].Get(0u));
+
+	bool lockstep = m_inputLog.GetMode() != Replay::InputLog::Mode::OFF;
+	m_player->SetInputLog(lockstep ? &m_inputLog : nullptr);
+	// Script budgets depend on the wall-clock time
+	Script::Runtime::SetDeterministic(lockstep);
+}
+
+// ************************************************************************* //
+void GSPlay::SpawnTestFleets()
+{
+	auto& cfleets = m_game->Config[std::string("Game")][std::string("TestFleets")];
+	int numFleets = cfleets[std::string("Count")].Get(0);
+	int fleetSize = cfleets[std::string("Size")].Get(8);
+	const float SPAWN_RADIUS = 400.0f;
+	for( int f = 0; f < numFleets; ++f )
+	{
+		// Start on a circle around the player and fly to the opposite side
+		float angle = 2.0f * PI * f / numFleets;
+		Vec3 start(SPAWN_RADIUS * cos(angle), 0.0f, SPAWN_RADIUS * sin(angle));
+		std::unique_ptr<FleetController> fleet(new FleetController(m_scene));
+		for( int i = 0; i < fleetSize; ++i )
+		{
+			Ship* ship = new Ship();
+			ship->Load(Jo::Files::HDDFile("savegames/playership.vmo"));
+			ship->SetPosition(FixVec3(start + Vec3(float(i % 4) * 20.0f, float(i / 4) * 20.0f, float(f) * 5.0f)));
+			fleet->AddShip(m_scene.AddObject(ship));
+		}
+		fleet->FlyToPosition(FixVec3(-start), 20.0f);
+		m_fleets.push_back(std::move(fleet));
+	}
+	if( numFleets > 0 )
+		LOG_LVL2("Spawned " + std::to_string(numFleets) + " test fleets with " + std::to_string(fleetSize) + " ships each");
+}
+
 // ************************************************************************* //
 void GSPlay::Simulate( double _deltaTime )
 {
+	m_inputLog.BeginStep();
+	// Everything far away from the player is simulated coarsely
+	if( m_player->GetShip() )
+		m_scene.GetLOD().SetFocus(&m_player->GetShip()->GetPosition(), 1);
 	m_scene.Simulate((float)_deltaTime);
 	m_fireManager.Process((float)_deltaTime);
 	m_scene.UpdateGraph();
 	m_player->Process( (float)_deltaTime );
+	if( !m_fleets.empty() )
+	{
+		TimeQuery(m_fleetTimer);
+		for( auto& fleet : m_fleets )
+			fleet->Process( (float)_deltaTime );
+		m_fleetTime += TimeQuery(m_fleetTimer);
+		++m_numFleetSteps;
+	}
 //	aiTest01->Process((float)_deltaTime);
 
 	static int testTimer = 0;
@@ -190,12 +286,23 @@ void GSPlay::Simulate( double _deltaTime )
 
 
 	Graphic::ParticleSystems::Manager::Simulate((float)_deltaTime);
+
+	// The step is complete: hand the transformations over to the renderer
+	m_scene.PublishSnapshot((float)_deltaTime);
+
+	if( m_inputLog.GetMode() != Replay::InputLog::Mode::OFF )
+		m_inputLog.EndStep(m_scene.ComputeStateHash());
 }
 
 // ************************************************************************* //
 void GSPlay::Render( double _deltaTime )
 {
-	m_camera->UpdateMatrices();
+	// Draw everything between the last two complete simulation steps
+	m_scene.BeginRenderFrame();
+	Math::Transformation pose;
+	if( m_camera->GetAttachedModel() && m_scene.GetRenderTransformation(m_camera->GetAttachedModel(), pose) )
+		m_camera->UpdateMatrices(pose);
+	else m_camera->UpdateMatrices();
 
 	RenderStat::g_numVoxels = 0;
 	RenderStat::g_numChunks = 0;
@@ -208,12 +315,21 @@ void GSPlay::Render( double _deltaTime )
 	Graphic::Device::SetEffect(	Resources::GetEffect(Effects::VOXEL_RENDER) );
 	Voxel::TypeInfo::BindVoxelTextureArray();
 	Jo::HybridArray<SOHandle, 32> visibleObjects;
-	m_scene.FrustumQuery(visibleObjects);
-	for( unsigned i = 0; i < visibleObjects.Size(); ++i ) {
-		Voxel::Model* model = dynamic_cast<Voxel::Model*>(&visibleObjects[i]);
-		Assert(model != nullptr, "Thread error? Currently there are only models");
-		if(model) model->Draw( *m_camera );
+	m_scene.FrustumQuery(visibleObjects, SOCapability::VOXEL_MODEL);
+	// Draw all at once such that instances of the same model are batched
+	std::vector<Voxel::Model*> models;
+	std::vector<Math::Transformation> poses;
+	models.reserve(visibleObjects.Size());
+	poses.reserve(visibleObjects.Size());
+	for( unsigned i = 0; i < visibleObjects.Size(); ++i )
+	{
+		Voxel::Model* model = static_cast<Voxel::Model*>(&visibleObjects[i]);
+		models.push_back( model );
+		if( m_scene.GetRenderTransformation(model, pose) )
+			poses.push_back( pose );
+		else poses.push_back( *model );
 	}
+	Voxel::Model::DrawBatch( *m_camera, models.data(), poses.data(), (int)models.size() );
 
 	if( m_selectedObject )
 		DrawReferenceGrid( m_selectedObjectModPtr );
@@ -222,7 +338,9 @@ void GSPlay::Render( double _deltaTime )
 	
 	//update hud information
 	//todo: move this to gsplayhud if possible?
-	m_hud->GetDebugLabel().SetText("<s 024>" + std::to_string(_deltaTime * 1000.0) + " ms\n#Vox: " + std::to_string(RenderStat::g_numVoxels) + "\n#Chunks: " + std::to_string(RenderStat::g_numChunks)+"</s>");
+	FireStats shots = m_fireManager.GetStats();
+	m_hud->GetDebugLabel().SetText("<s 024>" + std::to_string(_deltaTime * 1000.0) + " ms\n#Vox: " + std::to_string(RenderStat::g_numVoxels) + "\n#Chunks: " + std::to_string(RenderStat::g_numChunks)
+		+ "\n#Shots: " + std::to_string(shots.shots) + " in " + std::to_string(shots.batches) + " batches, max " + std::to_string(shots.maxBatchSize) + "</s>");
 	m_hud->m_velocityLabel->SetText(StringUtils::ToFixPoint(len(m_player->GetShip()->GetVelocity()), 1) + "m/s");
 	m_hud->m_targetVelocityLabel->SetText(StringUtils::ToFixPoint(len(m_player->GetShip()->GetTargetVelocity()), 1) + "m/s");
 //	m_hud->m_batteryDisplay->SetFillLevel(m_player->GetShip()->GetPrimarySystem().TempGetCharge());
@@ -279,7 +397,7 @@ void GSPlay::KeyClick( int _key )
 		Voxel::Model::ModelData::HitResult hit;
 		m_selectedObject = m_scene.RayQuery(ray, hit);
 		if( m_selectedObject ) {
-			m_selectedObjectModPtr = dynamic_cast<Voxel::Model*>(&m_selectedObject);
+			m_selectedObjectModPtr = m_selectedObject->HasCapability(SOCapability::VOXEL_MODEL) ? static_cast<Voxel::Model*>(&m_selectedObject) : nullptr;
 			m_player->SetTarget(m_selectedObjectModPtr);
 		//	m_selectedObjectModPtr->Set( hit.position, 0, Voxel::VoxelType::UNDEFINED );
 		}
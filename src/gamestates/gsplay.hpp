@@ -3,7 +3,9 @@
 #include "gamestatebase.hpp"
 #include "gameplay/scenegraph.hpp"
 #include "gameplay/managment/playercontroller.hpp"
+#include "gameplay/managment/fleetcontroller.hpp"
 #include "gameplay/firemanager.hpp"
+#include "gameplay/replay.hpp"
 
 #include <memory>
 
@@ -36,10 +38,24 @@ private:
 	SceneGraph m_scene;
 	FireManager m_fireManager;
 	std::unique_ptr<PlayerController> m_player;
+	std::vector<std::unique_ptr<FleetController>> m_fleets;	///< AI ships are steered in groups
+	TimeQuerySlot m_fleetTimer;
+	double m_fleetTime;				///< Total time of all fleet updates in seconds
+	uint64_t m_numFleetSteps;
 
 	SOHandle m_selectedObject;
 	Voxel::Model* m_selectedObjectModPtr;
 
+	Replay::InputLog m_inputLog;	///< Recording or replay of the player input in lockstep mode
+
+	/// \brief Read the lockstep options from the config and start a
+	///		recording or replay. Must be called before objects are created.
+	void SetupLockstep();
+
+	/// \brief Create the fleets given by Game.TestFleets. They fly across
+	///		the start area such that the fleet controller can be measured.
+	void SpawnTestFleets();
+
 	/// \brief Subroutine of the rendering: Showing the navigation grid.
 	void DrawReferenceGrid(const Voxel::Model* _model) const;
 };
\ No newline at end of file
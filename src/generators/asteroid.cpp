@@ -28,7 +28,7 @@ namespace Generators {
 			}
 		}
 
-		//size_t test = m_voxelTree.MemoryConsumption();
+		ReportDeduplication( "asteroid " + std::to_string(_seed) );
 
 //		for( int i=0; i<m_numChunks; ++i )
 	//		m_chunks[i]->ComputeVertexBuffer();
@@ -135,7 +135,7 @@ namespace Graphic {
 			(*s_ubos[(int)_ubo])["FarPlane"] = 2;
 			break;
 		case UniformBuffers::OBJECT_VOXEL:
-			s_ubos[(int)_ubo] = new UniformBuffer( "Object" );
+			s_ubos[(int)_ubo] = new UniformBuffer( "Object", 272 * MAX_VOXEL_INSTANCES );
 			s_ubos[(int)_ubo]->AddAttribute( "WorldView", Graphic::UniformBuffer::ATTRIBUTE_TYPE::MATRIX );
 			s_ubos[(int)_ubo]->AddAttribute( "InverseWorldView", Graphic::UniformBuffer::ATTRIBUTE_TYPE::MATRIX );
 			s_ubos[(int)_ubo]->AddAttribute( "Corner000", Graphic::UniformBuffer::ATTRIBUTE_TYPE::VEC4 );
@@ -147,6 +147,8 @@ namespace Graphic {
 			s_ubos[(int)_ubo]->AddAttribute( "Corner110", Graphic::UniformBuffer::ATTRIBUTE_TYPE::VEC4 );
 			s_ubos[(int)_ubo]->AddAttribute( "Corner111", Graphic::UniformBuffer::ATTRIBUTE_TYPE::VEC4 );
 			s_ubos[(int)_ubo]->AddAttribute( "MaxOffset", Graphic::UniformBuffer::ATTRIBUTE_TYPE::FLOAT );
+			// One element per instance of an instanced draw call
+			s_ubos[(int)_ubo]->MakeArray( MAX_VOXEL_INSTANCES );
 			break;
 		case UniformBuffers::OBJECT_WIRE:
 			s_ubos[(int)_ubo] = new UniformBuffer( "Object" );
@@ -24,6 +24,11 @@ namespace Graphic {
 		COUNT				///< Number of effects - this must be the last enumeration member
 	};
 
+	/// \brief Number of model instances drawn in one call of VOXEL_RENDER.
+	/// \details OBJECT_VOXEL holds one element per instance. This must match
+	///		MAX_VOXEL_INSTANCES in shader/voxelobject.glsl.
+	const int MAX_VOXEL_INSTANCES = 32;
+
 	/// \brief Preloaded effects.
 	enum struct UniformBuffers
 	{
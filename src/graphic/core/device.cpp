@@ -339,4 +339,13 @@ namespace Graphic {
 		else
 			GL_CALL(glDrawArrays, unsigned(_buffer.GetPrimitiveType()), _from, _count);
 	}
+
+	void Device::DrawVerticesInstanced( const VertexArrayBuffer& _buffer, int _from, int _count, int _numInstances )
+	{
+		_buffer.Bind();
+
+		g_Device.m_currentEffect->CommitUniformBuffers();
+
+		GL_CALL(glDrawArraysInstanced, unsigned(_buffer.GetPrimitiveType()), _from, _count, _numInstances);
+	}
 };
\ No newline at end of file
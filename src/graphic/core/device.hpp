@@ -70,6 +70,14 @@ namespace Graphic {
 		///		is made instead.
 		static void DrawVertices( const VertexArrayBuffer& _buffer, int _from, int _count );
 
+		/// \brief Draw the same vertices multiple times in one call.
+		/// \details Commits all state changes and uniform buffers automatically.
+		///
+		///		In contrast to instanced vertex buffers the per instance data
+		///		comes from uniform buffers indexed by gl_InstanceID.
+		///	\param [in] _numInstances Number of repetitions.
+		static void DrawVerticesInstanced( const VertexArrayBuffer& _buffer, int _from, int _count, int _numInstances );
+
 	private:
 		GLFWwindow* m_window;		///< Reference to the one window created during Initialize()
 
@@ -7,18 +7,18 @@ namespace Graphic {
 
 	static int g_iNumUBOs = 0;
 
-	UniformBuffer::UniformBuffer( const std::string& _name ) :
-		m_name(_name), m_size(0), m_isDirty(false)
+	UniformBuffer::UniformBuffer( const std::string& _name, unsigned _capacity ) :
+		m_name(_name), m_size(0), m_capacity(_capacity), m_stride(0), m_numElements(1), m_dirtyEnd(0)
 	{
 		GL_CALL(glGenBuffers, 1, &m_bufferID);
 		m_index = g_iNumUBOs++;
 
-		// Allocate memory on CPU side. The maximum size is 1KB.
-		m_memory = malloc(1024);
+		// Allocate memory on CPU side.
+		m_memory = malloc(m_capacity);
 
 		// Create GPU side memory
 		GL_CALL(glBindBuffer, GL_UNIFORM_BUFFER, m_bufferID);
-		GL_CALL(glBufferData, GL_UNIFORM_BUFFER, 1024, nullptr, GL_STREAM_DRAW);
+		GL_CALL(glBufferData, GL_UNIFORM_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
 	}
 
 	UniformBuffer::~UniformBuffer()
@@ -32,6 +32,7 @@ namespace Graphic {
 	{
 		// Attribute already exists!
 		Assert(m_attributes.find(_name) == m_attributes.end(), "Attribute exists already!");
+		Assert(m_numElements == 1, "Attributes must be added before MakeArray().");
 
 		// Determine alignment
 		int offset = m_size & 0xf;	// modulo 16
@@ -45,13 +46,25 @@ namespace Graphic {
 		offset += m_size;
 
 		// Is there still memory?
-		if( int(_type)+offset > 1024 ) { LOG_ERROR("Size of uniform buffer not large enough."); return; }
+		if( int(_type)+offset > int(m_capacity) ) { LOG_ERROR("Size of uniform buffer not large enough."); return; }
 
 		// All right add to map
 		m_attributes.insert( std::pair<std::string,int>( _name, offset ) );
 		m_size = int(_type)+offset;
 	}
 
+	void UniformBuffer::MakeArray( int _count )
+	{
+		Assert(m_numElements == 1 && _count > 0, "Invalid array size.");
+
+		unsigned stride = (m_size + 15) & ~15u;
+		if( stride * _count > m_capacity ) { LOG_ERROR("Size of uniform buffer not large enough."); return; }
+
+		m_stride = stride;
+		m_numElements = _count;
+		m_size = stride * _count;
+	}
+
 	UniformBuffer::UniformVar UniformBuffer::operator [] (const std::string& _name)
 	{
 		// Cannot access unknown attribute!
@@ -70,20 +83,30 @@ namespace Graphic {
 	}
 
 
+	UniformBuffer::UniformVar UniformBuffer::Get( const std::string& _name, int _element )
+	{
+		// Cannot access unknown attribute!
+		Assert(m_attributes.find(_name) != m_attributes.end(), "Cannot access unknown attribute!");
+		Assert(_element >= 0 && _element < m_numElements, "Array element out of range!");
+
+		return UniformVar((uint8*)m_memory + m_attributes[_name] + _element * m_stride, this);
+	}
+
+
 	void UniformBuffer::Commit()
 	{
 		// Bind to binding point according to its index
 		glBindBufferBase(GL_UNIFORM_BUFFER, m_index, m_bufferID);
 
-		if( m_isDirty )
+		if( m_dirtyEnd )
 		{
-			// Upload the whole used part of the buffer. It could be more efficient
-			// to upload only the changed part.
+			// Upload everything up to the last written byte. Array buffers are
+			// usually filled from the front, so unused elements are skipped.
 			GL_CALL(glBindBuffer, GL_UNIFORM_BUFFER, m_bufferID);
-			GL_CALL(glBufferSubData, GL_UNIFORM_BUFFER, 0, m_size, m_memory);
+			GL_CALL(glBufferSubData, GL_UNIFORM_BUFFER, 0, m_dirtyEnd, m_memory);
 
 
-			m_isDirty = false;
+			m_dirtyEnd = 0;
 		}
 	}
 };
\ No newline at end of file
@@ -16,7 +16,8 @@ namespace Graphic {
 	public:
 		/// \brief Create a uniform buffer object.
 		/// \param [in] _name Name of the buffer in the shader file for linking.
-		UniformBuffer( const std::string& _name );
+		/// \param [in] _capacity Maximum size in bytes on CPU and GPU side.
+		UniformBuffer( const std::string& _name, unsigned _capacity = 1024 );
 
 		~UniformBuffer();
 
@@ -30,6 +31,16 @@ namespace Graphic {
 		/// \brief Add a new attribute at the end of the uniform buffer.
 		void AddAttribute( const std::string& _name, ATTRIBUTE_TYPE _type );
 
+		/// \brief Repeat all attributes added so far as an array of structs.
+		/// \details The stride is rounded up to 16 bytes like std140 does for
+		///		a struct array. Access the elements with Get(). operator []
+		///		accesses the first element.
+		/// \param [in] _count Number of array elements.
+		void MakeArray( int _count );
+
+		/// \brief Number of array elements (1 if MakeArray() was not called).
+		int GetNumElements() const	{ return m_numElements; }
+
 		/// \brief A subclass required to make nice syntactic assignments with
 		///		different types.
 		class UniformVar {
@@ -41,23 +52,23 @@ namespace Graphic {
 
 			/// \brief Assign a matrix to the uniform location.
 			/// \details This will not check for type validity!
-			void operator=(const ei::Mat4x4& _m)	{ *(ei::Mat4x4*)bufferPosition = _m; buffer->m_isDirty = true; }
+			void operator=(const ei::Mat4x4& _m)	{ *(ei::Mat4x4*)bufferPosition = _m; buffer->MarkDirty((ei::Mat4x4*)bufferPosition + 1); }
 
 			/// \brief Assign a 4D vector to the uniform location.
 			/// \details This will not check for type validity!
-			void operator=(const ei::Vec4& _v)		{ *(ei::Vec4*)bufferPosition = _v; buffer->m_isDirty = true; }
+			void operator=(const ei::Vec4& _v)		{ *(ei::Vec4*)bufferPosition = _v; buffer->MarkDirty((ei::Vec4*)bufferPosition + 1); }
 
 			/// \brief Assign a 3D vector to the uniform location.
 			/// \details This will not check for type validity!
-			void operator=(const ei::Vec3& _v)		{ *(ei::Vec3*)bufferPosition = _v; buffer->m_isDirty = true; }
+			void operator=(const ei::Vec3& _v)		{ *(ei::Vec3*)bufferPosition = _v; buffer->MarkDirty((ei::Vec3*)bufferPosition + 1); }
 
 			/// \brief Assign a 2D vector to the uniform location.
 			/// \details This will not check for type validity!
-			void operator=(const ei::Vec2& _v)		{ *(ei::Vec2*)bufferPosition = _v; buffer->m_isDirty = true; }
+			void operator=(const ei::Vec2& _v)		{ *(ei::Vec2*)bufferPosition = _v; buffer->MarkDirty((ei::Vec2*)bufferPosition + 1); }
 
 			/// \brief Assign a float value to the uniform location.
 			/// \details This will not check for type validity!
-			void operator=(const float _f)			{ *(float*)bufferPosition = _f; buffer->m_isDirty = true; }
+			void operator=(const float _f)			{ *(float*)bufferPosition = _f; buffer->MarkDirty((float*)bufferPosition + 1); }
 
 			/// \brief Cast to matrix without type check.
 			operator ei::Mat4x4 () const { return *(ei::Mat4x4*)bufferPosition; }
@@ -81,9 +92,14 @@ namespace Graphic {
 		///		twice is not allowed.
 		const UniformVar operator [] ( const std::string& _name ) const;
 
+		/// \brief Read and write access to a variable of an array element.
+		/// \param [in] _element Index smaller than GetNumElements().
+		UniformVar Get( const std::string& _name, int _element );
+
 		/// \brief Load the latest changes up to the GPU.
 		/// \details Due to driver issues this should be called at most once
-		///		before each draw call.
+		///		before each draw call. Only the range up to the last written
+		///		byte is uploaded.
 		void Commit();
 
 		/// \brief Get the name of the buffer object which should be the same
@@ -101,8 +117,18 @@ namespace Graphic {
 		unsigned m_bufferID;	///< Address of uniform buffer object
 		void* m_memory;			///< RAM double buffer: this is edited and uploaded if necessary
 		unsigned m_size;		///< Number of used bytes in m_memory
-
-		bool m_isDirty;			///< Did something change since last commit?
+		unsigned m_capacity;	///< Allocated bytes in m_memory and on GPU
+		unsigned m_stride;		///< Size of one array element
+		int m_numElements;		///< Number of array elements
+
+		unsigned m_dirtyEnd;	///< End of the range changed since last commit or 0
+
+		/// \brief Extend the range which must be uploaded.
+		void MarkDirty( const void* _end )
+		{
+			unsigned end = unsigned((const char*)_end - (const char*)m_memory);
+			if( end > m_dirtyEnd ) m_dirtyEnd = end;
+		}
 
 		std::unordered_map<std::string, int> m_attributes;
 	};
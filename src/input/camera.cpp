@@ -14,6 +14,7 @@ namespace Input {
 		m_fov( _fov ),
 		m_aspect( _aspect ),
 		m_worldRotation( _rotation ),
+		m_attachedTo( nullptr ),
 		m_attachMode( REFERENCE_ONLY ),
 		m_phi(0.0f),
 		m_theta(0.0f),
@@ -41,7 +42,7 @@ namespace Input {
 	{
 		if (m_attachedTo)
 		{
-			m_transformation.SetPosition(m_attachedTo->GetPosition() + FixVec3(_pos));
+			m_transformation.SetPosition(m_attachedPose.GetPosition() + FixVec3(_pos));
 			m_referencePos = -_pos;
 		}
 	}
@@ -50,12 +51,19 @@ namespace Input {
 	ei::Vec3 Camera::GetReferencePosition() const
 	{
 		if( m_attachMode != REFERENCE_ONLY ) return m_transformation.GetInverseRotationMatrix() * m_referencePos;
-		return ei::Vec3(m_attachedTo->GetPosition() - m_transformation.GetPosition());
+		return ei::Vec3(m_attachedPose.GetPosition() - m_transformation.GetPosition());
 	}
 
 	// ********************************************************************* //
 	void Camera::UpdateMatrices()
 	{
+		if( m_attachedTo ) m_attachedPose = *m_attachedTo;
+		UpdateMatrices( m_attachedPose );
+	}
+
+	void Camera::UpdateMatrices( const Math::Transformation& _attachedPose )
+	{
+		m_attachedPose = _attachedPose;
 		if( m_attachMode != REFERENCE_ONLY ) {
 			NormalizeReference();
 		}
@@ -87,7 +95,7 @@ namespace Input {
 			// In soft case the reference point is recomputed since we don't
 			// want to jump back but center movement at the object.
 			if( m_attachMode == REFERENCE_ONLY )
-				m_referencePos = m_transformation.Transform( m_attachedTo->GetPosition() );
+				m_referencePos = m_transformation.Transform( m_attachedPose.GetPosition() );
 			// Additionally the rotation is either relative to the world or to the object.
 			m_worldRotation = ei::Quaternion( -m_theta, 0.0f, 0.0f ) * ei::Quaternion( 0.0f, -m_phi, 0.0f );
 			if( m_attachMode != FOLLOW_AND_ROTATE )
@@ -142,6 +150,7 @@ namespace Input {
 		}
 
 		m_attachedTo = &_model;
+		m_attachedPose = _model;
 		m_attachMode = _mode;
 		m_referencePos[0] = 0.0f;
 		m_referencePos[1] = 0.0f;
@@ -162,6 +171,7 @@ namespace Input {
 		}
 
 		m_attachedTo = _model;
+		m_attachedPose = *_model;
 		m_attachMode = _mode;
 		// Compute actual reference frame.
 		m_referencePos = m_transformation.Transform( _model->GetPosition() );
@@ -175,11 +185,11 @@ namespace Input {
 		// Object might be rotated -> camera must follow to look on the same side
 		if( m_attachMode == FOLLOW_AND_ROTATE )
 		{
-			m_transformation.SetRotation( m_worldRotation * ~m_attachedTo->GetRotation() );
+			m_transformation.SetRotation( m_worldRotation * ~m_attachedPose.GetRotation() );
 		}
 		// Transform by rotation inverse (which is multiplying from right for
 		// rotations)
-		m_transformation.SetPosition( m_attachedTo->GetPosition() - FixVec3(m_transformation.GetInverseRotationMatrix() * m_referencePos) );
+		m_transformation.SetPosition( m_attachedPose.GetPosition() - FixVec3(m_transformation.GetInverseRotationMatrix() * m_referencePos) );
 	}
 
 	// ********************************************************************* //
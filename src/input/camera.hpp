@@ -78,6 +78,11 @@ namespace Input {
 		///		(multi threading). This is the only function which will change
 		///		them.
 		void UpdateMatrices();
+		/// \brief Recompute all the matrices with the attached model placed at
+		///		the given pose instead of its live transformation.
+		/// \details Used with the interpolated transformations of the render
+		///		snapshot such that the camera moves as smooth as the model.
+		void UpdateMatrices( const Math::Transformation& _attachedPose );
 		const Math::Transformation& Transformation() const { return m_transformation; }
 
 		const ei::Mat4x4& GetProjection() const			{ return m_projection; }			///< Return projection matrix
@@ -111,6 +116,7 @@ namespace Input {
 		float m_theta;
 
 		const Voxel::Model* m_attachedTo;	///< The camera can track this object and uses it as reference system
+		Math::Transformation m_attachedPose;	///< Transformation of the attached model in the last UpdateMatrices()
 		ei::Vec3 m_referencePos;			///< Object position in view space. This reference frame is kept for a tracked object.
 		ei::Quaternion m_worldRotation;		///< World space rotation of the camera. This is equal to the rotation if not attached with FOLLOW_AND_ROTATE.
 		AttachMode m_attachMode;			///< If the object is hard attached the camera position follows the object. If it is soft attached rotations are relative to the object.
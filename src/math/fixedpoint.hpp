@@ -41,6 +41,10 @@ namespace Math {
 		//operator int64_t() const;
 		//int64_t data() const { return m_data; }
 
+		/// \brief Index of the grid cell with edge length 2^_logCellSize
+		///		which contains this number (rounded towards -infinity).
+		int64_t Floor(int _logCellSize) const	{ return m_data >> (FracDigits + _logCellSize); }
+
 		bool operator < (TFix _rhs) const;
 		bool operator <= (TFix _rhs) const;
 		bool operator > (TFix _rhs) const;
@@ -36,6 +36,9 @@ namespace Mechanics {
 	class StorageSystem;
 	class SensorSystem;
 	class DriveSystem;
+	class WeaponSystem;
+	class ComponentScheduler;
+	class EnergyNetwork;
 }
 
 namespace Generators {
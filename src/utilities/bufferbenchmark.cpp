@@ -0,0 +1,213 @@
+#include "bufferbenchmark.hpp"
+#include "multiversionbuffer.hpp"
+#include "threadsafebuffer.hpp"
+#include "logger.hpp"
+#include "timer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+
+	// Sizes of the written versions cycle through [MIN_SIZE, MAX_SIZE)
+	const int MIN_SIZE = 256;
+	const int MAX_SIZE = 4096;
+
+	struct BenchmarkResult
+	{
+		uint64_t writes;
+		uint64_t reads;
+		uint64_t errors;
+	};
+
+	// ********************************************************************* //
+	/// \brief Create version _version from the previous one.
+	/// \param [in] _incremental true: append one value and remove the oldest
+	///		one if the buffer is full. false: replace the whole content by
+	///		copies of _version.
+	static void ChangeVersion(std::vector<uint32_t>& _data, uint32_t _version, bool _incremental)
+	{
+		if( _incremental )
+		{
+			if( _data.size() >= MAX_SIZE ) _data.erase(_data.begin());
+			_data.push_back(_version);
+		} else {
+			// Change the size to move the end of the data as well
+			_data.resize(MIN_SIZE + (int)(_version % (MAX_SIZE - MIN_SIZE)));
+			std::fill(_data.begin(), _data.end(), _version);
+		}
+	}
+
+	static void WriteVersion(MultiVersionBuffer<uint32_t>& _buffer, uint32_t _version, bool _incremental)
+	{
+		if( _incremental )
+			_buffer.Apply([_version](std::vector<uint32_t>& _data, const std::vector<uint32_t>&){
+				ChangeVersion(_data, _version, true);
+			});
+		else {
+			// The old content is not needed
+			MultiVersionBuffer<uint32_t>::WriteGuard write;
+			_buffer.GetWriteAccess(write, false);
+			ChangeVersion(write.buf(), _version, false);
+		}
+	}
+
+	static void WriteVersion(ThreadSafeBuffer<uint32_t>& _buffer, uint32_t _version, bool _incremental)
+	{
+		ThreadSafeBuffer<uint32_t>::WriteGuard write;
+		_buffer.GetWriteAccess(write);
+		ChangeVersion(write.buf(), _version, _incremental);
+	}
+
+	// ********************************************************************* //
+	/// \brief Check one read version: it must be complete and not older
+	///		than the last one of this reader.
+	/// \details Complete means all elements are equal (replacing writes) or
+	///		consecutive (incremental writes).
+	template<typename ReadGuard>
+	static bool CheckVersion(const ReadGuard& _read, uint32_t& _lastVersion, bool _incremental)
+	{
+		if( _read.size() == 0 ) return true;
+		uint32_t version = _incremental ? _read[_read.size() - 1] : _read[0];
+		for( int i = 1; i < _read.size(); ++i )
+			if( _read[i] != (_incremental ? _read[i-1] + 1 : version) ) return false;
+		if( version < _lastVersion ) return false;
+		_lastVersion = version;
+		return true;
+	}
+
+	// ********************************************************************* //
+	template<typename Buffer>
+	static BenchmarkResult RunBenchmark(int _numReaders, double _seconds, bool _incremental)
+	{
+		Buffer buffer;
+		std::atomic<bool> stop(false);
+		std::atomic<uint64_t> reads(0);
+		std::atomic<uint64_t> errors(0);
+
+		std::vector<std::thread> readers;
+		for( int r = 0; r < _numReaders; ++r )
+			readers.emplace_back([&](){
+				uint32_t lastVersion = 0;
+				uint64_t numReads = 0;
+				while( !stop.load() )
+				{
+					auto read = buffer.GetReadAccess();
+					if( !CheckVersion(read, lastVersion, _incremental) ) ++errors;
+					++numReads;
+				}
+				reads += numReads;
+			});
+
+		BenchmarkResult result;
+		result.writes = 0;
+		TimeQuerySlot timer = 0;
+		TimeQuery(timer);
+		double time = 0.0;
+		while( time < _seconds )
+		{
+			WriteVersion(buffer, (uint32_t)++result.writes, _incremental);
+			time += TimeQuery(timer);
+		}
+		stop = true;
+		for( auto& reader : readers )
+			reader.join();
+
+		result.reads = reads.load();
+		result.errors = errors.load();
+		return result;
+	}
+
+	// ********************************************************************* //
+	static void LogResult(const std::string& _name, const BenchmarkResult& _result, double _seconds)
+	{
+		LOG_LVL1(_name + ": " + std::to_string(_result.writes / _seconds) + " writes/s, "
+			+ std::to_string(_result.reads / _seconds) + " reads/s");
+		if( _result.errors )
+			LOG_ERROR(_name + " returned " + std::to_string(_result.errors) + " inconsistent versions.");
+	}
+
+	// ********************************************************************* //
+	bool RunBufferBenchmark(int _numReaders, double _seconds)
+	{
+		bool success = true;
+		for( int incremental = 0; incremental < 2; ++incremental )
+		{
+			BenchmarkResult multiVersion = RunBenchmark<MultiVersionBuffer<uint32_t>>(_numReaders, _seconds, incremental != 0);
+			BenchmarkResult threadSafe = RunBenchmark<ThreadSafeBuffer<uint32_t>>(_numReaders, _seconds, incremental != 0);
+			std::string scenario = incremental ? " (incremental)" : " (replace)";
+			LogResult("MultiVersionBuffer" + scenario, multiVersion, _seconds);
+			LogResult("ThreadSafeBuffer" + scenario, threadSafe, _seconds);
+			success &= multiVersion.errors == 0 && threadSafe.errors == 0;
+		}
+		return success;
+	}
+
+	// ********************************************************************* //
+	bool RunBufferStressTest(int _numThreads, double _seconds)
+	{
+		MultiVersionBuffer<uint32_t> buffer;
+		std::atomic<bool> stop(false);
+		std::atomic<uint64_t> errors(0);
+		std::vector<uint32_t> numAppended(_numThreads, 0);
+
+		// Each producer appends the values t, t + _numThreads, t + 2 * _numThreads, ...
+		std::vector<std::thread> threads;
+		for( int t = 0; t < _numThreads; ++t )
+			threads.emplace_back([&, t](){
+				for( uint32_t value = t; !stop.load(); value += _numThreads )
+				{
+					buffer.Append(value);
+					++numAppended[t];
+				}
+			});
+		for( int r = 0; r < _numThreads; ++r )
+			threads.emplace_back([&](){
+				int lastSize = 0;
+				while( !stop.load() )
+				{
+					auto outer = buffer.GetReadAccess();
+					auto inner = buffer.GetReadAccess();
+					if( inner.size() < outer.size() || outer.size() < lastSize ) ++errors;
+					lastSize = outer.size();
+				}
+			});
+
+		auto appendAll = [](std::vector<uint32_t>& _data, const std::vector<uint32_t>& _appended){
+			_data.insert(_data.end(), _appended.begin(), _appended.end());
+		};
+		TimeQuerySlot timer = 0;
+		TimeQuery(timer);
+		double time = 0.0;
+		while( time < _seconds )
+		{
+			buffer.Apply(appendAll);
+			time += TimeQuery(timer);
+		}
+		stop = true;
+		for( auto& thread : threads )
+			thread.join();
+		buffer.Apply(appendAll);
+
+		// Every value must be there once
+		std::vector<uint32_t> values = buffer.GetReadAccess().buf();
+		std::sort(values.begin(), values.end());
+		uint64_t expected = 0;
+		for( int t = 0; t < _numThreads; ++t )
+		{
+			expected += numAppended[t];
+			for( uint32_t i = 0; i < numAppended[t]; ++i )
+				if( !std::binary_search(values.begin(), values.end(), t + i * _numThreads) ) { ++errors; break; }
+		}
+		if( values.size() != expected || std::adjacent_find(values.begin(), values.end()) != values.end() )
+			++errors;
+
+		if( errors.load() )
+			LOG_ERROR("MultiVersionBuffer stress test failed " + std::to_string(errors.load()) + " checks.");
+		return errors.load() == 0;
+	}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+namespace Utils {
+
+	/// \brief Throughput comparison of MultiVersionBuffer and the previous
+	///		ThreadSafeBuffer.
+	/// \details Each buffer is written by one thread and read by
+	///		_numReaders threads for _seconds. Every written version contains
+	///		one value only. The readers check that each version they see is
+	///		complete (a single value) and never older than the one they saw
+	///		before. Violations are logged as errors and the throughput of
+	///		both buffers is logged on level 1.
+	///
+	///		Two scenarios are measured: the writer replaces the whole content,
+	///		or it appends one value and removes the oldest. The
+	///		MultiVersionBuffer skips the copy in the first case and replays the
+	///		change on recycled versions (Apply()) in the second.
+	///
+	///		Runs on demand only (Game.BenchmarkBuffers) and blocks the caller.
+	/// \return false if any consistency check failed.
+	bool RunBufferBenchmark(int _numReaders, double _seconds);
+
+	/// \brief Consistency test of the MultiVersionBuffer features the
+	///		benchmark does not cover.
+	/// \details _numThreads threads Append() unique values while the writer
+	///		applies changes and readers take nested read accesses. Checks
+	///		that nested versions are never older than the outer one, that
+	///		versions never shrink, and that every appended value ends up in
+	///		the buffer exactly once.
+	///
+	///		Debug builds run it briefly on startup.
+	/// \return false if any check failed.
+	bool RunBufferStressTest(int _numThreads, double _seconds);
+
+}
@@ -0,0 +1,55 @@
+#include "jobbenchmark.hpp"
+#include "jobsystem.hpp"
+#include "logger.hpp"
+#include "timer.hpp"
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace Utils {
+
+	// Workload: NUM_ITEMS independent items of ITEM_COST iterations each
+	const int NUM_ITEMS = 4096;
+	const int ITEM_COST = 5000;
+	// Number of empty jobs to measure the overhead per job
+	const int NUM_EMPTY_JOBS = 100000;
+
+	// ********************************************************************* //
+	static float ComputeItem(int _item)
+	{
+		float x = (float)_item;
+		for( int i = 0; i < ITEM_COST; ++i )
+			x = std::sin(x) + 1.0f;
+		return x;
+	}
+
+	// ********************************************************************* //
+	void RunJobSystemBenchmark()
+	{
+		// Each item writes its own result, so nothing is shared
+		std::vector<float> results(NUM_ITEMS);
+		TimeQuerySlot timer = 0;
+
+		TimeQuery(timer);
+		for( int i = 0; i < NUM_ITEMS; ++i )
+			results[i] = ComputeItem(i);
+		double serialTime = TimeQuery(timer);
+
+		JobSystem::ParallelFor(NUM_ITEMS, [&results](int _i){
+			results[_i] = ComputeItem(_i);
+		});
+		double parallelTime = TimeQuery(timer);
+
+		JobCounter counter;
+		for( int i = 0; i < NUM_EMPTY_JOBS; ++i )
+			JobSystem::Run([](){}, &counter);
+		JobSystem::Wait(counter);
+		double emptyTime = TimeQuery(timer);
+
+		LOG_LVL1("JobSystem with " + std::to_string(JobSystem::NumThreads()) + " threads: serial "
+			+ std::to_string(serialTime * 1000.0) + " ms, parallel " + std::to_string(parallelTime * 1000.0)
+			+ " ms (speedup " + std::to_string(serialTime / parallelTime) + "), "
+			+ std::to_string(emptyTime * 1e9 / NUM_EMPTY_JOBS) + " ns per empty job");
+	}
+
+}
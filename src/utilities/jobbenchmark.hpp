@@ -0,0 +1,15 @@
+#pragma once
+
+namespace Utils {
+
+	/// \brief Measure the speedup and the scheduling overhead of the
+	///		JobSystem.
+	/// \details Runs a compute bound workload once serially and once with
+	///		ParallelFor, and a burst of empty jobs with Run() and Wait().
+	///		The results are logged on level 1. The job system must be
+	///		initialized.
+	///
+	///		Runs on demand only (Game.BenchmarkJobs) and blocks the caller.
+	void RunJobSystemBenchmark();
+
+}
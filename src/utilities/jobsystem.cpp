@@ -0,0 +1,270 @@
+#include "jobsystem.hpp"
+#include "assert.hpp"
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+#include <memory>
+
+namespace Utils {
+
+	/// \brief A deque of jobs with a lock. The owner works at the back,
+	///		thieves take from the front.
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	static std::vector<std::thread> g_workers;
+	/// One deque per worker and a last one shared by all other threads
+	static std::unique_ptr<WorkQueue[]> g_queues;
+	static int g_numQueues = 0;
+	static WorkQueue g_mainThreadQueue;
+
+	static std::atomic<int> g_numQueued(0);		///< Jobs in all deques (without main thread jobs)
+	static std::atomic<int> g_numSleeping(0);
+	static std::atomic<bool> g_shutdown(false);
+	static std::mutex g_sleepMutex;
+	static std::condition_variable g_wakeUp;
+
+	/// Deque of the calling thread or -1 for non workers
+	static thread_local int t_queueIndex = -1;
+	static thread_local bool t_isMainThread = false;
+
+	// ********************************************************************* //
+	void JobSystem::Initialize(int _numWorkers)
+	{
+		Assert(g_workers.empty(), "Job system is already initialized.");
+		if(_numWorkers < 0)
+			_numWorkers = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+		g_numQueues = _numWorkers + 1;
+		g_queues.reset(new WorkQueue[g_numQueues]);
+		g_shutdown = false;
+		for(int i = 0; i < _numWorkers; ++i)
+			g_workers.emplace_back(&JobSystem::WorkerMain, i);
+	}
+
+	// ********************************************************************* //
+	void JobSystem::Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(g_sleepMutex);
+			g_shutdown = true;
+		}
+		g_wakeUp.notify_all();
+		for(auto& worker : g_workers)
+			worker.join();
+		g_workers.clear();
+		g_queues.reset();
+		g_numQueues = 0;
+		g_numQueued = 0;
+	}
+
+	// ********************************************************************* //
+	void JobSystem::Run(std::function<void()> _task, JobCounter* _counter)
+	{
+		if(_counter) ++_counter->m_count;
+		Job job = {std::move(_task), _counter};
+		// Without an initialized system everything runs in place
+		if(!g_numQueues)
+		{
+			job.task();
+			Finish(job.counter);
+			return;
+		}
+		Schedule(std::move(job));
+	}
+
+	// ********************************************************************* //
+	void JobSystem::RunAfter(JobCounter& _dependency, std::function<void()> _task, JobCounter* _counter)
+	{
+		if(_counter) ++_counter->m_count;
+		Job job = {std::move(_task), _counter};
+		{
+			std::lock_guard<std::mutex> lock(_dependency.m_mutex);
+			if(_dependency.m_count.load() > 0)
+			{
+				_dependency.m_continuations.push_back(std::move(job));
+				return;
+			}
+		}
+		// The dependency is already done
+		if(!g_numQueues)
+		{
+			job.task();
+			Finish(job.counter);
+		} else Schedule(std::move(job));
+	}
+
+	// ********************************************************************* //
+	void JobSystem::RunOnMainThread(std::function<void()> _task, JobCounter* _counter)
+	{
+		if(_counter) ++_counter->m_count;
+		Job job = {std::move(_task), _counter};
+		std::lock_guard<std::mutex> lock(g_mainThreadQueue.mutex);
+		g_mainThreadQueue.jobs.push_back(std::move(job));
+	}
+
+	// ********************************************************************* //
+	void JobSystem::RunMainThreadJobs()
+	{
+		t_isMainThread = true;
+		while(true)
+		{
+			Job job;
+			{
+				std::lock_guard<std::mutex> lock(g_mainThreadQueue.mutex);
+				if(g_mainThreadQueue.jobs.empty()) return;
+				job = std::move(g_mainThreadQueue.jobs.front());
+				g_mainThreadQueue.jobs.pop_front();
+			}
+			job.task();
+			Finish(job.counter);
+		}
+	}
+
+	// ********************************************************************* //
+	bool JobSystem::IsMainThread()
+	{
+		return t_isMainThread;
+	}
+
+	// ********************************************************************* //
+	void JobSystem::Wait(JobCounter& _counter)
+	{
+		while(!_counter.IsDone())
+		{
+			// Help out. The main thread must also process its own queue,
+			// otherwise it could wait for itself.
+			if(t_isMainThread)
+				RunMainThreadJobs();
+			if(!TryRunJob())
+				std::this_thread::yield();
+		}
+		// The finishing thread may still hold the lock of the counter
+		std::lock_guard<std::mutex> lock(_counter.m_mutex);
+	}
+
+	// ********************************************************************* //
+	// Jobs per thread in ParallelFor. More jobs balance better, fewer jobs
+	// have less overhead.
+	const int JOBS_PER_THREAD = 4;
+
+	void JobSystem::ParallelFor(int _count, const std::function<void(int)>& _task)
+	{
+		if(_count <= 0) return;
+		// Not worth any scheduling
+		if(_count == 1 || g_workers.empty())
+		{
+			for(int i = 0; i < _count; ++i)
+				_task(i);
+			return;
+		}
+
+		int numJobs = std::min(_count, NumThreads() * JOBS_PER_THREAD);
+		JobCounter counter;
+		for(int j = 0; j < numJobs; ++j)
+		{
+			int first = int(_count * (long long)j / numJobs);
+			int last = int(_count * (long long)(j + 1) / numJobs);
+			Run([first, last, &_task](){
+				for(int i = first; i < last; ++i)
+					_task(i);
+			}, &counter);
+		}
+		Wait(counter);
+	}
+
+	// ********************************************************************* //
+	int JobSystem::NumThreads()
+	{
+		return (int)g_workers.size() + 1;
+	}
+
+	// ********************************************************************* //
+	void JobSystem::Schedule(Job&& _job)
+	{
+		WorkQueue& queue = g_queues[t_queueIndex >= 0 ? t_queueIndex : g_numQueues - 1];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(_job));
+		}
+		++g_numQueued;
+		if(g_numSleeping.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(g_sleepMutex);
+			g_wakeUp.notify_one();
+		}
+	}
+
+	// ********************************************************************* //
+	bool JobSystem::TryRunJob()
+	{
+		if(g_numQueued.load() == 0) return false;
+
+		Job job;
+		bool found = false;
+		// Own deque first (newest job, hot caches), then the oldest jobs of
+		// the others starting with the next one.
+		int own = t_queueIndex >= 0 ? t_queueIndex : g_numQueues - 1;
+		for(int i = 0; i < g_numQueues && !found; ++i)
+		{
+			WorkQueue& queue = g_queues[(own + i) % g_numQueues];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if(queue.jobs.empty()) continue;
+			if(i == 0 && t_queueIndex >= 0)
+			{
+				job = std::move(queue.jobs.back());
+				queue.jobs.pop_back();
+			} else {
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+			}
+			found = true;
+		}
+		if(!found) return false;
+
+		--g_numQueued;
+		job.task();
+		Finish(job.counter);
+		return true;
+	}
+
+	// ********************************************************************* //
+	void JobSystem::Finish(JobCounter* _counter)
+	{
+		if(!_counter) return;
+		std::vector<Job> continuations;
+		{
+			std::lock_guard<std::mutex> lock(_counter->m_mutex);
+			if(--_counter->m_count == 0)
+				continuations.swap(_counter->m_continuations);
+		}
+		// The counter may be gone from here on
+		for(auto& job : continuations)
+		{
+			if(!g_numQueues)
+			{
+				job.task();
+				Finish(job.counter);
+			} else Schedule(std::move(job));
+		}
+	}
+
+	// ********************************************************************* //
+	void JobSystem::WorkerMain(int _index)
+	{
+		t_queueIndex = _index;
+		while(!g_shutdown)
+		{
+			if(TryRunJob()) continue;
+
+			std::unique_lock<std::mutex> lock(g_sleepMutex);
+			++g_numSleeping;
+			g_wakeUp.wait(lock, []{ return g_shutdown || g_numQueued.load() > 0; });
+			--g_numSleeping;
+		}
+	}
+
+} // namespace Utils
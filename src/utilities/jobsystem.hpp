@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+namespace Utils {
+
+	class JobCounter;
+
+	/// \brief A task and the counter which is decremented when it finished.
+	struct Job
+	{
+		std::function<void()> task;
+		JobCounter* counter;
+	};
+
+	/// \brief Counts the unfinished jobs of a group and keeps jobs which must
+	///		wait until all of them are done.
+	/// \details A counter must live until it was waited for.
+	class JobCounter
+	{
+	public:
+		JobCounter() : m_count(0) {}
+
+		bool IsDone() const { return m_count.load() == 0; }
+	private:
+		std::atomic<int> m_count;
+		std::mutex m_mutex;						///< Protects the continuations
+		std::vector<Job> m_continuations;		///< Jobs started when the count reaches 0
+
+		JobCounter(const JobCounter&) = delete;
+		void operator = (const JobCounter&) = delete;
+
+		friend class JobSystem;
+	};
+
+	/// \brief A global set of worker threads with work stealing.
+	/// \details Each worker owns a deque of jobs. It pushes and pops its own
+	///		jobs at the back and steals the oldest jobs of other deques from
+	///		the front if it runs dry. Threads which are no workers (render and
+	///		simulation loop) push into a shared deque and help executing jobs
+	///		while they wait.
+	///
+	///		Jobs which must run on the thread owning the GL context are kept
+	///		in a separate queue which is only processed by
+	///		RunMainThreadJobs().
+	///
+	///		Jobs may finish in any order. Results must be written to per job
+	///		storage and merged in a fixed order to stay deterministic.
+	class JobSystem
+	{
+	public:
+		/// \brief Start the worker threads.
+		/// \param [in] _numWorkers Number of additional threads. If negative
+		///		the number of hardware threads minus one is used.
+		static void Initialize(int _numWorkers = -1);
+
+		/// \brief Stop all workers. Queued jobs are dropped.
+		static void Close();
+
+		/// \brief Queue a job for any thread.
+		/// \param [inout] _counter Optional counter which is incremented now
+		///		and decremented after the job finished.
+		static void Run(std::function<void()> _task, JobCounter* _counter = nullptr);
+
+		/// \brief Queue a job which starts after all jobs of _dependency
+		///		finished.
+		static void RunAfter(JobCounter& _dependency, std::function<void()> _task, JobCounter* _counter = nullptr);
+
+		/// \brief Queue a job which must be executed on the main (GL) thread.
+		static void RunOnMainThread(std::function<void()> _task, JobCounter* _counter = nullptr);
+
+		/// \brief Execute all queued main thread jobs. This marks the calling
+		///		thread as main thread and must be called regularly by the
+		///		thread owning the GL context.
+		static void RunMainThreadJobs();
+
+		/// \brief Was the calling thread marked by RunMainThreadJobs()?
+		static bool IsMainThread();
+
+		/// \brief Block until all jobs of the counter finished. The calling
+		///		thread executes other jobs in the meantime.
+		static void Wait(JobCounter& _counter);
+
+		/// \brief Call _task(i) for all i in [0, _count) in parallel and wait
+		///		for all of them.
+		/// \details Neighbored indices are grouped into a few jobs per thread.
+		static void ParallelFor(int _count, const std::function<void(int)>& _task);
+
+		/// \brief Number of worker threads plus the calling one.
+		static int NumThreads();
+	private:
+		/// \brief Push a job into the deque of the calling thread.
+		static void Schedule(Job&& _job);
+
+		/// \brief Execute one job of the own deque or steal one.
+		/// \return false if all deques were empty.
+		static bool TryRunJob();
+
+		/// \brief Decrement the counter of a job and start its continuations.
+		static void Finish(JobCounter* _counter);
+
+		static void WorkerMain(int _index);
+	};
+
+} // namespace Utils
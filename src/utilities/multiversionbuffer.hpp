@@ -0,0 +1,370 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <iterator>
+#include <cstdint>
+#include "utilities/assert.hpp"
+
+namespace Utils {
+	/// \brief Maximum number of threads which use multi-version buffers at
+	///		the same time.
+	const int MAX_BUFFER_THREADS = 64;
+
+	namespace Details {
+		/// \brief Bit mask of the thread slots in use.
+		inline std::atomic<uint64_t>& UsedThreadSlots()
+		{
+			static std::atomic<uint64_t> s_used(0);
+			return s_used;
+		}
+
+		/// \brief Claims the lowest free slot for the lifetime of a thread.
+		struct ThreadSlot
+		{
+			int index;
+
+			ThreadSlot()
+			{
+				uint64_t used = UsedThreadSlots().load();
+				do {
+					index = 0;
+					while(index < MAX_BUFFER_THREADS && (used & (uint64_t(1) << index)))
+						++index;
+					Assert(index < MAX_BUFFER_THREADS, "Too many threads access multi-version buffers.");
+				} while(!UsedThreadSlots().compare_exchange_weak(used, used | (uint64_t(1) << index)));
+			}
+
+			~ThreadSlot()	{ UsedThreadSlots() &= ~(uint64_t(1) << index); }
+		};
+
+		/// \brief Index in [0, MAX_BUFFER_THREADS) which is unique among all
+		///		running threads. Slots of finished threads are reused.
+		inline int GetThreadSlot()
+		{
+			static thread_local ThreadSlot t_slot;
+			return t_slot.index;
+		}
+	}
+
+	/// \brief A dynamic array (vector) with lock free concurrent reads while
+	///		a single writer prepares the next version.
+	/// \details Readers pin the published version in a slot of their own
+	///		thread, so reading does not touch memory shared with other
+	///		readers. The writer recycles any retired version which is not
+	///		pinned and creates a new one if all are pinned, so it never waits
+	///		for readers. The number of versions is bounded by the number of
+	///		reading threads plus two.
+	///
+	///		A recycled version lags behind the published one. Changes made
+	///		with Apply() are logged and replayed on it, so it is brought up to
+	///		date without copying the whole content. Changes through a
+	///		WriteGuard cannot be replayed and the next write copies instead.
+	///
+	///		Append() can be called from any thread. The elements are staged
+	///		per thread and handed to the next write.
+	///
+	///		Write access (Apply() and GetWriteAccess()) must be acquired from
+	///		a single thread at a time.
+	template<typename T>
+	class MultiVersionBuffer
+	{
+		struct Version;
+		struct ReaderSlot;
+	public:
+		/// \brief A change which can be replayed on older versions.
+		/// \details Gets the content and the elements appended since the
+		///		previous write. It is called once for the published version and
+		///		once more for every recycled version which missed it, so it must
+		///		only depend on its arguments and on captured values.
+		typedef std::function<void(std::vector<T>&, const std::vector<T>&)> Change;
+
+		class WriteGuard {
+		public:
+			WriteGuard() : parent(nullptr), version(nullptr) {}
+
+			/// \brief The destruction publishes the written version.
+			~WriteGuard()
+			{
+				if(parent) parent->Publish(version);
+			}
+
+			WriteGuard(WriteGuard&& _other) :
+				parent(_other.parent),
+				version(_other.version)
+			{
+				_other.parent = nullptr;
+			}
+
+			void operator = (WriteGuard&& _other)
+			{
+				if(parent) parent->Publish(version);
+				parent = _other.parent;
+				version = _other.version;
+				_other.parent = nullptr;
+			}
+
+			std::vector<T>& buf()	{ return version->data; }
+		private:
+			MultiVersionBuffer* parent;
+			Version* version;
+
+			WriteGuard(MultiVersionBuffer* _parent, Version* _version) : parent(_parent), version(_version) {}
+			WriteGuard(const WriteGuard&) = delete;
+			void operator = (const WriteGuard&) = delete;
+
+			friend class MultiVersionBuffer;
+		};
+
+		/// \brief Consistent access to one version.
+		/// \details Must be released by the thread which acquired it.
+		class ReadGuard {
+		public:
+			ReadGuard(ReadGuard&& _other) :
+				version(_other.version),
+				slot(_other.slot)
+			{
+				_other.slot = nullptr;
+			}
+
+			/// \brief Unpin the version.
+			~ReadGuard()
+			{
+				if(slot && --slot->depth == 0)
+				{
+					slot->oldest.store(UNPINNED);
+					slot->newest.store(UNPINNED);
+				}
+			}
+
+			T& operator [] (int _index) const { return const_cast<T&>(buf()[_index]); }
+			int size() const { return (int)buf().size(); }
+			const std::vector<T>& buf() const { return version->data; }
+		private:
+			const Version* version;
+			ReaderSlot* slot;
+
+			ReadGuard(const Version* _version, ReaderSlot* _slot) : version(_version), slot(_slot) {}
+			ReadGuard(const ReadGuard&) = delete;
+			void operator = (const ReadGuard&) = delete;
+
+			friend class MultiVersionBuffer;
+		};
+
+		MultiVersionBuffer() : m_sequence(0), m_numStaged(0)
+		{
+			m_versions.emplace_back(new Version);
+			m_versions[0]->sequence = 0;
+			m_published = m_versions[0].get();
+			for(int i = 0; i < MAX_BUFFER_THREADS; ++i)
+			{
+				m_readers[i].oldest = UNPINNED;
+				m_readers[i].newest = UNPINNED;
+				m_readers[i].depth = 0;
+			}
+		}
+
+		/// \brief Stage an element for the next write. Can be called from any
+		///		thread.
+		/// \details Elements of different threads are not in the order of
+		///		their calls.
+		void Append(T _element)
+		{
+			StageLane& lane = m_lanes[Details::GetThreadSlot()];
+			std::lock_guard<std::mutex> lock(lane.mutex);
+			lane.elements.push_back(std::move(_element));
+			++m_numStaged;
+		}
+
+		/// \brief Are there elements waiting for the next write?
+		bool HasStaged() const	{ return m_numStaged.load() > 0; }
+
+		/// \brief Create and publish a new version by a replayable change.
+		/// \details _change receives the newest content and all staged
+		///		elements.
+		void Apply(Change _change)
+		{
+			Version* version = AcquireVersion();
+			CatchUp(version);
+
+			LogEntry entry;
+			entry.sequence = m_sequence + 1;
+			DrainStaged(entry.appended);
+			entry.change = std::move(_change);
+			entry.change(version->data, entry.appended);
+			m_log.push_back(std::move(entry));
+
+			Publish(version);
+		}
+
+		/// \brief Get a writable copy of the newest version.
+		/// \details The previous content of _out is published first. Staged
+		///		elements are appended at the end.
+		/// \param [in] _keepContent false: the version is empty instead of a
+		///		copy. Saves the copy if the content is rebuilt completely.
+		void GetWriteAccess(WriteGuard& _out, bool _keepContent = true)
+		{
+			_out = WriteGuard();
+			Version* version = AcquireVersion();
+			if(_keepContent)
+				CatchUp(version);
+			else version->data.clear();
+
+			std::vector<T> appended;
+			DrainStaged(appended);
+			version->data.insert(version->data.end(), std::make_move_iterator(appended.begin()), std::make_move_iterator(appended.end()));
+
+			// Arbitrary writes cannot be replayed
+			m_log.clear();
+			_out = WriteGuard(this, version);
+		}
+
+		/// \brief Get consistent access as long as the guard exists.
+		/// \details Lock free and never blocks the writer. Nested guards of
+		///		the same thread may see different versions.
+		ReadGuard GetReadAccess() const
+		{
+			ReaderSlot& slot = m_readers[Details::GetThreadSlot()];
+			bool outermost = slot.depth++ == 0;
+			while(true)
+			{
+				Version* version = m_published.load();
+				uint64_t sequence = version->sequence.load();
+				// Store newest before oldest: a writer which sees oldest also
+				// sees newest.
+				slot.newest.store(sequence);
+				if(outermost) slot.oldest.store(sequence);
+				// The writer could have recycled the version between load and pin.
+				if(m_published.load() == version)
+					return ReadGuard(version, &slot);
+			}
+		}
+
+	private:
+		static const uint64_t UNPINNED = ~uint64_t(0);
+		static const size_t MAX_LOG_LENGTH = 16;
+
+		struct Version
+		{
+			std::vector<T> data;
+			std::atomic<uint64_t> sequence;		///< Number of writes contained in data
+		};
+
+		/// \brief Versions a thread may reference: all with a sequence in
+		///		[oldest, newest]. Exactly one if guards are not nested.
+		struct ReaderSlot
+		{
+			std::atomic<uint64_t> oldest;
+			std::atomic<uint64_t> newest;
+			int depth;							///< Number of ReadGuards of the owning thread
+			char padding[64 - 2 * sizeof(std::atomic<uint64_t>) - sizeof(int)];	///< Avoid false sharing between readers
+		};
+
+		struct StageLane
+		{
+			std::mutex mutex;					///< Only contended while the writer drains the lane
+			std::vector<T> elements;
+		};
+
+		struct LogEntry
+		{
+			uint64_t sequence;					///< Sequence of the version the change produced
+			std::vector<T> appended;
+			Change change;
+		};
+
+		std::vector<std::unique_ptr<Version>> m_versions;	///< Owner of all versions
+		std::vector<Version*> m_retired;		///< Replaced versions (writer only)
+		std::atomic<Version*> m_published;		///< Newest complete version
+		uint64_t m_sequence;					///< Sequence of the published version (writer only)
+		std::deque<LogEntry> m_log;				///< Changes which retired versions may miss
+		mutable ReaderSlot m_readers[MAX_BUFFER_THREADS];
+		StageLane m_lanes[MAX_BUFFER_THREADS];
+		std::atomic<int> m_numStaged;
+
+		/// \brief Take the newest retired version which no reader pins or
+		///		create a new one.
+		Version* AcquireVersion()
+		{
+			int best = -1;
+			for(size_t i = 0; i < m_retired.size(); ++i)
+			{
+				uint64_t sequence = m_retired[i]->sequence.load();
+				if(IsPinned(sequence)) continue;
+				if(best == -1 || sequence > m_retired[best]->sequence.load())
+					best = (int)i;
+			}
+			if(best != -1)
+			{
+				Version* version = m_retired[best];
+				m_retired[best] = m_retired.back();
+				m_retired.pop_back();
+				return version;
+			}
+
+			// All retired versions are still read
+			m_versions.emplace_back(new Version);
+			m_versions.back()->sequence = 0;
+			return m_versions.back().get();
+		}
+
+		bool IsPinned(uint64_t _sequence) const
+		{
+			for(int i = 0; i < MAX_BUFFER_THREADS; ++i)
+			{
+				// Load oldest before newest (reverse of the reader's stores)
+				uint64_t oldest = m_readers[i].oldest.load();
+				if(oldest <= _sequence && _sequence <= m_readers[i].newest.load())
+					return true;
+			}
+			return false;
+		}
+
+		/// \brief Bring a recycled version up to the published content.
+		void CatchUp(Version* _version)
+		{
+			uint64_t sequence = _version->sequence.load();
+			if(sequence == m_sequence) return;
+			if(!m_log.empty() && m_log.front().sequence <= sequence + 1)
+			{
+				Assert(m_log.back().sequence == m_sequence, "The change log must reach the published version.");
+				for(auto& entry : m_log)
+					if(entry.sequence > sequence)
+						entry.change(_version->data, entry.appended);
+			} else
+				_version->data = m_published.load()->data;
+		}
+
+		void DrainStaged(std::vector<T>& _out)
+		{
+			if(m_numStaged.load() == 0) return;
+			for(int i = 0; i < MAX_BUFFER_THREADS; ++i)
+			{
+				std::lock_guard<std::mutex> lock(m_lanes[i].mutex);
+				m_numStaged -= (int)m_lanes[i].elements.size();
+				for(auto& it : m_lanes[i].elements)
+					_out.push_back(std::move(it));
+				m_lanes[i].elements.clear();
+			}
+		}
+
+		void Publish(Version* _version)
+		{
+			_version->sequence = ++m_sequence;
+			m_retired.push_back(m_published.exchange(_version));
+
+			// Drop the changes which all retired versions contain already
+			uint64_t oldest = m_sequence;
+			for(Version* it : m_retired)
+				oldest = std::min(oldest, it->sequence.load());
+			while(!m_log.empty() && (m_log.front().sequence <= oldest || m_log.size() > MAX_LOG_LENGTH))
+				m_log.pop_front();
+		}
+	};
+
+}
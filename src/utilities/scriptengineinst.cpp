@@ -1,3 +1,4 @@
 #include "scriptengineinst.hpp"
 
-NaReTi::ScriptEngine g_scriptEngine("scripts/");
\ No newline at end of file
+NaReTi::ScriptEngine g_scriptEngine("scripts/");
+std::mutex g_scriptMutex;
\ No newline at end of file
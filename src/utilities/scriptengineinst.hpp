@@ -2,6 +2,7 @@
 
 #include "scriptengine.hpp"
 #include "ei/vector.hpp"
+#include <mutex>
 
 namespace Script{
 	enum DisplayMode{
@@ -20,4 +21,7 @@ namespace Script{
 	typedef std::vector<Script::DisplayValue* const> VarRefContainer;
 }
 
-extern NaReTi::ScriptEngine g_scriptEngine;
\ No newline at end of file
+extern NaReTi::ScriptEngine g_scriptEngine;
+/// \brief Held during every script call. Scripts share the globals of their
+///		modules, so they must not run concurrently (e.g. from island jobs).
+extern std::mutex g_scriptMutex;
\ No newline at end of file
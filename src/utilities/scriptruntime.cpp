@@ -0,0 +1,192 @@
+#include "scriptruntime.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace Script {
+
+	std::chrono::duration<double> Function::s_callBudget(0.0001);
+	std::chrono::duration<double> Function::s_hangTime(0.05);
+	int Function::s_maxOverrunsInRow = 10;
+	std::atomic<bool> Function::s_deterministic(false);
+	std::atomic<Function*> Function::s_running(nullptr);
+	std::atomic<Function::Clock::rep> Function::s_runningSince(0);
+	std::mutex Runtime::s_mutex;
+	std::vector<std::unique_ptr<Function>> Runtime::s_functions;
+	std::thread Runtime::s_watchdog;
+	std::atomic<bool> Runtime::s_stopWatchdog(false);
+
+	// The watchdog looks at the running call this often (milliseconds)
+	const int WATCHDOG_INTERVAL = 10;
+
+	// ********************************************************************* //
+	Function::Function(const std::string& _name) :
+		m_name(_name),
+		m_calls(0),
+		m_totalTime(0),
+		m_maxTime(0),
+		m_overruns(0),
+		m_overrunsInRow(0),
+		m_disabled(false)
+	{
+	}
+
+	// ********************************************************************* //
+	bool Function::Resolve()
+	{
+		m_handle = g_scriptEngine.getFuncHndl(m_name);
+		m_overrunsInRow = 0;
+		m_disabled = false;
+		return m_handle;
+	}
+
+	// ********************************************************************* //
+	void Function::Record(Clock::duration _time)
+	{
+		int64_t ticks = _time.count();
+		++m_calls;
+		m_totalTime += ticks;
+		int64_t oldMax = m_maxTime.load();
+		while( ticks > oldMax && !m_maxTime.compare_exchange_weak(oldMax, ticks) ) {}
+
+		if( s_deterministic ) return;
+		if( _time > s_callBudget )
+		{
+			++m_overruns;
+			if( ++m_overrunsInRow >= s_maxOverrunsInRow && !m_disabled.exchange(true) )
+				LOG_ERROR("Script function " + m_name + " exceeded its time budget too often and was disabled.");
+		} else
+			m_overrunsInRow = 0;
+	}
+
+	// ********************************************************************* //
+	FunctionStats Function::GetStats() const
+	{
+		typedef std::chrono::duration<double> Seconds;
+		FunctionStats stats;
+		stats.name = m_name;
+		stats.calls = m_calls.load();
+		stats.totalTime = std::chrono::duration_cast<Seconds>(Clock::duration(m_totalTime.load())).count();
+		stats.maxTime = std::chrono::duration_cast<Seconds>(Clock::duration(m_maxTime.load())).count();
+		stats.overruns = m_overruns.load();
+		stats.disabled = m_disabled.load();
+		return stats;
+	}
+
+	// ********************************************************************* //
+	void Function::ResetStats()
+	{
+		m_calls = 0;
+		m_totalTime = 0;
+		m_maxTime = 0;
+		m_overruns = 0;
+	}
+
+	// ********************************************************************* //
+	void Runtime::Initialize(Jo::Files::MetaFileWrapper::Node& _config)
+	{
+		// Given in milliseconds
+		Function::s_callBudget = std::chrono::duration<double>(_config[std::string("CallTime")].Get(0.1) * 0.001);
+		Function::s_maxOverrunsInRow = std::max(1, _config[std::string("MaxOverruns")].Get(10));
+		Function::s_hangTime = std::chrono::duration<double>(_config[std::string("HangTime")].Get(50.0) * 0.001);
+
+		s_stopWatchdog = false;
+		s_watchdog = std::thread(&Runtime::Watch);
+	}
+
+	// ********************************************************************* //
+	void Runtime::Close()
+	{
+		s_stopWatchdog = true;
+		if( s_watchdog.joinable() )
+			s_watchdog.join();
+	}
+
+	// ********************************************************************* //
+	void Runtime::Watch()
+	{
+		Function::Clock::rep reportedCall = 0;
+		while( !s_stopWatchdog.load() )
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(WATCHDOG_INTERVAL));
+			Function::Clock::rep since = Function::s_runningSince.load();
+			Function* function = Function::s_running.load();
+			// Skip if no call is running, it was reported already or a new
+			// one started in between.
+			if( !function || since == reportedCall || since != Function::s_runningSince.load() )
+				continue;
+			Function::Clock::time_point start((Function::Clock::duration(since)));
+			if( Function::Clock::now() - start < Function::s_hangTime )
+				continue;
+
+			reportedCall = since;
+			// Compiled scripts cannot be stopped. Disabling at least prevents
+			// the next calls of a function which got stuck.
+			if( Function::s_deterministic )
+				LOG_ERROR("Script function " + function->m_name + " exceeds the hang time. It stays enabled in deterministic mode.");
+			else if( !function->m_disabled.exchange(true) )
+				LOG_ERROR("Script function " + function->m_name + " exceeds the hang time and was disabled. The caller waits until the running call returns.");
+		}
+	}
+
+	// ********************************************************************* //
+	void Runtime::SetDeterministic(bool _deterministic)
+	{
+		Function::s_deterministic = _deterministic;
+		// Overruns from before must not disable a function later
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for( auto& function : s_functions )
+			function->m_overrunsInRow = 0;
+	}
+
+	// ********************************************************************* //
+	Function& Runtime::GetFunction(const std::string& _name)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for( auto& function : s_functions )
+			if( function->m_name == _name )
+				return *function;
+		s_functions.emplace_back(new Function(_name));
+		return *s_functions.back();
+	}
+
+	// ********************************************************************* //
+	std::vector<FunctionStats> Runtime::GetStats()
+	{
+		std::vector<FunctionStats> stats;
+		{
+			std::lock_guard<std::mutex> lock(s_mutex);
+			for( auto& function : s_functions )
+				stats.push_back(function->GetStats());
+		}
+		std::sort(stats.begin(), stats.end(), [](const FunctionStats& _a, const FunctionStats& _b){
+			return _a.totalTime > _b.totalTime;
+		});
+		return stats;
+	}
+
+	// ********************************************************************* //
+	void Runtime::ResetStats()
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for( auto& function : s_functions )
+			function->ResetStats();
+	}
+
+	// ********************************************************************* //
+	void Runtime::LogStats()
+	{
+		for( auto& stats : GetStats() )
+		{
+			if( !stats.calls ) continue;
+			std::ostringstream line;
+			line << "Script " << stats.name << ": " << stats.calls << " calls, "
+				<< stats.totalTime * 1000.0 << " ms total, "
+				<< stats.totalTime * 1e6 / stats.calls << " us average, "
+				<< stats.maxTime * 1e6 << " us max, " << stats.overruns << " overruns"
+				<< (stats.disabled ? ", disabled" : "");
+			LOG_LVL1(line.str());
+		}
+	}
+
+} // namespace Script
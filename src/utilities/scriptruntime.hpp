@@ -0,0 +1,143 @@
+#pragma once
+
+#include "scriptengineinst.hpp"
+#include <jofilelib.hpp>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Script {
+
+	/// \brief Snapshot of the statistics of one script function.
+	struct FunctionStats
+	{
+		std::string name;
+		uint64_t calls;
+		double totalTime;			///< In seconds
+		double maxTime;				///< Longest single call
+		uint64_t overruns;			///< Calls which exceeded the budget
+		bool disabled;
+	};
+
+	/// \brief A script entry point which is called with profiling and a time
+	///		budget.
+	/// \details Scripts are compiled to native code and can not be
+	///		interrupted. Instead the duration of each call is compared to the
+	///		budget. A function which exceeds it too often in a row is disabled
+	///		until it is resolved again, so the callers must handle that case
+	///		with a native fallback. Additionally a watchdog thread disables a
+	///		function as soon as one call runs longer than the hang time. The
+	///		hanging call itself still blocks its caller until it returns.
+	///
+	///		In deterministic mode (replays) the calls are only profiled. The
+	///		wall-clock time must not change which code runs.
+	///
+	///		Statistics are atomic: functions may be called from jobs. The
+	///		calls themselves hold g_scriptMutex.
+	class Function
+	{
+	public:
+		typedef std::chrono::high_resolution_clock Clock;
+
+		const std::string& GetName() const	{ return m_name; }
+
+		/// \brief Get the handle from the script engine again and reset the
+		///		overrun state. Call after a module was (re)loaded.
+		/// \return false if there is no such function.
+		bool Resolve();
+
+		/// \brief The function exists and was not disabled.
+		bool IsEnabled() const				{ return m_handle && !m_disabled.load(); }
+
+		/// \brief Timed call of the script.
+		/// \return false if the function is disabled and was not called.
+		template<typename... Args>
+		bool Call(Args... _args)
+		{
+			if( !IsEnabled() ) return false;
+			std::lock_guard<std::mutex> lock(g_scriptMutex);
+			Clock::time_point start = Clock::now();
+			// Announce the call to the watchdog
+			s_runningSince = start.time_since_epoch().count();
+			s_running = this;
+			g_scriptEngine.call<void, Args...>(m_handle, _args...);
+			s_running = nullptr;
+			Record(Clock::now() - start);
+			return true;
+		}
+
+		FunctionStats GetStats() const;
+		void ResetStats();
+	private:
+		Function(const std::string& _name);
+
+		/// \brief Add the time of a call and check the budget.
+		void Record(Clock::duration _time);
+
+		std::string m_name;
+		NaReTi::FunctionHandle m_handle;
+		std::atomic<uint64_t> m_calls;
+		std::atomic<int64_t> m_totalTime;	///< In clock ticks
+		std::atomic<int64_t> m_maxTime;		///< In clock ticks
+		std::atomic<uint64_t> m_overruns;
+		std::atomic<int> m_overrunsInRow;
+		std::atomic<bool> m_disabled;
+
+		static std::chrono::duration<double> s_callBudget;
+		static std::chrono::duration<double> s_hangTime;
+		static int s_maxOverrunsInRow;
+		static std::atomic<bool> s_deterministic;
+		static std::atomic<Function*> s_running;		///< The function which is called right now or nullptr
+		static std::atomic<Clock::rep> s_runningSince;	///< Start of the current call
+
+		Function(const Function&) = delete;
+		void operator = (const Function&) = delete;
+
+		friend class Runtime;
+	};
+
+	/// \brief Registry of all profiled script functions.
+	class Runtime
+	{
+	public:
+		/// \brief Read the budget from the config (Game.ScriptBudget) and
+		///		start the watchdog.
+		static void Initialize(Jo::Files::MetaFileWrapper::Node& _config);
+
+		/// \brief Stop the watchdog.
+		static void Close();
+
+		/// \brief Enable or disable the budget enforcement.
+		/// \details Must be enabled while input is recorded or replayed.
+		///		Otherwise a slower machine skips or disables different script
+		///		calls and the replay diverges.
+		/// \param [in] _deterministic true: never skip calls or disable
+		///		functions because of their run time.
+		static void SetDeterministic(bool _deterministic);
+
+		/// \brief Get the entry of a script function and create it if it is
+		///		used the first time. The reference stays valid.
+		/// \details Not resolved yet if created now.
+		static Function& GetFunction(const std::string& _name);
+
+		/// \brief Statistics of all functions ordered by total time.
+		static std::vector<FunctionStats> GetStats();
+		static void ResetStats();
+
+		/// \brief Write the statistics into the log.
+		static void LogStats();
+	private:
+		static std::mutex s_mutex;
+		static std::vector<std::unique_ptr<Function>> s_functions;
+		static std::thread s_watchdog;
+		static std::atomic<bool> s_stopWatchdog;
+
+		/// \brief Main loop of the watchdog thread.
+		static void Watch();
+	};
+
+} // namespace Script
@@ -8,6 +8,8 @@
 namespace Utils {
 	/// \brief A dynamic array wrapper (vector) for thread safe concurrent read and
 	///		write accesses
+	/// \details Superseded by MultiVersionBuffer. Kept as reference for
+	///		RunBufferBenchmark().
 	template<typename T>
 	class ThreadSafeBuffer
 	{
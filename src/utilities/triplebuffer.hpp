@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+
+namespace Utils {
+	/// \brief Lock free handoff of complete values from one producer thread to
+	///		one consumer thread.
+	/// \details The producer always owns one slot to write into, the consumer
+	///		one slot to read from and the third slot holds the most recently
+	///		published value. Publish() and Acquire() swap their slot with the
+	///		middle one, so neither thread ever waits for the other. Values
+	///		which were never acquired are overwritten by newer ones.
+	///
+	///		Slots are recycled: if T holds containers they keep their capacity.
+	template<typename T>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer() : m_writeSlot(0), m_middle(1), m_readSlot(2) {}
+
+		/// \brief Slot which the producer may fill. The content is whatever
+		///		was published some time ago.
+		T& GetWriteBuffer()					{ return m_slots[m_writeSlot]; }
+
+		/// \brief Make the write buffer the newest value.
+		void Publish()
+		{
+			m_writeSlot = m_middle.exchange(m_writeSlot | NEW_FLAG) & INDEX_MASK;
+		}
+
+		/// \brief Take the newest published value if there is any.
+		/// \return false if nothing was published since the last call. The
+		///		read buffer is unchanged then.
+		bool Acquire()
+		{
+			if( !(m_middle.load() & NEW_FLAG) ) return false;
+			m_readSlot = m_middle.exchange(m_readSlot) & INDEX_MASK;
+			return true;
+		}
+
+		/// \brief The value of the last successful Acquire().
+		const T& GetReadBuffer() const		{ return m_slots[m_readSlot]; }
+	private:
+		static const int INDEX_MASK = 3;
+		static const int NEW_FLAG = 4;		///< The middle slot was not acquired yet
+
+		T m_slots[3];
+		int m_writeSlot;					///< Only used by the producer
+		std::atomic<int> m_middle;			///< Slot index and NEW_FLAG
+		int m_readSlot;						///< Only used by the consumer
+	};
+
+} // namespace Utils
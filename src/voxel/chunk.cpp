@@ -74,29 +74,42 @@ namespace Voxel {
 
 
 	void Chunk::Draw( const Mat4x4& _modelView, const Mat4x4& _projection )
+	{
+		Draw( &_modelView, 1, _projection );
+	}
+
+	void Chunk::Draw( const Mat4x4* _modelViews, int _numInstances, const Mat4x4& _projection )
 	{
 		Graphic::UniformBuffer& objectConstants = Graphic::Resources::GetUBO(Graphic::UniformBuffers::OBJECT_VOXEL);
 		// Translation to center the chunks
-		Mat4x4 modelView = _modelView * scalingH(m_scale) * translation(m_position);
-		objectConstants["WorldView"] = modelView;
-		objectConstants["InverseWorldView"] = invert(modelView);
-		Mat4x4 modelViewProjection = _projection * modelView;
-
-		Vec4 c000 = modelViewProjection * Vec4( -0.5f, -0.5f, -0.5f, 0.0f );
-		Vec4 c001 = modelViewProjection * Vec4( -0.5f, -0.5f,  0.5f, 0.0f );
-		Vec4 c010 = modelViewProjection * Vec4( -0.5f,  0.5f, -0.5f, 0.0f );
-		Vec4 c011 = modelViewProjection * Vec4( -0.5f,  0.5f,  0.5f, 0.0f );
-		objectConstants["Corner000"] = c000;
-		objectConstants["Corner001"] = c001;
-		objectConstants["Corner010"] = c010;
-		objectConstants["Corner011"] = c011;
-		objectConstants["Corner100"] = modelViewProjection * Vec4(  0.5f, -0.5f, -0.5f, 0.0f );
-		objectConstants["Corner101"] = modelViewProjection * Vec4(  0.5f, -0.5f,  0.5f, 0.0f );
-		objectConstants["Corner110"] = modelViewProjection * Vec4(  0.5f,  0.5f, -0.5f, 0.0f );
-		objectConstants["Corner111"] = modelViewProjection * Vec4(  0.5f,  0.5f,  0.5f, 0.0f );
-		objectConstants["MaxOffset"] = max(len(c000), len(c001), len(c010), len(c011));
-
-		Graphic::Device::DrawVertices( m_voxels, 0, m_voxels.GetNumVertices() );
+		Mat4x4 chunkTransformation = scalingH(m_scale) * translation(m_position);
+		for( int first = 0; first < _numInstances; first += Graphic::MAX_VOXEL_INSTANCES )
+		{
+			int num = min(_numInstances - first, Graphic::MAX_VOXEL_INSTANCES);
+			for( int i = 0; i < num; ++i )
+			{
+				Mat4x4 modelView = _modelViews[first + i] * chunkTransformation;
+				objectConstants.Get("WorldView", i) = modelView;
+				objectConstants.Get("InverseWorldView", i) = invert(modelView);
+				Mat4x4 modelViewProjection = _projection * modelView;
+
+				Vec4 c000 = modelViewProjection * Vec4( -0.5f, -0.5f, -0.5f, 0.0f );
+				Vec4 c001 = modelViewProjection * Vec4( -0.5f, -0.5f,  0.5f, 0.0f );
+				Vec4 c010 = modelViewProjection * Vec4( -0.5f,  0.5f, -0.5f, 0.0f );
+				Vec4 c011 = modelViewProjection * Vec4( -0.5f,  0.5f,  0.5f, 0.0f );
+				objectConstants.Get("Corner000", i) = c000;
+				objectConstants.Get("Corner001", i) = c001;
+				objectConstants.Get("Corner010", i) = c010;
+				objectConstants.Get("Corner011", i) = c011;
+				objectConstants.Get("Corner100", i) = modelViewProjection * Vec4(  0.5f, -0.5f, -0.5f, 0.0f );
+				objectConstants.Get("Corner101", i) = modelViewProjection * Vec4(  0.5f, -0.5f,  0.5f, 0.0f );
+				objectConstants.Get("Corner110", i) = modelViewProjection * Vec4(  0.5f,  0.5f, -0.5f, 0.0f );
+				objectConstants.Get("Corner111", i) = modelViewProjection * Vec4(  0.5f,  0.5f,  0.5f, 0.0f );
+				objectConstants.Get("MaxOffset", i) = max(len(c000), len(c001), len(c010), len(c011));
+			}
+
+			Graphic::Device::DrawVerticesInstanced( m_voxels, 0, m_voxels.GetNumVertices(), num );
+		}
 
 		// Set the time stamp for the garbage collection
 		m_lastRendered = Monolith::Time();
@@ -231,8 +244,15 @@ namespace Voxel {
 	// ********************************************************************* //
 	void ChunkBuilder::RecomputeVertexBuffer( Chunk& _chunk )
 	{
-		VoxelVertex* vertexBuffer = (VoxelVertex*)malloc(CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE*sizeof(VoxelVertex));
+		UpdateSubtree( _chunk );
+		int numVoxels;
+		VoxelVertex* vertexBuffer = FillVertices( _chunk, numVoxels );
+		Upload( _chunk, vertexBuffer, numVoxels );
+	}
 
+	// ********************************************************************* //
+	void ChunkBuilder::UpdateSubtree( Chunk& _chunk )
+	{
 		// If it is dirty update the subtree
 		Model::ModelData::SVON* node = _chunk.m_modelData->Get( IVec3(_chunk.m_root), _chunk.m_root[3] );
 		if( node->Data().IsDirty() )
@@ -246,6 +266,13 @@ namespace Voxel {
 				_chunk.m_modelData->Get( IVec3(_chunk.m_root[0]  , _chunk.m_root[1]  , _chunk.m_root[2]-1), _chunk.m_root[3] ),
 				_chunk.m_modelData->Get( IVec3(_chunk.m_root[0]  , _chunk.m_root[1]  , _chunk.m_root[2]+1), _chunk.m_root[3] ) );
 		}
+	}
+
+	// ********************************************************************* //
+	VoxelVertex* ChunkBuilder::FillVertices( Chunk& _chunk, int& _numVoxels ) const
+	{
+		VoxelVertex* vertexBuffer = (VoxelVertex*)malloc(CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE*sizeof(VoxelVertex));
+		Model::ModelData::SVON* node = _chunk.m_modelData->Get( IVec3(_chunk.m_root), _chunk.m_root[3] );
 
 		// Newest method O(k): run over surface only
 		FillBuffer FillP;
@@ -256,11 +283,17 @@ namespace Voxel {
 		// These extra voxels solve a problem when deleting things in a neighbor chunk.
 		// Without there would be noticeable holes due to not updating this chunk.
 		node->Traverse( _chunk.m_root, FillP );
-		int numVoxels = int(FillP.appendBuffer - vertexBuffer);
+		_numVoxels = int(FillP.appendBuffer - vertexBuffer);
+		return vertexBuffer;
+	}
 
-		if( numVoxels )
-			_chunk.m_voxels.GetBuffer(0)->SetData((void*&)vertexBuffer, numVoxels * sizeof(VoxelVertex));
-		else free(vertexBuffer);
+	// ********************************************************************* //
+	void ChunkBuilder::Upload( Chunk& _chunk, VoxelVertex*& _vertices, int _numVoxels )
+	{
+		if( _numVoxels )
+			_chunk.m_voxels.GetBuffer(0)->SetData((void*&)_vertices, _numVoxels * sizeof(VoxelVertex));
+		else free(_vertices);
+		_vertices = nullptr;
 	}
 
 }
\ No newline at end of file
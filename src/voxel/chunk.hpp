@@ -79,6 +79,15 @@ namespace Voxel {
 		/// \param [in] _time Current game time.
 		void Draw( const ei::Mat4x4& _modelView, const ei::Mat4x4& _projection );
 
+		/// \brief Draw the chunk for multiple instances of the same model.
+		/// \details Fills one element of the constant buffer per instance and
+		///		issues one instanced draw call per Graphic::MAX_VOXEL_INSTANCES
+		///		instances.
+		/// \param [in] _modelViews Array of view matrices (one per instance).
+		///		They should contain the model transformations too.
+		/// \param [in] _numInstances Number of matrices in _modelViews.
+		void Draw( const ei::Mat4x4* _modelViews, int _numInstances, const ei::Mat4x4& _projection );
+
 		/// \brief Set position relative to the model.
 		//void SetPosition( const Math::Vec3& _position )	{ m_position = _position; }
 
@@ -122,11 +131,30 @@ namespace Voxel {
 	/// \brief A class to recompute the vertex buffers of chunks.
 	/// \details This class contains buffers which are reused in each chunk
 	///		rebuild such that less allocations and memory are required.
+	///
+	///		A rebuild has three steps. UpdateSubtree() writes to the octree
+	///		and must not run concurrently for chunks of the same model.
+	///		FillVertices() only reads and can run in any job. Upload()
+	///		requires the GL context.
 	class ChunkBuilder
 	{
 	public:
+		/// \brief Do all three steps at once.
 		void RecomputeVertexBuffer( Chunk& _chunk );
 
+		/// \brief Recompute materials and visibility of a dirty subtree.
+		void UpdateSubtree( Chunk& _chunk );
+
+		/// \brief Collect the surface voxels of the chunk.
+		/// \param [out] _numVoxels Number of filled vertices.
+		/// \return A malloc'ed buffer which must be passed to Upload().
+		VoxelVertex* FillVertices( Chunk& _chunk, int& _numVoxels ) const;
+
+		/// \brief Commit the vertices to the chunk's vertex buffer.
+		/// \param [inout] _vertices The buffer from FillVertices(). Ownership is
+		///		taken and the pointer is invalidated.
+		void Upload( Chunk& _chunk, VoxelVertex*& _vertices, int _numVoxels );
+
 		/// \brief Information from the target volume out of the octree
 		struct PerVoxelInfo {
 			ComponentType type;	///< type of the target voxel -> texture.
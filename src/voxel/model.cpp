@@ -1,11 +1,17 @@
 #include "model.hpp"
 #include "chunk.hpp"
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include "input/camera.hpp"
 #include "graphic/core/uniformbuffer.hpp"
 #include "graphic/content.hpp"
 #include "exceptions.hpp"
 #include "algorithm/hashmap.hpp"
+#include "sparsevoxeldag.hpp"
+#include "utilities/logger.hpp"
+#include "utilities/jobsystem.hpp"
+#include <mutex>
 
 //test
 #include "../timer.hpp"
@@ -25,6 +31,12 @@ namespace Voxel {
 	// physically correct would be 0
 	const float ROTATE_VELOCITY_COUPLING = 0.7f;
 
+	// velocities below which a model is considered to be resting
+	const float SLEEP_LINEAR_VELOCITY = 0.05f;	// m/s
+	const float SLEEP_ANGULAR_VELOCITY = 0.01f;	// rad/s
+
+	bool Model::s_reportDeduplication = false;
+
 	Model::Model() :
 		m_numVoxels(0),
 		m_mass(0.0f),
@@ -32,11 +44,13 @@ namespace Voxel {
 		m_oldCenter(0.0f),
 		m_boundingSphereRadius(0.0f),
 		m_voxelTree(this),
+		m_inBatch(false),
 		m_chunks(),
 		m_rotateVelocity(false),
+		m_timeOfImpact(std::numeric_limits<float>::infinity()),
 		m_angularVelocity(0.f)
 	{
-		auto x = IVec3(3) * 0.5f;
+		SetType(SOType::MODEL, SOCapability::VOXEL_MODEL);
 	}
 
 	Model::~Model()
@@ -50,6 +64,8 @@ namespace Voxel {
 		Model::ModelData* model;						// Operate on this data.
 		std::unordered_map<IVec4, Chunk>* chunks;	// Create or find chunks here.
 		const Mat4x4& modelView;
+		std::vector<Chunk*> visibleChunks;			// Chunks to be drawn after all are built.
+		std::vector<Chunk*> newChunks;				// Chunks without vertex buffer.
 
 		DecideToDraw(const Input::Camera& _camera,
 				Model::ModelData* _model,
@@ -92,21 +108,15 @@ namespace Voxel {
 				auto chunk = chunks->find(position);
 				if( chunk == chunks->end() )
 				{
-					// Chunk does not exist -> create
-					ChunkBuilder builder; // TEMP -> in job verschieben
+					// Chunk does not exist -> create. The vertex buffer is
+					// built after the traversal.
 					chunk = chunks->insert(
 						std::make_pair(position, std::move(Chunk(model, _position, levels)))
 						).first;
-					builder.RecomputeVertexBuffer(chunk->second);
+					newChunks.push_back(&chunk->second);
 				}// else Assert( !_node->Data().IsDirty(), "Node-data was not changed."); //if( _node->Data().IsDirty() )
 					//builder->RecomputeVertexBuffer(chunk->second);
-				// There are empty inner chunks
-				if( chunk->second.NumVoxels() > 0 )
-				{
-					RenderStat::g_numVoxels += chunk->second.NumVoxels();
-					RenderStat::g_numChunks++;
-					chunk->second.Draw( modelView, camera.GetProjection() );
-				}
+				visibleChunks.push_back(&chunk->second);
 				return false;
 			}
 			return true;
@@ -115,23 +125,110 @@ namespace Voxel {
 
 	// ********************************************************************* //
 	void Model::Draw( const Input::Camera& _camera )
+	{
+		Draw( _camera, *this );
+	}
+
+	void Model::Draw( const Input::Camera& _camera, const Math::Transformation& _pose )
+	{
+		// Instances draw the shared chunks of their source
+		Model* self = this;
+		GetChunkOwner()->DrawInstances( _camera, &self, &_pose, 1 );
+	}
+
+	void Model::DrawBatch( const Input::Camera& _camera, Model* const* _models, const Math::Transformation* _poses, int _num )
+	{
+		// Sort such that all models with the same chunk owner are adjacent
+		std::vector<int> order(_num);
+		for( int i = 0; i < _num; ++i ) order[i] = i;
+		std::sort( order.begin(), order.end(), [_models](int _a, int _b) {
+			return _models[_a]->GetChunkOwner() < _models[_b]->GetChunkOwner();
+		});
+
+		std::vector<Model*> instances;
+		std::vector<Math::Transformation> poses;
+		for( int first = 0; first < _num; )
+		{
+			Model* source = _models[order[first]]->GetChunkOwner();
+			instances.clear();
+			poses.clear();
+			for( ; first < _num && _models[order[first]]->GetChunkOwner() == source; ++first )
+			{
+				instances.push_back( _models[order[first]] );
+				poses.push_back( _poses[order[first]] );
+			}
+			source->DrawInstances( _camera, instances.data(), poses.data(), (int)instances.size() );
+		}
+	}
+
+	void Model::DrawInstances( const Input::Camera& _camera, Model* const* _instances, const Math::Transformation* _poses, int _num )
 	{
 		// Delete all invalid and old chunks
 		ClearChunkCache();
 
-		// Create a new model space transformation
-		Mat4x4 modelView;
-		GetModelMatrix( modelView, _camera );
+		// Iterate through the octree and find chunks depending on the lod.
+		// Each instance has its own culling and LOD, so they may select
+		// different chunks.
+		std::vector<Mat4x4> modelViews(_num);
+		std::vector<std::pair<Chunk*, int>> visibleChunks;
+		std::vector<Chunk*> newChunks;
+		for( int i = 0; i < _num; ++i )
+		{
+			_instances[i]->GetModelMatrix( modelViews[i], _camera, _poses[i] );
+			DecideToDraw param( _camera, &m_voxelTree, &m_chunks, modelViews[i] );
+			m_voxelTree.Traverse( param );
+			newChunks.insert( newChunks.end(), param.newChunks.begin(), param.newChunks.end() );
+			for( Chunk* chunk : param.visibleChunks )
+				visibleChunks.push_back( std::make_pair(chunk, i) );
+		}
+
+		// Build new chunks. Dirty subtrees are updated in place first, then
+		// the surfaces are collected in parallel and uploaded by this thread
+		// which owns the GL context.
+		if( !newChunks.empty() )
+		{
+			Assert( Utils::JobSystem::IsMainThread(), "Chunks must be uploaded by the thread owning the GL context." );
+			ChunkBuilder builder;
+			for( Chunk* chunk : newChunks )
+				builder.UpdateSubtree( *chunk );
+
+			std::vector<VoxelVertex*> vertices(newChunks.size());
+			std::vector<int> numVoxels(newChunks.size());
+			Utils::JobCounter fillCounter;
+			for( size_t i = 0; i < newChunks.size(); ++i )
+				Utils::JobSystem::Run([&, i](){
+					vertices[i] = builder.FillVertices( *newChunks[i], numVoxels[i] );
+				}, &fillCounter);
+			Utils::JobSystem::Wait(fillCounter);
+			for( size_t i = 0; i < newChunks.size(); ++i )
+				builder.Upload( *newChunks[i], vertices[i], numVoxels[i] );
+		}
 
-		// Iterate through the octree and render chunks depending on the lod.
-		DecideToDraw param( _camera, &this->m_voxelTree, &this->m_chunks, modelView );
-		m_voxelTree.Traverse( param );
+		// Draw each chunk once for all instances which selected it
+		std::sort( visibleChunks.begin(), visibleChunks.end() );
+		std::vector<Mat4x4> chunkModelViews;
+		for( size_t first = 0; first < visibleChunks.size(); )
+		{
+			Chunk* chunk = visibleChunks[first].first;
+			chunkModelViews.clear();
+			for( ; first < visibleChunks.size() && visibleChunks[first].first == chunk; ++first )
+				chunkModelViews.push_back( modelViews[visibleChunks[first].second] );
+
+			// There are empty inner chunks
+			if( chunk->NumVoxels() > 0 )
+			{
+				int numInstances = (int)chunkModelViews.size();
+				RenderStat::g_numVoxels += chunk->NumVoxels() * numInstances;
+				RenderStat::g_numChunks += numInstances;
+				chunk->Draw( chunkModelViews.data(), numInstances, _camera.GetProjection() );
+			}
+		}
 	}
 
 	// ********************************************************************* //
 	ComponentType Model::Get( const IVec3& _position ) const
 	{
-		auto node = m_voxelTree.Get(_position, 0);
+		auto node = GetVoxelTree().Get(_position, 0);
 		if( node ) return node->Data().type;
 		
 		return ComponentType::UNDEFINED;
@@ -141,8 +238,9 @@ namespace Voxel {
 	void Model::Damage(const ei::IVec3& _position, uint32_t _damage)
 	{
 		//temporary; todo: only register damage and perform step later
+		if (!GetVoxelTree().Get(_position, 0)) return;
+		MakeUnique();
 		auto node = m_voxelTree.Get(_position, 0);
-		if (!node) return;
 		Voxel& voxel = node->Data();
 
 		if (_damage >= voxel.health)
@@ -151,6 +249,117 @@ namespace Voxel {
 			m_hasTakenDamage = true;
 		}
 		voxel.health -= _damage;
+		// Cohesion and physical properties need to be rechecked
+		WakeUp();
+	}
+
+	// ********************************************************************* //
+	int Model::DamageRegion(const Math::FixVec3& _center, float _radius, float _energy, float _falloff)
+	{
+		if( m_numVoxels <= 0 || _radius <= 0.0f ) return 0;
+		MakeUnique();
+
+		// Apply all health changes in place and collect destroyed voxels
+		struct DamageProcessor: public ModelData::SVOProcessor
+		{
+			Vec3 center;
+			float radius;
+			float energy;
+			float falloff;
+			std::vector<IVec3> destroyed;
+
+			bool PreTraversal(const IVec4& _position, ModelData::SVON* _node)
+			{
+				if( _position[3] > 0 ) return true;
+				float distance = len(Vec3(IVec3(_position)) + 0.5f - center);
+				if( distance >= radius ) return false;
+				float damage = energy * pow(1.0f - distance / radius, falloff);
+				Voxel& voxel = _node->Data();
+				if( damage >= voxel.health )
+					destroyed.push_back(IVec3(_position));
+				else voxel.health -= (uint16_t)damage;
+				return false;
+			}
+			void PostTraversal(const IVec4& _position, ModelData::SVON* _node)	{}
+		} proc;
+		proc.center = Transform(_center) + m_center;
+		proc.radius = _radius;
+		proc.energy = _energy;
+		proc.falloff = _falloff;
+		m_voxelTree.TraverseRegion( SphereRegion(proc.center, _radius), proc );
+
+		if( !proc.destroyed.empty() )
+		{
+			BeginBatch();
+			m_voxelTree.SetBatch( proc.destroyed.data(), (int)proc.destroyed.size(), 0, Voxel::UNDEFINED );
+			EndBatch();
+			m_hasTakenDamage = true;
+		}
+		// Cohesion and physical properties need to be rechecked
+		WakeUp();
+
+		return (int)proc.destroyed.size();
+	}
+
+	// ********************************************************************* //
+	void Model::InstanceOf( const std::shared_ptr<Model>& _source )
+	{
+		Assert(m_numVoxels == 0 && !m_instanceSource, "Only empty models can become instances.");
+		Assert(!_source->m_instanceSource, "Instances of instances are not supported.");
+
+		m_instanceSource = _source;
+		m_numVoxels = _source->m_numVoxels;
+		m_center = _source->m_center;
+		m_oldCenter = _source->m_oldCenter;
+		m_mass = _source->m_mass;
+		m_inertiaTensor = _source->m_inertiaTensor;
+		m_inertiaTensorInverse = _source->m_inertiaTensorInverse;
+		m_inertiaX_Y_Z = _source->m_inertiaX_Y_Z;
+		m_inertiaXY_XZ_YZ = _source->m_inertiaXY_XZ_YZ;
+		m_inertiaXYR_XZR_YZR = _source->m_inertiaXYR_XZR_YZR;
+		m_boundingSphereRadius = _source->m_boundingSphereRadius;
+		m_position = _source->m_position;
+		SetRotation( _source->m_rotation );
+		ComputeBoundingBox();
+	}
+
+	// ********************************************************************* //
+	void Model::MakeUnique()
+	{
+		if( !m_instanceSource ) return;
+
+		// Mass properties are already equal, only the voxels are missing
+		m_voxelTree.CopyFrom( m_instanceSource->m_voxelTree );
+		m_instanceSource = nullptr;
+	}
+
+	// ********************************************************************* //
+	std::shared_ptr<Model> Model::LoadShared( const std::string& _fileName )
+	{
+		static std::mutex s_cacheMutex;
+		static std::unordered_map<std::string, std::weak_ptr<Model>> s_cache;
+
+		std::lock_guard<std::mutex> lock(s_cacheMutex);
+		std::shared_ptr<Model> source = s_cache[_fileName].lock();
+		if( !source )
+		{
+			source = std::make_shared<Model>();
+			source->Load( Jo::Files::HDDFile(_fileName) );
+			source->ReportDeduplication( _fileName );
+			s_cache[_fileName] = source;
+		}
+		return source;
+	}
+
+	// ********************************************************************* //
+	void Model::ReportDeduplication( const std::string& _name ) const
+	{
+		if( !s_reportDeduplication ) return;
+		SparseVoxelDAG<Voxel> dag;
+		dag.Build( GetVoxelTree() );
+		LOG_LVL1("Voxel DAG of " + _name + ": " + std::to_string(dag.NumTreeNodes()) + " tree nodes -> "
+			+ std::to_string(dag.NumNodes()) + " DAG nodes (ratio " + std::to_string(dag.GetDedupRatio()) + "), "
+			+ std::to_string(dag.TreeMemoryConsumption()) + " B -> " + std::to_string(dag.MemoryConsumption()) + " B");
 	}
 
 	// ********************************************************************* //
@@ -161,15 +370,20 @@ namespace Voxel {
 	}
 
 	Mat4x4& Model::GetModelMatrix( Mat4x4& _out, const Input::Camera& _reference ) const
+	{
+		return GetModelMatrix( _out, _reference, *this );
+	}
+
+	Mat4x4& Model::GetModelMatrix( Mat4x4& _out, const Input::Camera& _reference, const Math::Transformation& _pose ) const
 	{
 		if( this == _reference.GetAttachedModel() )
 		{
 			_out = rotationH(_reference.Transformation().GetRotation())
 				 * translation(_reference.GetReferencePosition())
-				 * rotationH(m_rotation)
+				 * rotationH(_pose.GetRotation())
 				 * translation(-m_center);
 		} else {
-			_out = GetTransformation(_reference.Transformation()) * translation(-m_center);
+			_out = _pose.GetTransformation(_reference.Transformation()) * translation(-m_center);
 		}
 		return _out;
 	}
@@ -178,9 +392,15 @@ namespace Voxel {
 	// ********************************************************************* //
 	void Model::Update( const IVec4& _position, const Voxel& _oldType, const Voxel& _newType )
 	{
+		if( m_inBatch )
+		{
+			VoxelChange change = { _position, _oldType, _newType };
+			m_batchChanges.push_back(change);
+			return;
+		}
+
 		// Compute real volume from logarithmic size
 		int size = 1 << _position[3];
-		float voxelSurface = size * size / 6.0f;
 		Vec3 center = IVec3(_position) * size + size * 0.5f;
 		int volume = size * size * size;
 
@@ -192,16 +412,7 @@ namespace Voxel {
 			m_mass -= oldMass;
 			m_numVoxels -= volume;
 		//	Assert(m_numVoxels >= 0, "Yeah!");
-
-			// Update inertia helper variables
-			m_inertiaX_Y_Z += oldMass * center;
-			m_inertiaXY_XZ_YZ[0] += oldMass * center[0] * center[1];
-			m_inertiaXY_XZ_YZ[1] += oldMass * center[0] * center[2];
-			m_inertiaXY_XZ_YZ[2] += oldMass * center[1] * center[2];
-			Vec3 centerSq = center * center; 
-			m_inertiaXYR_XZR_YZR[0] += oldMass * (centerSq[0] + centerSq[1] + voxelSurface);
-			m_inertiaXYR_XZR_YZR[1] += oldMass * (centerSq[0] + centerSq[2] + voxelSurface);
-			m_inertiaXYR_XZR_YZR[2] += oldMass * (centerSq[1] + centerSq[2] + voxelSurface);
+			AddInertiaTerms( _position, oldMass );
 		}
 
 		// Add new voxel
@@ -211,21 +422,90 @@ namespace Voxel {
 			m_center = (m_center * m_mass + center * newMass) / (m_mass + newMass);
 			m_mass += newMass;
 			m_numVoxels += volume;
-
-			// Update inertia helper variables
-			m_inertiaX_Y_Z += newMass * center;
-			m_inertiaXY_XZ_YZ[0] += newMass * center[0] * center[1];
-			m_inertiaXY_XZ_YZ[1] += newMass * center[0] * center[2];
-			m_inertiaXY_XZ_YZ[2] += newMass * center[1] * center[2];
-			Vec3 centerSq = center * center; 
-			m_inertiaXYR_XZR_YZR[0] += newMass * (centerSq[0] + centerSq[1] + voxelSurface);
-			m_inertiaXYR_XZR_YZR[1] += newMass * (centerSq[0] + centerSq[2] + voxelSurface);
-			m_inertiaXYR_XZR_YZR[2] += newMass * (centerSq[1] + centerSq[2] + voxelSurface);
+			AddInertiaTerms( _position, newMass );
 		}
 
 		// TEMP: approximate a sphere; TODO Grow and shrink a real bounding volume
 		// TODO remove Math::Vector if replaced by template
 		m_boundingSphereRadius = max(m_boundingSphereRadius, 0.7f + len(Vec3(m_center) - Vec3(_position)) );
+
+		OnVoxelChanged( _position, _oldType, _newType );
+	}
+
+	// ********************************************************************* //
+	void Model::AddInertiaTerms( const IVec4& _position, float _mass )
+	{
+		int size = 1 << _position[3];
+		float voxelSurface = size * size / 6.0f;
+		Vec3 center = IVec3(_position) * size + size * 0.5f;
+
+		// Update inertia helper variables
+		m_inertiaX_Y_Z += _mass * center;
+		m_inertiaXY_XZ_YZ[0] += _mass * center[0] * center[1];
+		m_inertiaXY_XZ_YZ[1] += _mass * center[0] * center[2];
+		m_inertiaXY_XZ_YZ[2] += _mass * center[1] * center[2];
+		Vec3 centerSq = center * center; 
+		m_inertiaXYR_XZR_YZR[0] += _mass * (centerSq[0] + centerSq[1] + voxelSurface);
+		m_inertiaXYR_XZR_YZR[1] += _mass * (centerSq[0] + centerSq[2] + voxelSurface);
+		m_inertiaXYR_XZR_YZR[2] += _mass * (centerSq[1] + centerSq[2] + voxelSurface);
+	}
+
+	// ********************************************************************* //
+	void Model::BeginBatch()
+	{
+		Assert(!m_inBatch, "Batched edits cannot be nested.");
+		m_inBatch = true;
+		m_batchChanges.clear();
+	}
+
+	// ********************************************************************* //
+	void Model::EndBatch()
+	{
+		m_inBatch = false;
+		if( m_batchChanges.empty() ) return;
+
+		// Sum the mass moments of all changes such that the center is moved
+		// only once.
+		float massChange = 0.0f;
+		Vec3 momentChange(0.0f);
+		for( auto& change : m_batchChanges )
+		{
+			int size = 1 << change.position[3];
+			Vec3 center = IVec3(change.position) * size + size * 0.5f;
+			int volume = size * size * size;
+			if( TypeInfo::GetMass(change.oldVoxel.type) > 0.0f )
+			{
+				float oldMass = TypeInfo::GetMass(change.oldVoxel.type) * volume;
+				massChange -= oldMass;
+				momentChange -= center * oldMass;
+				m_numVoxels -= volume;
+				AddInertiaTerms( change.position, oldMass );
+			}
+			if( TypeInfo::GetMass(change.newVoxel.type) > 0.0f )
+			{
+				float newMass = TypeInfo::GetMass(change.newVoxel.type) * volume;
+				massChange += newMass;
+				momentChange += center * newMass;
+				m_numVoxels += volume;
+				AddInertiaTerms( change.position, newMass );
+			}
+		}
+		if( m_mass + massChange > 0.0f )
+			m_center = (m_center * m_mass + momentChange) / (m_mass + massChange);
+		m_mass += massChange;
+
+		for( auto& change : m_batchChanges )
+			m_boundingSphereRadius = max(m_boundingSphereRadius, 0.7f + len(Vec3(m_center) - Vec3(change.position)) );
+
+		OnVoxelsChanged( m_batchChanges );
+		m_batchChanges.clear();
+	}
+
+	// ********************************************************************* //
+	void Model::OnVoxelsChanged( const std::vector<VoxelChange>& _changes )
+	{
+		for( auto& change : _changes )
+			OnVoxelChanged( change.position, change.oldVoxel, change.newVoxel );
 	}
 
 	// ********************************************************************* //
@@ -256,7 +536,9 @@ namespace Voxel {
 	// ********************************************************************* //
 	void Model::Simulate(float _deltaTime)
 	{
-		m_position += FixVec3( m_velocity * _deltaTime );
+		// Stop at the time of impact if a fast motion would tunnel
+		m_position += FixVec3( m_velocity * min(_deltaTime, m_timeOfImpact) );
+		m_timeOfImpact = std::numeric_limits<float>::infinity();
 		// Create a delta Quaternion from rotation velocity
 		// http://physicsforgames.blogspot.de/2010/02/quaternions.html
 		Quaternion deltaRot;
@@ -290,6 +572,20 @@ namespace Voxel {
 		}
 	}
 
+	// ********************************************************************* //
+	bool Model::IsResting() const
+	{
+		return lensq(m_velocity) < SLEEP_LINEAR_VELOCITY * SLEEP_LINEAR_VELOCITY
+			&& lensq(m_angularVelocity) < SLEEP_ANGULAR_VELOCITY * SLEEP_ANGULAR_VELOCITY;
+	}
+
+	// ********************************************************************* //
+	void Model::OnFallAsleep()
+	{
+		m_velocity = Vec3(0.0f);
+		m_angularVelocity = Vec3(0.0f);
+	}
+
 	// ********************************************************************* //
 	bool Model::RayCast( const Math::WorldRay& _ray, int _targetLevel, ModelData::HitResult& _hit, float& _distance ) const
 	{
@@ -297,7 +593,7 @@ namespace Voxel {
 		Ray ray = _ray.GetRelativeRay(*this);
 		ray.origin += GetCenter();
 		// TODO: Mat4x4::Scaling(m_scale) translation relevant?
-		return m_voxelTree.RayCast(ray, _targetLevel, _hit, _distance);
+		return RayCastLocal(ray, _targetLevel, _hit, _distance);
 	}
 
 	// ********************************************************************* //
@@ -365,11 +661,12 @@ namespace Voxel {
 	enum struct ModelChunkTypes: uint8 {
 		END_MODEL,
 		WORLD_LOCATION,
-		COMPONENT_TREE
+		COMPONENT_TREE,
+		COMPONENT_DAG		///< Deduplicated tree (SparseVoxelDAG) with raw voxels
 	};
 
 	// ********************************************************************* //
-	void Model::Save( Jo::Files::IFile& _file ) const
+	void Model::Save( Jo::Files::IFile& _file, bool _deduplicate ) const
 	{
 		if(!_file.CanWrite()) throw InvalidSaveGame( _file, "To save a model the file must be opened for writing!" );
 
@@ -377,11 +674,19 @@ namespace Voxel {
 			_file.Write( &m_position, sizeof(FixVec3) );
 			_file.Write( &m_rotation, sizeof(Quaternion) );
 
-		_file.WriteU8( (uint8)ModelChunkTypes::COMPONENT_TREE );
-			_file.Write( &m_voxelTree.GetRootPosition(), sizeof(IVec3) );
-			_file.WriteI32( m_voxelTree.GetRootSize() );
-			StoreModelTree proc( _file );
-			m_voxelTree.Traverse( proc );
+		if( _deduplicate )
+		{
+			_file.WriteU8( (uint8)ModelChunkTypes::COMPONENT_DAG );
+				SparseVoxelDAG<Voxel> dag;
+				dag.Build( GetVoxelTree() );
+				dag.Save( _file );
+		} else {
+			_file.WriteU8( (uint8)ModelChunkTypes::COMPONENT_TREE );
+				_file.Write( &GetVoxelTree().GetRootPosition(), sizeof(IVec3) );
+				_file.WriteI32( GetVoxelTree().GetRootSize() );
+				StoreModelTree proc( _file );
+				GetVoxelTree().Traverse( proc );
+		}
 
 		_file.WriteU8( (uint8)ModelChunkTypes::END_MODEL );
 	}
@@ -414,6 +719,7 @@ namespace Voxel {
 
 	void Model::Load( const Jo::Files::IFile& _file )
 	{
+		m_instanceSource = nullptr;
 		if(m_numVoxels > 0) {
 			// Clear
 			m_voxelTree = ModelData(this);
@@ -431,12 +737,17 @@ namespace Voxel {
 				_file.Read( sizeof(Quaternion), &m_rotation );
 				UpdateMatrices();
 				break;
-			case ModelChunkTypes::COMPONENT_TREE:
+			case ModelChunkTypes::COMPONENT_TREE: {
 				IVec3 root; int level;
 				_file.Read( sizeof(IVec3), &root[0] );
 				_file.Read( sizeof(int), &level );
 				recursiveLoad( this, _file, root, level );
-				break;
+				} break;
+			case ModelChunkTypes::COMPONENT_DAG: {
+				SparseVoxelDAG<Voxel> dag;
+				dag.Load( _file );
+				dag.Expand( m_voxelTree );
+				} break;
 			}
 			_file.Read( 1, &chunkType );
 		}
@@ -450,7 +761,7 @@ namespace Voxel {
 	void Model::UpdateBoundingBox()
 	{
 		// Transform each octree corner to world space
-		float size = float(1 << m_voxelTree.GetRootSize());
+		float size = float(1 << GetVoxelTree().GetRootSize());
 		Vec3 octMin = m_objectBBmin - m_center;//m_voxelTree.GetRootPosition() * size - m_center;
 		Vec3 octMax = m_objectBBmax - m_center;//octMin + size;
 		m_boundingBox.min = m_boundingBox.max = TransformInverse(octMin);
@@ -533,7 +844,7 @@ namespace Voxel {
 		};
 		
 		InertiaProcessor proc(m_center);
-		m_voxelTree.Traverse( proc );
+		GetVoxelTree().Traverse( proc );
 		m_inertiaTensor = proc.newInertia;
 		m_inertiaTensorInverse = invert(proc.newInertia);
 	}
@@ -541,6 +852,13 @@ namespace Voxel {
 	// ********************************************************************* //
 	void Model::ComputeBoundingBox()
 	{
+		if( m_instanceSource )
+		{
+			m_objectBBmin = m_instanceSource->m_objectBBmin;
+			m_objectBBmax = m_instanceSource->m_objectBBmax;
+			return;
+		}
+
 		struct ComputeBB: public ModelData::SVONeighborProcessor
 		{
 		public:
@@ -678,7 +996,8 @@ namespace Voxel {
 	// ********************************************************************* //
 	std::vector<Model*> Model::UpdateCohesion()
 	{
-		static ComputeFlatArray flatVoxels;
+		// Cohesion of different models is computed in parallel jobs
+		static thread_local ComputeFlatArray flatVoxels;
 		std::vector<Model*> models;
 		TimeQuerySlot slot = 42;
 		Vec3 center = m_center; // store old center before any changes happen
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <unordered_map>
+#include <memory>
+#include <vector>
 #include <jofilelib.hpp>
 #include "predeclarations.hpp"
 #include "sparseoctree.hpp"
@@ -38,9 +40,25 @@ namespace Voxel {
 		///	\param [in] _gameTime A time which is used for chunk updates.
 		void Draw( const Input::Camera& _camera );
 
+		/// \brief Draw the model at another than its current transformation.
+		/// \details Used by the renderer to draw interpolated transformations
+		///		instead of the state the simulation is just writing.
+		void Draw( const Input::Camera& _camera, const Math::Transformation& _pose );
+
+		/// \brief Draw many models at once.
+		/// \details Instances of the same source share their chunks. Each chunk
+		///		which is visible for several of them is drawn with a single
+		///		instanced draw call. Models without shared data are drawn as
+		///		with Draw().
+		///
+		///		The effect must be set outside.
+		/// \param [in] _models Array of _num models.
+		/// \param [in] _poses Transformation to draw each model at.
+		static void DrawBatch( const Input::Camera& _camera, Model* const* _models, const Math::Transformation* _poses, int _num );
+
 		/// \brief Set a voxel in the model and update mass properties.
 		/// \see SparseVoxelOctree::Set.
-		void Set( const ei::IVec3& _position, const Voxel& _component )	{ m_voxelTree.Set( _position, 0, _component ); }
+		void Set( const ei::IVec3& _position, const Voxel& _component )	{ MakeUnique(); m_voxelTree.Set( _position, 0, _component ); }
 
 		/// \brief Returns the type of a voxel on a finest grid level.
 		///	\details If the position is outside the return value is UNDEFINED. For
@@ -51,12 +69,25 @@ namespace Voxel {
 		/// \brief Damages the voxel at the specified position.
 		void Damage(const ei::IVec3& _position, uint32_t _damage);
 
+		/// \brief Damages all voxels within a sphere in one batched edit.
+		/// \details Destroyed voxels are removed together, such that the
+		///		neighborhood is marked dirty once, the mass properties are
+		///		updated once and OnVoxelsChanged() is called once for the
+		///		whole impact.
+		/// \param [in] _center Center of the explosion in world space.
+		/// \param [in] _radius Radius of the affected sphere in voxels.
+		/// \param [in] _energy Damage in hit points at the center.
+		/// \param [in] _falloff Exponent of the damage decrease towards the
+		///		border: damage = _energy * (1 - distance / _radius)^_falloff.
+		/// \return Number of destroyed voxels.
+		int DamageRegion(const Math::FixVec3& _center, float _radius, float _energy, float _falloff);
+
 		int GetNumVoxels() const { return m_numVoxels; }
 
 		/// \brief Get the position of the center in world space
 		const Math::FixVec3& GetPosition() const			{ return m_position; }
 		/// \brief Set the position of the model based on its current center of gravity
-		void SetPosition(const Math::FixVec3& _position)	{ m_position = _position; ComputeBoundingBox(); }
+		void SetPosition(const Math::FixVec3& _position)	{ m_position = _position; ComputeBoundingBox(); WakeUp(); }
 		/// \brief Get the center of gravity (mass center) in object space
 		const ei::Vec3& GetCenter() const					{ return m_center; }
 
@@ -64,11 +95,11 @@ namespace Voxel {
 		float GetMass()										{ return m_mass; };
 		/// \brief Get the current velocity of the model
 		const ei::Vec3& GetVelocity() const					{ return m_velocity; }
-		void AddVelocity(const ei::Vec3& _velocity)			{ m_velocity += _velocity; }
+		void AddVelocity(const ei::Vec3& _velocity)			{ m_velocity += _velocity; WakeUp(); }
 
 		/// \brief Get the angular velocity of the model
 		const ei::Vec3& GetAngularVelocity() const			{ return m_angularVelocity; }
-		void AddAngularVelocity(const ei::Vec3& _velocity)	{ m_angularVelocity += _velocity; }
+		void AddAngularVelocity(const ei::Vec3& _velocity)	{ m_angularVelocity += _velocity; WakeUp(); }
 
 		const ei::Mat3x3& GetInertiaTensor() const			{ return m_inertiaTensor; }
 		const ei::Mat3x3& GetInertiaTensorInverse() const	{ return m_inertiaTensorInverse; }
@@ -82,12 +113,16 @@ namespace Voxel {
 		/// \return The reference to _out
 		ei::Mat4x4& GetModelMatrix( ei::Mat4x4& _out, const Math::Transformation& _reference ) const;
 		ei::Mat4x4& GetModelMatrix( ei::Mat4x4& _out, const Input::Camera& _reference ) const;
+		/// \brief Get the model matrix for the model placed at _pose.
+		ei::Mat4x4& GetModelMatrix( ei::Mat4x4& _out, const Input::Camera& _reference, const Math::Transformation& _pose ) const;
 
 		/// \brief Do an incremental update of physical properties.
 		/// \details If a voxel is deleted _newType is NONE. If a new voxel
 		///		is created _oldType is NONE. Overwrite operations define both
 		///		(deletion and creation).
 		///		Physical updates are only finished after an call to UpdateCohesion().
+		///		Inside a batched edit the change is only recorded and handled
+		///		together with the others at the end of the edit.
 		/// \param [in] _position Which voxel was exchanged? The fourth
 		///		component is the size with logarithmic scale of the voxel.
 		///		0 denotes the highest detail 2^0.
@@ -107,7 +142,21 @@ namespace Voxel {
 		/// Simulate physics.
 		virtual void Simulate(float _deltaTime) override;
 
+		/// \brief A model rests if its linear and angular velocities are below
+		///		SLEEP_LINEAR_VELOCITY and SLEEP_ANGULAR_VELOCITY.
+		virtual bool IsResting() const override;
+
+		/// \brief Removes the remaining drift velocities.
+		virtual void OnFallAsleep() override;
+
+		/// \brief Limit the translation of the next Simulate() call to the
+		///		given time in seconds (continuous collision detection).
+		void SetTimeOfImpact(float _time)					{ m_timeOfImpact = ei::min(m_timeOfImpact, _time); }
+
 		bool RayCast( const Math::WorldRay& _ray, int _targetLevel, ModelData::HitResult& _hit, float& _distance ) const;
+		/// \brief Ray cast with a ray which is already in the octree space
+		///		(relative ray + center of gravity).
+		bool RayCastLocal( const ei::Ray& _ray, int _targetLevel, ModelData::HitResult& _hit, float& _distance ) const	{ return GetVoxelTree().RayCast(_ray, _targetLevel, _hit, _distance); }
 
 		/// \brief Remove all chunks which were not used or dirty.
 		void ClearChunkCache();
@@ -120,13 +169,47 @@ namespace Voxel {
 		/// \brief Save to an opened file.
 		/// \details The model format is binary and compressed. The size is not
 		///		known in advance.
-		void Save( Jo::Files::IFile& _file ) const;
+		/// \param [in] _deduplicate Store the voxels as sparse voxel DAG where
+		///		identical subtrees are written only once. This also keeps the
+		///		voxel health.
+		void Save( Jo::Files::IFile& _file, bool _deduplicate = false ) const;
 
 		/// \brief Load a model from an opened file
 		/// \throws 
 		void Load( const Jo::Files::IFile& _file );
 
-		const ModelData& GetVoxelTree() { return m_voxelTree; };
+		/// \brief Get the own tree or the shared one of the instance source.
+		const ModelData& GetVoxelTree() const { return m_instanceSource ? m_instanceSource->m_voxelTree : m_voxelTree; };
+
+		/// \brief Turn this empty model into an instance of another one.
+		/// \details The instance references the voxels and chunks of the
+		///		source until the first write, which clones the tree (copy on
+		///		write). Mass properties and the location are copied.
+		///		The source must not be changed while instances exist.
+		void InstanceOf( const std::shared_ptr<Model>& _source );
+
+		/// \brief Does this model still share the voxels of another one?
+		bool IsInstance() const { return m_instanceSource != nullptr; }
+
+		/// \brief Clone the shared voxels if this is an instance.
+		void MakeUnique();
+
+		/// \brief Load a model file once and return the same immutable
+		///		source for each request of the same file.
+		/// \details The sources are kept as long as any instance uses them.
+		static std::shared_ptr<Model> LoadShared( const std::string& _fileName );
+
+		/// \brief Build a sparse voxel DAG of the voxels and log its
+		///		deduplication ratio and memory in comparison to the tree.
+		/// \details Does nothing unless enabled by EnableDeduplicationReport()
+		///		because building the DAG costs as much as a traversal of all
+		///		voxels.
+		/// \param [in] _name Identification of the model in the log.
+		void ReportDeduplication( const std::string& _name ) const;
+
+		/// \brief Switch the reports of ReportDeduplication() on or off
+		///		(Game.ReportVoxelDAG).
+		static void EnableDeduplicationReport( bool _enable )	{ s_reportDeduplication = _enable; }
 	protected:
 		std::unordered_map<ei::IVec4, Chunk> m_chunks;
 		int m_numVoxels;				///< Count the number of voxels for statistical issues
@@ -140,6 +223,7 @@ namespace Voxel {
 		ei::Mat3x3 m_inertiaTensor;	///< Mass (inertia) in relation to rotations
 		ei::Mat3x3 m_inertiaTensorInverse; ///< Inverted inertia tensor matrix
 		bool m_rotateVelocity;			///< Should a rotation also change the linear velocity
+		float m_timeOfImpact;			///< Maximum translation time for the next simulation step
 
 		void ComputeInertia();			///< Recompute inertia tensor with respect to the current center of mass.
 		
@@ -156,9 +240,48 @@ namespace Voxel {
 		ei::IVec3 m_objectBBmax;		///< Maximum position of voxels in this model
 		void ComputeBoundingBox();		///< Recompute the bounding box of the model in object space
 
+		/// \brief Called by Update() for each changed voxel after the physical
+		///		properties were updated.
+		/// \details Derived objects can maintain data which depends on single
+		///		voxels (e.g. the systems of a ship) incrementally.
+		virtual void OnVoxelChanged( const ei::IVec4& _position, const Voxel& _oldVoxel, const Voxel& _newVoxel ) {}
+
+		/// \brief A voxel exchange recorded during a batched edit.
+		struct VoxelChange
+		{
+			ei::IVec4 position;
+			Voxel oldVoxel;
+			Voxel newVoxel;
+		};
+
+		/// \brief Called once at the end of a batched edit after the
+		///		physical properties of all changes were updated.
+		/// \details The default calls OnVoxelChanged() for each change.
+		virtual void OnVoxelsChanged( const std::vector<VoxelChange>& _changes );
+
 		ModelData m_voxelTree;
+		std::shared_ptr<Model> m_instanceSource;	///< Owner of the voxels and chunks until the first write or nullptr
 		bool m_hasTakenDamage;			///< Has taken damage since the last model check was done.
 
+		bool m_inBatch;					///< Update() only records changes in m_batchChanges
+		std::vector<VoxelChange> m_batchChanges;
+
+		/// \brief Record all following changes instead of handling them one by one.
+		void BeginBatch();
+		/// \brief Update the physical properties for all recorded changes at
+		///		once and report them by OnVoxelsChanged().
+		void EndBatch();
+		/// \brief Add the inertia helper terms of a voxel with the given mass.
+		void AddInertiaTerms( const ei::IVec4& _position, float _mass );
+
+		/// \brief The model whose chunks are drawn for this one.
+		Model* GetChunkOwner()	{ return m_instanceSource ? m_instanceSource.get() : this; }
+
+		/// \brief Draw instances which all have this model as chunk owner.
+		/// \details The octree is traversed once per instance for culling and
+		///		LOD. The selected chunks are drawn once for all instances.
+		void DrawInstances( const Input::Camera& _camera, Model* const* _instances, const Math::Transformation* _poses, int _num );
+
 		/// \brief  Decide for one voxel if it has the correct detail level and
 		///		is visible (culling).
 		/// \details If the voxel is drawn the traversal is stopped and a chunk
@@ -170,6 +293,7 @@ namespace Voxel {
 
 	private:
 		std::function< void( Model& ) > m_onCollision;
+		static bool s_reportDeduplication;
 		/// Recursive helper to find the current models bounding box
 //		void ComputeBoundingBox();
 	};
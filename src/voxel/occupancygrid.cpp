@@ -0,0 +1,204 @@
+#include "occupancygrid.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace ei;
+
+namespace Voxel {
+
+	// ********************************************************************* //
+	OccupancyGrid::OccupancyGrid() :
+		m_min(0),
+		m_numBlocks(0)
+	{
+	}
+
+	// ********************************************************************* //
+	bool OccupancyGrid::Set( const IVec3& _position, bool _solid )
+	{
+		if( !IsInside(_position) )
+		{
+			// Nothing to clear outside
+			if( !_solid ) return false;
+			if( m_blocks.empty() )
+				Resize( _position, _position );
+			else
+				Resize( min(m_min, _position), max(m_min + m_numBlocks * BLOCK_SIZE - 1, _position) );
+		}
+
+		IVec3 local = _position - m_min;
+		int block = BlockIndex(local >> LOG_BLOCK_SIZE);
+		uint64_t& slice = m_blocks[block].slices[local[2] % BLOCK_SIZE];
+		uint64_t bit = uint64_t(1) << BitIndex(local);
+		if( ((slice & bit) != 0) == _solid )
+			return false;
+		if( _solid )
+		{
+			slice |= bit;
+			++m_blockCounts[block];
+		} else {
+			slice &= ~bit;
+			--m_blockCounts[block];
+		}
+		return true;
+	}
+
+	// ********************************************************************* //
+	bool OccupancyGrid::IsSolid( const IVec3& _position ) const
+	{
+		if( !IsInside(_position) ) return false;
+		IVec3 local = _position - m_min;
+		uint64_t slice = m_blocks[BlockIndex(local >> LOG_BLOCK_SIZE)].slices[local[2] % BLOCK_SIZE];
+		return (slice >> BitIndex(local)) & 1;
+	}
+
+	// ********************************************************************* //
+	bool OccupancyGrid::IsInside( const IVec3& _position ) const
+	{
+		IVec3 local = _position - m_min;
+		return local[0] >= 0 && local[1] >= 0 && local[2] >= 0
+			&& local[0] < m_numBlocks[0] * BLOCK_SIZE
+			&& local[1] < m_numBlocks[1] * BLOCK_SIZE
+			&& local[2] < m_numBlocks[2] * BLOCK_SIZE;
+	}
+
+	// ********************************************************************* //
+	void OccupancyGrid::Resize( const IVec3& _min, const IVec3& _max )
+	{
+		// Align to blocks and leave some space to grow without copying again
+		IVec3 newMin = ((_min >> LOG_BLOCK_SIZE) - 1) << LOG_BLOCK_SIZE;
+		IVec3 newNumBlocks = (_max >> LOG_BLOCK_SIZE) + 2 - (newMin >> LOG_BLOCK_SIZE);
+
+		std::vector<Block> blocks(newNumBlocks[0] * newNumBlocks[1] * newNumBlocks[2]);
+		std::vector<uint16_t> blockCounts(blocks.size(), 0);
+		memset(blocks.data(), 0, blocks.size() * sizeof(Block));
+		IVec3 offset = (m_min - newMin) >> LOG_BLOCK_SIZE;
+		for( int z = 0; z < m_numBlocks[2]; ++z )
+			for( int y = 0; y < m_numBlocks[1]; ++y )
+				for( int x = 0; x < m_numBlocks[0]; ++x )
+				{
+					IVec3 target = IVec3(x, y, z) + offset;
+					int newIndex = target[0] + newNumBlocks[0] * (target[1] + newNumBlocks[1] * target[2]);
+					blocks[newIndex] = m_blocks[BlockIndex(IVec3(x, y, z))];
+					blockCounts[newIndex] = m_blockCounts[BlockIndex(IVec3(x, y, z))];
+				}
+
+		m_blocks.swap(blocks);
+		m_blockCounts.swap(blockCounts);
+		m_min = newMin;
+		m_numBlocks = newNumBlocks;
+	}
+
+	// ********************************************************************* //
+	/// \brief Setup of a digital differential analyzer along one axis.
+	/// \param [in] _cell Current cell coordinate along the axis.
+	/// \param [in] _cellSize Edge length of the traversed cells.
+	/// \param [out] _tNext Ray parameter of the next cell boundary.
+	/// \param [out] _tDelta Ray parameter between two boundaries.
+	static void InitAxis( float _origin, float _direction, int _cell, int _cellSize, int& _step, float& _tNext, float& _tDelta )
+	{
+		const float INF = std::numeric_limits<float>::infinity();
+		if( _direction > 0.0f )
+		{
+			_step = 1;
+			_tNext = (float(_cell + _cellSize) - _origin) / _direction;
+			_tDelta = _cellSize / _direction;
+		} else if( _direction < 0.0f )
+		{
+			_step = -1;
+			_tNext = (float(_cell) - _origin) / _direction;
+			_tDelta = -_cellSize / _direction;
+		} else {
+			_step = 0;
+			_tNext = INF;
+			_tDelta = INF;
+		}
+	}
+
+	// ********************************************************************* //
+	bool OccupancyGrid::RayCast( const Ray& _ray, float& _distance ) const
+	{
+		if( m_blocks.empty() ) return false;
+
+		// Clip the ray against the grid
+		Vec3 gridMin(m_min);
+		Vec3 gridMax(m_min + m_numBlocks * BLOCK_SIZE);
+		float tEnter = 0.0f, tExit = _distance;
+		for( int i = 0; i < 3; ++i )
+		{
+			if( _ray.direction[i] == 0.0f )
+			{
+				if( _ray.origin[i] < gridMin[i] || _ray.origin[i] >= gridMax[i] )
+					return false;
+				continue;
+			}
+			float t0 = (gridMin[i] - _ray.origin[i]) / _ray.direction[i];
+			float t1 = (gridMax[i] - _ray.origin[i]) / _ray.direction[i];
+			if( t0 > t1 ) std::swap(t0, t1);
+			tEnter = max(tEnter, t0);
+			tExit = min(tExit, t1);
+		}
+		if( tEnter >= tExit ) return false;
+
+		// Traverse the blocks
+		Vec3 start = _ray.origin + _ray.direction * tEnter - gridMin;
+		IVec3 block;
+		int step[3]; float tNext[3], tDelta[3];
+		for( int i = 0; i < 3; ++i )
+		{
+			block[i] = clamp(int(std::floor(start[i] / BLOCK_SIZE)), 0, m_numBlocks[i] - 1);
+			InitAxis( _ray.origin[i], _ray.direction[i], m_min[i] + block[i] * BLOCK_SIZE, BLOCK_SIZE, step[i], tNext[i], tDelta[i] );
+		}
+
+		float t = tEnter;
+		while( t < tExit )
+		{
+			int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+			float tBlockExit = min(tNext[axis], tExit);
+			if( m_blockCounts[BlockIndex(block)] && RayCastBlock(_ray, block, t, tBlockExit, _distance) )
+				return true;
+
+			t = tNext[axis];
+			tNext[axis] += tDelta[axis];
+			block[axis] += step[axis];
+			if( block[axis] < 0 || block[axis] >= m_numBlocks[axis] )
+				return false;
+		}
+		return false;
+	}
+
+	// ********************************************************************* //
+	bool OccupancyGrid::RayCastBlock( const Ray& _ray, const IVec3& _block, float _tEnter, float _tExit, float& _distance ) const
+	{
+		const Block& data = m_blocks[BlockIndex(_block)];
+		IVec3 blockMin = m_min + _block * BLOCK_SIZE;
+		Vec3 start = _ray.origin + _ray.direction * _tEnter;
+		IVec3 cell;
+		int step[3]; float tNext[3], tDelta[3];
+		for( int i = 0; i < 3; ++i )
+		{
+			cell[i] = clamp(int(std::floor(start[i])) - blockMin[i], 0, BLOCK_SIZE - 1);
+			InitAxis( _ray.origin[i], _ray.direction[i], blockMin[i] + cell[i], 1, step[i], tNext[i], tDelta[i] );
+		}
+
+		float t = _tEnter;
+		while( t < _tExit )
+		{
+			if( (data.slices[cell[2]] >> BitIndex(cell)) & 1 )
+			{
+				_distance = t;
+				return true;
+			}
+
+			int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+			t = tNext[axis];
+			tNext[axis] += tDelta[axis];
+			cell[axis] += step[axis];
+			if( cell[axis] < 0 || cell[axis] >= BLOCK_SIZE )
+				return false;
+		}
+		return false;
+	}
+
+} // namespace Voxel
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "sparseoctree.hpp"
+#include "voxel.hpp"
+#include <vector>
+#include <cstdint>
+
+namespace Voxel {
+
+	/// \brief A dense bit grid of the non empty level 0 voxels of a model.
+	/// \details The grid is divided into blocks of 8^3 voxels. Each block
+	///		knows its number of solid voxels, so ray casts skip empty blocks
+	///		as a whole. Compared to a ray cast through the octree this needs
+	///		no recursion, no sorting and no memory besides one bit per voxel.
+	///
+	///		The grid covers the bounding box of the model and grows when
+	///		something outside is set.
+	class OccupancyGrid
+	{
+	public:
+		OccupancyGrid();
+
+		/// \brief Replace the grid by the solid voxels of a tree.
+		/// \details Leaves on higher levels fill their whole volume.
+		template<typename Listener>
+		void Build( const SparseVoxelOctree<Voxel, Listener>& _tree );
+
+		/// \brief Change a single level 0 voxel.
+		/// \return true if the occupancy changed.
+		bool Set( const ei::IVec3& _position, bool _solid );
+
+		bool IsSolid( const ei::IVec3& _position ) const;
+
+		/// \brief Find the first solid voxel along a ray.
+		/// \details Same semantic as SparseVoxelOctree::RayCast on level 0:
+		///		the distance is the one to the entry point of the hit voxel
+		///		and 0 if the ray starts inside a solid voxel.
+		/// \param [inout] _distance Maximum range. Shortened to the hit
+		///		distance if something is hit.
+		/// \return true if a solid voxel is closer than _distance.
+		bool RayCast( const ei::Ray& _ray, float& _distance ) const;
+	private:
+		static const int LOG_BLOCK_SIZE = 3;
+		static const int BLOCK_SIZE = 1 << LOG_BLOCK_SIZE;
+
+		/// \brief 8 slices of 8x8 bits.
+		struct Block
+		{
+			uint64_t slices[BLOCK_SIZE];
+		};
+
+		ei::IVec3 m_min;					///< Smallest covered voxel, a multiple of BLOCK_SIZE
+		ei::IVec3 m_numBlocks;
+		std::vector<Block> m_blocks;
+		std::vector<uint16_t> m_blockCounts;	///< Number of solid voxels in each block
+
+		/// \brief Cover at least the region [_min, _max] and keep the content.
+		void Resize( const ei::IVec3& _min, const ei::IVec3& _max );
+
+		int BlockIndex( const ei::IVec3& _block ) const		{ return _block[0] + m_numBlocks[0] * (_block[1] + m_numBlocks[1] * _block[2]); }
+		bool IsInside( const ei::IVec3& _position ) const;
+		/// \brief Bit of a voxel in its slice. Works for grid and block local
+		///		positions.
+		static int BitIndex( const ei::IVec3& _local )		{ return _local[0] % BLOCK_SIZE + (_local[1] % BLOCK_SIZE) * BLOCK_SIZE; }
+
+		/// \brief Cell traversal through a single non empty block.
+		bool RayCastBlock( const ei::Ray& _ray, const ei::IVec3& _block, float _tEnter, float _tExit, float& _distance ) const;
+	};
+
+	// ********************************************************************* //
+	template<typename Listener>
+	void OccupancyGrid::Build( const SparseVoxelOctree<Voxel, Listener>& _tree )
+	{
+		// Find the extent of all leaves first to allocate once.
+		struct BoundsProcessor: public SparseVoxelOctree<Voxel, Listener>::SVOProcessor
+		{
+			BoundsProcessor() : min(0x7fffffff), max(-0x7fffffff), empty(true) {}
+
+			bool PreTraversal(const ei::IVec4& _position, const typename SparseVoxelOctree<Voxel, Listener>::SVON* _node)
+			{
+				if( !_node->Children() && _node->Data().type != ComponentType::UNDEFINED )
+				{
+					int size = 1 << _position[3];
+					min = ei::min(min, ei::IVec3(_position) * size);
+					max = ei::max(max, ei::IVec3(_position) * size + size - 1);
+					empty = false;
+				}
+				return true;
+			}
+
+			ei::IVec3 min, max;
+			bool empty;
+		} bounds;
+		_tree.Traverse( bounds );
+
+		m_blocks.clear();
+		m_blockCounts.clear();
+		m_numBlocks = ei::IVec3(0);
+		if( bounds.empty ) return;
+		Resize( bounds.min, bounds.max );
+
+		struct FillProcessor: public SparseVoxelOctree<Voxel, Listener>::SVOProcessor
+		{
+			FillProcessor(OccupancyGrid& _grid) : grid(_grid) {}
+
+			bool PreTraversal(const ei::IVec4& _position, const typename SparseVoxelOctree<Voxel, Listener>::SVON* _node)
+			{
+				if( !_node->Children() && _node->Data().type != ComponentType::UNDEFINED )
+				{
+					int size = 1 << _position[3];
+					ei::IVec3 first = ei::IVec3(_position) * size;
+					for( int z = 0; z < size; ++z )
+						for( int y = 0; y < size; ++y )
+							for( int x = 0; x < size; ++x )
+								grid.Set( first + ei::IVec3(x, y, z), true );
+				}
+				return true;
+			}
+
+			OccupancyGrid& grid;
+		} fill(*this);
+		_tree.Traverse( fill );
+	}
+
+} // namespace Voxel
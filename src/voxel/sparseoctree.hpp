@@ -5,9 +5,86 @@
 #include "algorithm/smallsort.hpp"
 #include <hybridarray.hpp>
 #include <poolallocator.hpp>
+#include <algorithm>
 
 namespace Voxel {
 
+	/// \brief An axis aligned box in the level 0 grid space of an octree.
+	struct BoxRegion
+	{
+		ei::Vec3 min;
+		ei::Vec3 max;
+
+		BoxRegion( const ei::Vec3& _min, const ei::Vec3& _max ) : min(_min), max(_max)	{}
+
+		/// \brief Does the region intersect the node box [_min, _max]?
+		bool Overlaps( const ei::Vec3& _min, const ei::Vec3& _max ) const
+		{
+			for( int i = 0; i < 3; ++i )
+				if( _max[i] < min[i] || max[i] < _min[i] ) return false;
+			return true;
+		}
+	};
+
+	/// \brief A sphere in the level 0 grid space of an octree.
+	struct SphereRegion
+	{
+		ei::Vec3 center;
+		float radius;
+
+		SphereRegion( const ei::Vec3& _center, float _radius ) : center(_center), radius(_radius)	{}
+
+		/// \copydoc BoxRegion::Overlaps
+		bool Overlaps( const ei::Vec3& _min, const ei::Vec3& _max ) const
+		{
+			// Squared distance from the center to the closest point in the box
+			float distSq = 0.0f;
+			for( int i = 0; i < 3; ++i )
+			{
+				float d = ei::max(0.0f, ei::max(_min[i] - center[i], center[i] - _max[i]));
+				distSq += d * d;
+			}
+			return distSq <= radius * radius;
+		}
+	};
+
+	/// \brief A swept sphere (line segment with radius) in the level 0 grid
+	///		space of an octree.
+	struct CapsuleRegion
+	{
+		ei::Vec3 a;
+		ei::Vec3 b;
+		float radius;
+
+		CapsuleRegion( const ei::Vec3& _a, const ei::Vec3& _b, float _radius ) : a(_a), b(_b), radius(_radius)	{}
+
+		/// \copydoc BoxRegion::Overlaps
+		/// \details The test clips the segment against the box enlarged by
+		///		the radius. This is conservative at the edges of the box.
+		bool Overlaps( const ei::Vec3& _min, const ei::Vec3& _max ) const
+		{
+			float tmin = 0.0f, tmax = 1.0f;
+			for( int i = 0; i < 3; ++i )
+			{
+				float lo = _min[i] - radius;
+				float hi = _max[i] + radius;
+				float d = b[i] - a[i];
+				if( ei::abs(d) < 1e-6f )
+				{
+					if( a[i] < lo || a[i] > hi ) return false;
+				} else {
+					float t0 = (lo - a[i]) / d;
+					float t1 = (hi - a[i]) / d;
+					if( t0 > t1 ) std::swap(t0, t1);
+					tmin = ei::max(tmin, t0);
+					tmax = ei::min(tmax, t1);
+					if( tmin > tmax ) return false;
+				}
+			}
+			return true;
+		}
+	};
+
 	/// \brief A generic sparse octree implementation.
 	/// \details Each node contains data and there are special operations
 	///		assuming that the data are voxels.
@@ -32,6 +109,11 @@ namespace Voxel {
 		/// \brief Takes the data from another tree. 
 		void operator=(SparseVoxelOctree&& _oth);
 
+		/// \brief Deep copy of all nodes of another tree into this empty tree.
+		/// \details The listener is not called. Properties derived by the
+		///		listener must be copied separately.
+		void CopyFrom( const SparseVoxelOctree& _other );
+
 		/// \brief Set a voxel in the octree and call update of the listener.
 		/// \details This method overwrites all covered voxels.
 		/// \param [in] _position Position inside the given level.
@@ -42,6 +124,16 @@ namespace Voxel {
 		///		delete a voxel.
 		void Set( const ei::IVec3& _position, int _level, T _type );
 
+		/// \brief Set many voxels of the same level to the same value.
+		/// \details In contrast to calling Set() for each voxel the
+		///		neighborhood is marked dirty only once for the bounding box of
+		///		all positions.
+		/// \param [in] _positions Array of positions inside the given level.
+		/// \param [in] _num Number of positions in the array.
+		/// \param [in] _level Depth in the grid hierarchy \see Set.
+		/// \param [in] _type Voxel to be set for all positions.
+		void SetBatch( const ei::IVec3* _positions, int _num, int _level, T _type );
+
 		/// \brief Getter which returns a node reference.
 		///	\param [in] _position Target position inside the _level.
 		///	\param [in] _level Depth in the grid hierarchy. 0 is the maximum
@@ -79,6 +171,22 @@ namespace Voxel {
 		template<class Processor>
 		void TraverseEx( Processor& _processor );
 
+		/// \brief Traverse only the nodes which overlap a region.
+		/// \details Empty subtrees are never visited. Children outside the
+		///		region are culled before the processor sees them.
+		/// \param [in] _region A BoxRegion, SphereRegion, CapsuleRegion or
+		///		any other type with an Overlaps(min, max) method in level 0
+		///		grid space.
+		/// \param [in] _processor An arbitrary implementation of the
+		///		SVOProcessor concept.
+		/// \param [in] _stopAtInner Do not descend into nodes whose children
+		///		are all inner components (T::inner). The flag of non-leaf
+		///		nodes is only valid while the node is not dirty.
+		template<class Region, class Processor>
+		void TraverseRegion( const Region& _region, Processor& _processor, bool _stopAtInner = false );
+		template<class Region, class Processor>
+		void TraverseRegion( const Region& _region, Processor& _processor, bool _stopAtInner = false ) const;
+
 		/// \brief Full collision information in local coordinates
 		struct HitResult
 		{
@@ -133,6 +241,13 @@ namespace Voxel {
 				const SVON* _left, const SVON* _right, const SVON* _bottom,
 				const SVON* _top, const SVON* _front, const SVON* _back );
 
+			/// \brief Recursive region traverse.
+			/// \see SparseVoxelOctree::TraverseRegion
+			template<class Region, class Processor>
+			void TraverseRegion( const ei::IVec4& _position, const Region& _region, Processor& _processor, bool _stopAtInner );
+			template<class Region, class Processor>
+			void TraverseRegion( const ei::IVec4& _position, const Region& _region, Processor& _processor, bool _stopAtInner ) const;
+
 			/// \copydoc SparseVoxelOctree::RayCast
 			bool RayCast( const ei::Ray& _ray, ei::IVec3& _position, int _level,
 				int _targetLevel, HitResult& _hit, float& _distance ) const;
@@ -239,6 +354,9 @@ namespace Voxel {
 		/// \brief Use the pool allocator and call the constructor 8 times
 		SVON* NewSVON();
 
+		/// \brief Recursively clone a set of 8 children with this tree's allocator.
+		SVON* CloneChildren( const SVON* _children );
+
 		/// \brief A sparse voxel octree root.
 		///	\details Each pointer points to a set of 8 children. So on root level there
 		///		are always 8 nodes.		
@@ -246,6 +364,9 @@ namespace Voxel {
 		int m_rootSize;				///< Level of the node which contains the 8 roots where 0 is the highest possible resolution.
 		SVON m_root;				///< The single top level root node
 
+		/// \brief Increase the root until it covers the given position.
+		void ExtendRoot( const ei::IVec3& _position, int _level );
+
 		/// \brief Touch all nodes on a path
 		///	\param [in] _position Target position inside the _level.
 		///	\param [in] _level Depth in the grid hierarchy. 0 is the maximum
@@ -307,9 +428,85 @@ namespace Voxel {
 		return pNew;
 	}
 
+	// ********************************************************************* //
+	template<typename T, typename Listener>
+	void SparseVoxelOctree<T,Listener>::CopyFrom( const SparseVoxelOctree<T,Listener>& _other )
+	{
+		Assert(m_rootSize == -1, "Copy is only possible into an empty tree.");
+
+		m_rootPosition = _other.m_rootPosition;
+		m_rootSize = _other.m_rootSize;
+		m_root.m_data = _other.m_root.m_data;
+		m_root.m_children = CloneChildren( _other.m_root.m_children );
+	}
+
+	// ********************************************************************* //
+	template<typename T, typename Listener>
+	typename SparseVoxelOctree<T,Listener>::SVON* SparseVoxelOctree<T,Listener>::CloneChildren( const SVON* _children )
+	{
+		if( !_children ) return nullptr;
+		SVON* pNew = NewSVON();
+		for(int i=0; i<8; ++i)
+		{
+			pNew[i].m_data = _children[i].m_data;
+			pNew[i].m_children = CloneChildren( _children[i].m_children );
+		}
+		return pNew;
+	}
+
 	// ********************************************************************* //
 	template<typename T, typename Listener>
 	void SparseVoxelOctree<T,Listener>::Set( const ei::IVec3& _position, int _level, T _type )
+	{
+		ExtendRoot( _position, _level );
+
+		// One of the eight children must contain the target position.
+		SVON::Set(&m_root, m_rootSize, ei::IVec4(_position, _level), _type, this);
+
+		// Make all 6 neighbors dirty - their neighborhood changed
+		SetDirty( ei::IVec3(_position[0]+1, _position[1], _position[2]), _level );
+		SetDirty( ei::IVec3(_position[0]-1, _position[1], _position[2]), _level );
+		SetDirty( ei::IVec3(_position[0], _position[1]+1, _position[2]), _level );
+		SetDirty( ei::IVec3(_position[0], _position[1]-1, _position[2]), _level );
+		SetDirty( ei::IVec3(_position[0], _position[1], _position[2]+1), _level );
+		SetDirty( ei::IVec3(_position[0], _position[1], _position[2]-1), _level );
+	}
+
+	// ********************************************************************* //
+	template<typename T, typename Listener>
+	void SparseVoxelOctree<T,Listener>::SetBatch( const ei::IVec3* _positions, int _num, int _level, T _type )
+	{
+		if( _num <= 0 ) return;
+
+		ei::IVec3 bbmin = _positions[0];
+		ei::IVec3 bbmax = _positions[0];
+		for( int i = 0; i < _num; ++i )
+		{
+			ExtendRoot( _positions[i], _level );
+			SVON::Set(&m_root, m_rootSize, ei::IVec4(_positions[i], _level), _type, this);
+			for( int j = 0; j < 3; ++j )
+			{
+				bbmin[j] = ei::min(bbmin[j], _positions[i][j]);
+				bbmax[j] = ei::max(bbmax[j], _positions[i][j]);
+			}
+		}
+
+		// Touch everything which is a neighbor of at least one changed voxel.
+		// The box is inflated by one voxel and shrunk a little such that
+		// nodes which only share a face with it are not touched.
+		struct TouchProcessor: public SVOProcessor
+		{
+			bool PreTraversal(const ei::IVec4& _position, SVON* _node)	{ _node->Data().Touch(); return true; }
+			void PostTraversal(const ei::IVec4& _position, SVON* _node)	{}
+		} proc;
+		float size = float(1 << _level);
+		BoxRegion region( ei::Vec3(bbmin - 1) * size + 0.01f, ei::Vec3(bbmax + 2) * size - 0.01f );
+		TraverseRegion( region, proc );
+	}
+
+	// ********************************************************************* //
+	template<typename T, typename Listener>
+	void SparseVoxelOctree<T,Listener>::ExtendRoot( const ei::IVec3& _position, int _level )
 	{
 		// Compute if the position is inside the current tree
 		if(m_rootSize == -1)
@@ -342,16 +539,6 @@ namespace Voxel {
 			position >>= 1;
 		}
 
-		// One of the eight children must contain the target position.
-		SVON::Set(&m_root, m_rootSize, ei::IVec4(_position, _level), _type, this);
-
-		// Make all 6 neighbors dirty - their neighborhood changed
-		SetDirty( ei::IVec3(_position[0]+1, _position[1], _position[2]), _level );
-		SetDirty( ei::IVec3(_position[0]-1, _position[1], _position[2]), _level );
-		SetDirty( ei::IVec3(_position[0], _position[1]+1, _position[2]), _level );
-		SetDirty( ei::IVec3(_position[0], _position[1]-1, _position[2]), _level );
-		SetDirty( ei::IVec3(_position[0], _position[1], _position[2]+1), _level );
-		SetDirty( ei::IVec3(_position[0], _position[1], _position[2]-1), _level );
 	}
 
 	// ********************************************************************* //
@@ -447,6 +634,28 @@ namespace Voxel {
 			nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
 	}
 
+	// ********************************************************************* //
+	template<typename T, typename Listener> template<class Region, class Processor>
+	void SparseVoxelOctree<T,Listener>::TraverseRegion( const Region& _region, Processor& _processor, bool _stopAtInner )
+	{
+		Assert(m_rootSize != -1, "Octree not yet initialized!");
+
+		ei::Vec3 rootMin( m_rootPosition * (1 << m_rootSize) );
+		if( _region.Overlaps(rootMin, rootMin + float(1 << m_rootSize)) )
+			m_root.TraverseRegion(IVec4(m_rootPosition, m_rootSize), _region, _processor, _stopAtInner);
+	}
+
+	// ********************************************************************* //
+	template<typename T, typename Listener> template<class Region, class Processor>
+	void SparseVoxelOctree<T,Listener>::TraverseRegion( const Region& _region, Processor& _processor, bool _stopAtInner ) const
+	{
+		Assert(m_rootSize != -1, "Octree not yet initialized!");
+
+		ei::Vec3 rootMin( m_rootPosition * (1 << m_rootSize) );
+		if( _region.Overlaps(rootMin, rootMin + float(1 << m_rootSize)) )
+			m_root.TraverseRegion(IVec4(m_rootPosition, m_rootSize), _region, _processor, _stopAtInner);
+	}
+
 	// ********************************************************************* //
 	template<typename T, typename Listener>
 	bool SparseVoxelOctree<T,Listener>::RayCast( const ei::Ray& _ray, int _targetLevel, HitResult& _hit, float& _distance ) const
@@ -638,6 +847,55 @@ namespace Voxel {
 		_processor.PostTraversal(_position, this, _left, _right, _bottom, _top, _front, _back);
 	}
 
+	// ********************************************************************* //
+	template<typename T, typename Listener> template<class Region, class Processor>
+	void SparseVoxelOctree<T,Listener>::SVON::TraverseRegion( const ei::IVec4& _position, const Region& _region, Processor& _processor, bool _stopAtInner )
+	{
+		if( _processor.PreTraversal(_position, this) && m_children
+			&& !(_stopAtInner && m_data.inner && !m_data.IsDirty()) )
+		{
+			ei::IVec4 position(_position[0]<<1, _position[1]<<1, _position[2]<<1, _position[3]);
+			float edgeLength = float(1 << (_position[3]-1));
+			for( int i=0; i<8; ++i )
+			{
+				// Is the voxel outside the tree/really empty?
+				if( m_children[i].m_data != T::UNDEFINED || m_children[i].m_children )
+				{
+					ei::IVec4 childPosition = position + CHILD_OFFSETS[i];
+					ei::Vec3 childMin( ei::IVec3(childPosition) * (1 << childPosition[3]) );
+					if( _region.Overlaps(childMin, childMin + edgeLength) )
+						m_children[i].TraverseRegion(childPosition, _region, _processor, _stopAtInner);
+				}
+			}
+		}
+
+		_processor.PostTraversal(_position, this);
+	}
+
+	template<typename T, typename Listener> template<class Region, class Processor>
+	void SparseVoxelOctree<T,Listener>::SVON::TraverseRegion( const ei::IVec4& _position, const Region& _region, Processor& _processor, bool _stopAtInner ) const
+	{
+		if( _processor.PreTraversal(_position, this) && m_children
+			&& !(_stopAtInner && m_data.inner && !m_data.IsDirty()) )
+		{
+			ei::IVec4 position(_position[0]<<1, _position[1]<<1, _position[2]<<1, _position[3]);
+			float edgeLength = float(1 << (_position[3]-1));
+			for( int i=0; i<8; ++i )
+			{
+				// Is the voxel outside the tree/really empty?
+				if( m_children[i].m_data != T::UNDEFINED || m_children[i].m_children )
+				{
+					ei::IVec4 childPosition = position + CHILD_OFFSETS[i];
+					ei::Vec3 childMin( ei::IVec3(childPosition) * (1 << childPosition[3]) );
+					if( _region.Overlaps(childMin, childMin + edgeLength) )
+						m_children[i].TraverseRegion(childPosition, _region, _processor, _stopAtInner);
+				}
+			}
+		}
+
+		_processor.PostTraversal(_position, this);
+	}
+
 	// ********************************************************************* //
 	template<typename T, typename Listener>
 	int SparseVoxelOctree<T,Listener>::SVON::ComputeChildIndex(const ei::IVec4& _targetPosition, int _childSize)
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "sparseoctree.hpp"
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <jofilelib.hpp>
+
+namespace Voxel {
+
+	/// \brief A read-only sparse voxel directed acyclic graph.
+	/// \details The graph is built from a SparseVoxelOctree by merging
+	///		identical subtrees bottom up (hash consing). Two nodes are
+	///		identical if their data is identical (T::IsIdentical, hashed by
+	///		T::Hash) and all their children are equal. Uniform interiors and
+	///		repeated patterns are then stored only once.
+	///
+	///		The DAG can be queried, stored and expanded back into a mutable
+	///		tree.
+	template<typename T>
+	class SparseVoxelDAG
+	{
+	public:
+		static const uint32 EMPTY = 0xffffffff;	///< Index of non existing children
+
+		struct Node
+		{
+			T data;
+			uint32 children[8];		///< Node indices or EMPTY
+
+			bool IsLeaf() const
+			{
+				for( int i = 0; i < 8; ++i )
+					if( children[i] != EMPTY ) return false;
+				return true;
+			}
+		};
+
+		SparseVoxelDAG() : m_root(EMPTY), m_rootPosition(0), m_rootSize(-1), m_numTreeNodes(0), m_treeMemory(0)	{}
+
+		/// \brief Replace the current graph by a deduplicated copy of a tree.
+		template<typename Listener>
+		void Build( const SparseVoxelOctree<T, Listener>& _tree );
+
+		/// \brief Set all leaves of the graph in an empty tree.
+		/// \details This calls the listener of the tree for each leaf.
+		template<typename Listener>
+		void Expand( SparseVoxelOctree<T, Listener>& _tree ) const;
+
+		/// \brief Getter analogous to SparseVoxelOctree::Get.
+		/// \return nullptr if the node is not in the graph otherwise its data.
+		const T* Get( const ei::IVec3& _position, int _level ) const;
+
+		/// \brief Save in binary form. The data is stored as raw bytes of T.
+		void Save( Jo::Files::IFile& _file ) const;
+
+		/// \brief Load a graph written by Save().
+		void Load( const Jo::Files::IFile& _file );
+
+		int NumNodes() const					{ return (int)m_nodes.size(); }
+		/// \brief Number of non-empty nodes of the tree from the last Build().
+		int NumTreeNodes() const				{ return m_numTreeNodes; }
+		/// \brief Number of tree nodes per graph node (>= 1).
+		float GetDedupRatio() const				{ return m_nodes.empty() ? 1.0f : m_numTreeNodes / float(m_nodes.size()); }
+		/// \brief Memory of the graph nodes in bytes.
+		size_t MemoryConsumption() const		{ return m_nodes.size() * sizeof(Node); }
+		/// \brief Memory of the nodes of the tree from the last Build() in bytes.
+		size_t TreeMemoryConsumption() const	{ return m_treeMemory; }
+
+	private:
+		std::vector<Node> m_nodes;
+		uint32 m_root;
+		ei::IVec3 m_rootPosition;
+		int m_rootSize;
+		int m_numTreeNodes;
+		size_t m_treeMemory;
+
+		/// \brief Hash and equality over the data fields and the children of
+		///		a node. Raw bytes would include transient flags.
+		struct NodeHash
+		{
+			size_t operator () ( const Node& _node ) const
+			{
+				uint64_t hash = _node.data.Hash();
+				for( int i = 0; i < 8; ++i )
+					hash = (hash ^ _node.children[i]) * 0x100000001b3ull;
+				return (size_t)hash;
+			}
+		};
+		struct NodeEqual
+		{
+			bool operator () ( const Node& _lhs, const Node& _rhs ) const
+			{
+				return _lhs.data.IsIdentical(_rhs.data)
+					&& memcmp(_lhs.children, _rhs.children, sizeof(_lhs.children)) == 0;
+			}
+		};
+		typedef std::unordered_map<Node, uint32, NodeHash, NodeEqual> NodeLookup;
+
+		/// \brief Recursively add a tree node and return the index of the
+		///		equal graph node.
+		template<typename SVON>
+		uint32 BuildNode( const SVON* _node, NodeLookup& _lookup );
+
+		template<typename Listener>
+		void ExpandNode( SparseVoxelOctree<T, Listener>& _tree, uint32 _node, const ei::IVec4& _position ) const;
+	};
+
+
+
+	// ********************************************************************* //
+	template<typename T> template<typename Listener>
+	void SparseVoxelDAG<T>::Build( const SparseVoxelOctree<T, Listener>& _tree )
+	{
+		typedef typename SparseVoxelOctree<T, Listener>::SVON SVON;
+
+		m_nodes.clear();
+		m_root = EMPTY;
+		m_rootPosition = _tree.GetRootPosition();
+		m_rootSize = _tree.GetRootSize();
+		m_numTreeNodes = 0;
+		m_treeMemory = 0;
+		if( m_rootSize == -1 ) return;
+
+		// The root node is only accessible through a traversal
+		struct FindRoot: public SparseVoxelOctree<T, Listener>::SVOProcessor
+		{
+			const SVON* root;
+			bool PreTraversal(const ei::IVec4& _position, const SVON* _node)	{ root = _node; return false; }
+			void PostTraversal(const ei::IVec4& _position, const SVON* _node)	{}
+		} findRoot;
+		_tree.Traverse( findRoot );
+
+		NodeLookup lookup;
+		m_treeMemory = sizeof(SVON);
+		m_root = BuildNode( findRoot.root, lookup );
+	}
+
+	// ********************************************************************* //
+	template<typename T> template<typename SVON>
+	uint32 SparseVoxelDAG<T>::BuildNode( const SVON* _node, NodeLookup& _lookup )
+	{
+		++m_numTreeNodes;
+		Node node;
+		memcpy(&node.data, &_node->Data(), sizeof(T));
+		for( int i = 0; i < 8; ++i )
+			node.children[i] = EMPTY;
+		if( _node->Children() )
+		{
+			// The tree allocates all 8 children at once, even empty ones
+			m_treeMemory += 8 * sizeof(SVON);
+			for( int i = 0; i < 8; ++i )
+			{
+				const SVON* child = _node->GetChild(i);
+				if( child ) node.children[i] = BuildNode( child, _lookup );
+			}
+		}
+
+		// Hash consing: reuse an equal node
+		auto it = _lookup.find(node);
+		if( it != _lookup.end() )
+			return it->second;
+		uint32 index = (uint32)m_nodes.size();
+		m_nodes.push_back(node);
+		_lookup.emplace(node, index);
+		return index;
+	}
+
+	// ********************************************************************* //
+	template<typename T> template<typename Listener>
+	void SparseVoxelDAG<T>::Expand( SparseVoxelOctree<T, Listener>& _tree ) const
+	{
+		if( m_root != EMPTY )
+			ExpandNode( _tree, m_root, ei::IVec4(m_rootPosition, m_rootSize) );
+	}
+
+	// ********************************************************************* //
+	template<typename T> template<typename Listener>
+	void SparseVoxelDAG<T>::ExpandNode( SparseVoxelOctree<T, Listener>& _tree, uint32 _node, const ei::IVec4& _position ) const
+	{
+		const Node& node = m_nodes[_node];
+		if( node.IsLeaf() )
+		{
+			if( node.data != T::UNDEFINED )
+				_tree.Set( ei::IVec3(_position), _position[3], node.data );
+			return;
+		}
+
+		ei::IVec4 position(_position[0]<<1, _position[1]<<1, _position[2]<<1, _position[3]);
+		for( int i = 0; i < 8; ++i )
+			if( node.children[i] != EMPTY )
+				ExpandNode( _tree, node.children[i], position + CHILD_OFFSETS[i] );
+	}
+
+	// ********************************************************************* //
+	template<typename T>
+	const T* SparseVoxelDAG<T>::Get( const ei::IVec3& _position, int _level ) const
+	{
+		if( m_root == EMPTY ) return nullptr;
+
+		// Special cases: not inside the graph
+		int scale = m_rootSize-_level;
+		if( scale < 0 ) return nullptr;
+		ei::IVec3 position = _position >> scale;
+		if(any((position-m_rootPosition) != ei::IVec3(0)))
+			return nullptr;
+
+		// Search (while not on target level or graph ends)
+		const Node* current = &m_nodes[m_root];
+		while( (scale > 0) && !current->IsLeaf() ) {
+			--scale;
+			int x = (_position[0] >> scale) & 1;
+			int y = (_position[1] >> scale) & 1;
+			int z = (_position[2] >> scale) & 1;
+			uint32 child = current->children[ x + y * 2 + z * 4 ];
+			if( child == EMPTY ) return nullptr;
+			current = &m_nodes[child];
+		}
+
+		return &current->data;
+	}
+
+	// ********************************************************************* //
+	template<typename T>
+	void SparseVoxelDAG<T>::Save( Jo::Files::IFile& _file ) const
+	{
+		_file.Write( &m_rootPosition, sizeof(ei::IVec3) );
+		_file.WriteI32( m_rootSize );
+		_file.WriteU32( m_root );
+		_file.WriteU32( (uint32)m_nodes.size() );
+		for( auto& node : m_nodes )
+		{
+			_file.Write( &node.data, sizeof(T) );
+			_file.Write( node.children, sizeof(node.children) );
+		}
+	}
+
+	// ********************************************************************* //
+	template<typename T>
+	void SparseVoxelDAG<T>::Load( const Jo::Files::IFile& _file )
+	{
+		uint32 numNodes;
+		_file.Read( sizeof(ei::IVec3), &m_rootPosition );
+		_file.Read( sizeof(int), &m_rootSize );
+		_file.Read( sizeof(uint32), &m_root );
+		_file.Read( sizeof(uint32), &numNodes );
+		m_nodes.resize(numNodes);
+		for( auto& node : m_nodes )
+		{
+			_file.Read( sizeof(T), &node.data );
+			_file.Read( sizeof(node.children), node.children );
+		}
+		m_numTreeNodes = 0;
+		m_treeMemory = 0;
+	}
+
+} // namespace Voxel
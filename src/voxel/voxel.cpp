@@ -95,6 +95,7 @@ namespace Voxel {
 			voxelInfo.shieldRegeneration = voxelNode[string("ShieldRegeneration")].Get(0.0f);
 			voxelInfo.shieldComponentType = voxelNode[string("ShieldComponentType")].Get(0);
 			voxelInfo.lifeSupport = voxelNode[string("LifeSupport")].Get(0.0f);
+			voxelInfo.sensorResolution = voxelNode[string("Sensor Resolution")].Get(0.0f);
 			Jo::Files::MetaFileWrapper::Node* mainDirNode;
 			if(voxelNode.HasChild(string("Main Direction"), &mainDirNode))
 			{
@@ -441,6 +442,17 @@ namespace Voxel {
 			return g_InfoManager->m_voxels[(int)_type].lifeSupport;
 	}
 
+	// ********************************************************************* //
+	float TypeInfo::GetSensorResolution(ComponentType _type)
+	{
+		if ((int)_type >= g_InfoManager->m_numVoxels) {
+			LOG_LVL1("The searched voxel type is not defined.");
+			return 0;
+		}
+		else
+			return g_InfoManager->m_voxels[(int)_type].sensorResolution;
+	}
+
 	// ********************************************************************* //
 	std::string TypeInfo::GetName( ComponentType _type )
 	{
@@ -589,12 +601,12 @@ namespace Voxel {
 
 	bool TypeInfo::IsShield( ComponentType _type )
 	{
-		return false;
+		return GetShieldRegeneration(_type) > 0.0f;
 	}
 
 	bool TypeInfo::IsSensor( ComponentType _type )
 	{
-		return false;
+		return GetSensorResolution(_type) > 0.0f;
 	}
 
 	// ********************************************************************* //
@@ -31,7 +31,8 @@ namespace Voxel {
 		BATTERY_M2,
 		GATLING,
 		CAMERA,
-		GENERATOR
+		GENERATOR,
+		SHIELD_GENERATOR_I
 	};
 
 	enum struct ComponentClass {
@@ -132,6 +133,9 @@ namespace Voxel {
 		/// \brief Number of supportable storage components [#vox].
 		static float GetLiveSupport(ComponentType _type);
 
+		/// \brief Smallest apparent angular radius a sensor detects [rad].
+		static float GetSensorResolution(ComponentType _type);
+
 		/// \brief Returns the name of the voxel
 		static std::string GetName( ComponentType _type );
 
@@ -199,6 +203,7 @@ namespace Voxel {
 			float shieldRegeneration;	///< [hit points/s]
 			uint8 shieldComponentType;	///< The component which is spawned and regenerate by the shield.
 			float lifeSupport;			///< Number of supportable storage components [#vox]
+			float sensorResolution;		///< Smallest apparent angular radius a sensor detects [rad]
 			ei::Vec3 mainDir;			///< Main functional direction or 0 for omni-directional components
 
 			std::string name;			///< The name of this voxel type
@@ -318,6 +323,24 @@ namespace Voxel {
 		/// \brief Checks if type is not equal
 		bool operator != (const Voxel& _mat) const		{ return type != _mat.type; }
 
+		/// \brief Compare all persistent fields. The dirty and surface flags
+		///		are ignored, the chunks recompute them.
+		bool IsIdentical(const Voxel& _other) const
+		{
+			return material.code == _other.material.code && health == _other.health
+				&& type == _other.type && inner == _other.inner
+				&& sysAssignment == _other.sysAssignment && rotation == _other.rotation;
+		}
+		/// \brief FNV-1a hash of the fields compared by IsIdentical().
+		uint64_t Hash() const
+		{
+			uint64_t fields[] = { material.code, health, (uint64_t)type, inner, sysAssignment, rotation };
+			uint64_t hash = 0xcbf29ce484222325ull;
+			for( uint64_t field : fields )
+				hash = (hash ^ field) * 0x100000001b3ull;
+			return hash;
+		}
+
 		/// \brief Rotate +90 degree (ccw) or -90 degree (cw) around X axis.
 		void RotateX(bool _ccw);
 		/// \brief Rotate +90 degree (ccw) or -90 degree (cw) around Y axis.